@@ -0,0 +1,1313 @@
+/*-
+ * Copyright (c) 2026 Watchdogs Team and contributors
+ * All rights reserved. under The 2-Clause BSD License
+ * See COPYING or https://opensource.org/license/bsd-2-clause
+ */
+
+#include  "utils.h"
+#include  "debug.h"
+#include  "amx.h"
+
+#ifndef DOG_WINDOWS
+#include  <sys/mman.h>
+#endif
+
+static const char *amx_table_names[AMX_TABLE_MAX] = {
+	"publics", "natives", "libraries", "pubvars", "tags"
+};
+
+static uint16_t
+amx_rd16(const unsigned char *p)
+{
+	return ((uint16_t)(p[0] | (p[1] << 8)));
+}
+
+static int32_t
+amx_rd32(const unsigned char *p)
+{
+	return ((int32_t)((uint32_t)p[0] |
+	    ((uint32_t)p[1] << 8) |
+	    ((uint32_t)p[2] << 16) |
+	    ((uint32_t)p[3] << 24)));
+}
+
+/*
+ * Map the whole file read-only.  On Windows the file is copied to
+ * the heap instead; both cases are released by dog_amx_close().
+ */
+static int
+amx_map_file(const char *path, AmxImage *amx)
+{
+#ifdef DOG_WINDOWS
+	FILE		*fp;
+	long		 len;
+	unsigned char	*buf;
+
+	fp = fopen(path, "rb");
+	if (fp == NULL)
+		return (-1);
+	if (fseek(fp, 0, SEEK_END) != 0 || (len = ftell(fp)) <= 0) {
+		fclose(fp);
+		return (-1);
+	}
+	rewind(fp);
+	buf = dog_malloc((size_t)len);
+	if (buf == NULL) {
+		fclose(fp);
+		return (-1);
+	}
+	if (fread(buf, 1, (size_t)len, fp) != (size_t)len) {
+		dog_free(buf);
+		fclose(fp);
+		return (-1);
+	}
+	fclose(fp);
+	amx->base = buf;
+	amx->length = (size_t)len;
+	amx->mapped = 0;
+#else
+	int		 fd;
+	struct stat	 st;
+	void		*p;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return (-1);
+	if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size <= 0) {
+		close(fd);
+		return (-1);
+	}
+	p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (p == MAP_FAILED)
+		return (-1);
+	amx->base = p;
+	amx->length = (size_t)st.st_size;
+	amx->mapped = 1;
+#endif
+	return (0);
+}
+
+void
+dog_amx_close(AmxImage *amx)
+{
+	if (amx == NULL || amx->base == NULL)
+		return;
+	dog_free(amx->code_heap);
+	dog_free(amx->funcs);
+	dog_free(amx->vars);
+	amx->code_heap = NULL;
+	amx->funcs = NULL;
+	amx->vars = NULL;
+	amx->code = NULL;
+#ifndef DOG_WINDOWS
+	if (amx->mapped) {
+		munmap((void *)amx->base, amx->length);
+		amx->base = NULL;
+		return;
+	}
+#endif
+	dog_free((void *)amx->base);
+	amx->base = NULL;
+}
+
+static int32_t
+amx_table_end(const AmxImage *amx, AmxTable table)
+{
+	if (table + 1 < AMX_TABLE_MAX)
+		return (amx->table[table + 1]);
+	if (amx->file_version >= 10 && amx->overlays > amx->table[AMX_TABLE_TAGS])
+		return (amx->overlays);
+	if (amx->file_version >= 7)
+		return (amx->nametable);
+	return (amx->cod);
+}
+
+int
+dog_amx_open(const char *path, AmxImage *amx)
+{
+	const unsigned char *h;
+	int		 i;
+
+	memset(amx, 0, sizeof(*amx));
+
+	if (amx_map_file(path, amx) != 0) {
+		pr_error(stdout, "amx: cannot open %s..: %s",
+		    path, strerror(errno));
+		return (-1);
+	}
+
+	if (amx->length < AMX_HEADER_SIZE) {
+		pr_error(stdout, "amx: %s is too small to be an AMX file", path);
+		goto bad;
+	}
+
+	h = amx->base;
+	amx->size = amx_rd32(h + 0);
+	amx->magic = amx_rd16(h + 4);
+	amx->file_version = h[6];
+	amx->amx_version = h[7];
+	amx->flags = amx_rd16(h + 8);
+	amx->defsize = amx_rd16(h + 10);
+	amx->cod = amx_rd32(h + 12);
+	amx->dat = amx_rd32(h + 16);
+	amx->hea = amx_rd32(h + 20);
+	amx->stp = amx_rd32(h + 24);
+	amx->cip = amx_rd32(h + 28);
+	for (i = 0; i < AMX_TABLE_MAX; i++)
+		amx->table[i] = amx_rd32(h + 32 + i * 4);
+	amx->nametable = amx_rd32(h + 52);
+	if (amx->file_version >= 10 && amx->length >= AMX_HEADER_SIZE_OVL)
+		amx->overlays = amx_rd32(h + 56);
+
+	if (amx->magic != AMX_MAGIC_32) {
+		pr_error(stdout, "amx: %s has bad magic 0x%04X "
+		    "(only 32-bit cell images are supported)",
+		    path, amx->magic);
+		goto bad;
+	}
+	if (amx->size <= 0 || (size_t)amx->size > amx->length ||
+	    amx->cod < AMX_HEADER_SIZE || amx->cod > amx->size ||
+	    amx->dat < amx->cod || amx->hea < amx->dat || amx->stp < amx->hea ||
+	    amx->defsize < 8) {
+		pr_error(stdout, "amx: %s has a corrupt header", path);
+		goto bad;
+	}
+	for (i = 0; i < AMX_TABLE_MAX; i++) {
+		int32_t	 end = amx_table_end(amx, (AmxTable)i);
+
+		if (amx->table[i] < AMX_HEADER_SIZE || end < amx->table[i] ||
+		    end > amx->cod) {
+			pr_error(stdout, "amx: %s has a corrupt %s table",
+			    path, amx_table_names[i]);
+			goto bad;
+		}
+	}
+
+	return (0);
+
+bad:
+	dog_amx_close(amx);
+	return (-1);
+}
+
+int
+dog_amx_table_count(const AmxImage *amx, AmxTable table)
+{
+	return ((int)((amx_table_end(amx, table) - amx->table[table]) /
+	    amx->defsize));
+}
+
+/*
+ * Return the name of entry `index' in `table' and store its address.
+ * Names live in the name table (file version 7 and later) or inline
+ * after the address field for older images.  An index outside the
+ * table gives "?" and address 0.  Never returns NULL.
+ */
+const char *
+dog_amx_table_entry(const AmxImage *amx, AmxTable table, int index,
+    uint32_t *address)
+{
+	const unsigned char *rec;
+	size_t		 off;
+
+	if (index < 0 || index >= dog_amx_table_count(amx, table)) {
+		if (address != NULL)
+			*address = 0;
+		return ("?");
+	}
+	rec = amx->base + amx->table[table] + (size_t)index * amx->defsize;
+	if (address != NULL)
+		*address = (uint32_t)amx_rd32(rec);
+
+	if (amx->file_version >= 7) {
+		off = (uint32_t)amx_rd32(rec + 4);
+		if (off >= amx->length ||
+		    memchr(amx->base + off, '\0', amx->length - off) == NULL)
+			return ("?");
+		return ((const char *)amx->base + off);
+	}
+
+	if (memchr(rec + 4, '\0', amx->defsize - 4U) == NULL)
+		return ("?");
+	return ((const char *)rec + 4);
+}
+
+int
+dog_amx_overlay_count(const AmxImage *amx)
+{
+	if (amx->file_version < 10 || amx->overlays <= 0 ||
+	    amx->nametable < amx->overlays)
+		return (0);
+	return ((amx->nametable - amx->overlays) / 8);
+}
+
+typedef enum {
+	OPND_NONE,	/* no operand */
+	OPND_NUM,	/* plain number */
+	OPND_DATA,	/* data segment address */
+	OPND_STACK,	/* frame relative offset */
+	OPND_CODE,	/* code address */
+	OPND_NATIVE,	/* native table index */
+	OPND_CASETBL,	/* case table, variable length */
+	OPND_SKIP	/* obsolete, byte count of inline data follows */
+} AmxOperand;
+
+/*
+ * Opcode table for the 32-bit Pawn 3.x instruction set, including the
+ * 3.3 macro instructions emitted by newer compilers.  `kind' describes
+ * the first operand and `kind2' the remaining ones.
+ */
+static const struct {
+	const char	*name;
+	uint8_t		 nparams;
+	uint8_t		 kind;
+	uint8_t		 kind2;
+} amx_opcodes[] = {
+	{ "none",	0, OPND_NONE,	OPND_NONE },
+	{ "load.pri",	1, OPND_DATA,	OPND_NONE },
+	{ "load.alt",	1, OPND_DATA,	OPND_NONE },
+	{ "load.s.pri",	1, OPND_STACK,	OPND_NONE },
+	{ "load.s.alt",	1, OPND_STACK,	OPND_NONE },
+	{ "lref.pri",	1, OPND_DATA,	OPND_NONE },
+	{ "lref.alt",	1, OPND_DATA,	OPND_NONE },
+	{ "lref.s.pri",	1, OPND_STACK,	OPND_NONE },
+	{ "lref.s.alt",	1, OPND_STACK,	OPND_NONE },
+	{ "load.i",	0, OPND_NONE,	OPND_NONE },
+	{ "lodb.i",	1, OPND_NUM,	OPND_NONE },
+	{ "const.pri",	1, OPND_NUM,	OPND_NONE },
+	{ "const.alt",	1, OPND_NUM,	OPND_NONE },
+	{ "addr.pri",	1, OPND_STACK,	OPND_NONE },
+	{ "addr.alt",	1, OPND_STACK,	OPND_NONE },
+	{ "stor.pri",	1, OPND_DATA,	OPND_NONE },
+	{ "stor.alt",	1, OPND_DATA,	OPND_NONE },
+	{ "stor.s.pri",	1, OPND_STACK,	OPND_NONE },
+	{ "stor.s.alt",	1, OPND_STACK,	OPND_NONE },
+	{ "sref.pri",	1, OPND_DATA,	OPND_NONE },
+	{ "sref.alt",	1, OPND_DATA,	OPND_NONE },
+	{ "sref.s.pri",	1, OPND_STACK,	OPND_NONE },
+	{ "sref.s.alt",	1, OPND_STACK,	OPND_NONE },
+	{ "stor.i",	0, OPND_NONE,	OPND_NONE },
+	{ "strb.i",	1, OPND_NUM,	OPND_NONE },
+	{ "lidx",	0, OPND_NONE,	OPND_NONE },
+	{ "lidx.b",	1, OPND_NUM,	OPND_NONE },
+	{ "idxaddr",	0, OPND_NONE,	OPND_NONE },
+	{ "idxaddr.b",	1, OPND_NUM,	OPND_NONE },
+	{ "align.pri",	1, OPND_NUM,	OPND_NONE },
+	{ "align.alt",	1, OPND_NUM,	OPND_NONE },
+	{ "lctrl",	1, OPND_NUM,	OPND_NONE },
+	{ "sctrl",	1, OPND_NUM,	OPND_NONE },
+	{ "move.pri",	0, OPND_NONE,	OPND_NONE },
+	{ "move.alt",	0, OPND_NONE,	OPND_NONE },
+	{ "xchg",	0, OPND_NONE,	OPND_NONE },
+	{ "push.pri",	0, OPND_NONE,	OPND_NONE },
+	{ "push.alt",	0, OPND_NONE,	OPND_NONE },
+	{ "push.r",	1, OPND_NUM,	OPND_NONE },
+	{ "push.c",	1, OPND_NUM,	OPND_NONE },
+	{ "push",	1, OPND_DATA,	OPND_NONE },
+	{ "push.s",	1, OPND_STACK,	OPND_NONE },
+	{ "pop.pri",	0, OPND_NONE,	OPND_NONE },
+	{ "pop.alt",	0, OPND_NONE,	OPND_NONE },
+	{ "stack",	1, OPND_NUM,	OPND_NONE },
+	{ "heap",	1, OPND_NUM,	OPND_NONE },
+	{ "proc",	0, OPND_NONE,	OPND_NONE },
+	{ "ret",	0, OPND_NONE,	OPND_NONE },
+	{ "retn",	0, OPND_NONE,	OPND_NONE },
+	{ "call",	1, OPND_CODE,	OPND_NONE },
+	{ "call.pri",	0, OPND_NONE,	OPND_NONE },
+	{ "jump",	1, OPND_CODE,	OPND_NONE },
+	{ "jrel",	1, OPND_NUM,	OPND_NONE },
+	{ "jzer",	1, OPND_CODE,	OPND_NONE },
+	{ "jnz",	1, OPND_CODE,	OPND_NONE },
+	{ "jeq",	1, OPND_CODE,	OPND_NONE },
+	{ "jneq",	1, OPND_CODE,	OPND_NONE },
+	{ "jless",	1, OPND_CODE,	OPND_NONE },
+	{ "jleq",	1, OPND_CODE,	OPND_NONE },
+	{ "jgrtr",	1, OPND_CODE,	OPND_NONE },
+	{ "jgeq",	1, OPND_CODE,	OPND_NONE },
+	{ "jsless",	1, OPND_CODE,	OPND_NONE },
+	{ "jsleq",	1, OPND_CODE,	OPND_NONE },
+	{ "jsgrtr",	1, OPND_CODE,	OPND_NONE },
+	{ "jsgeq",	1, OPND_CODE,	OPND_NONE },
+	{ "shl",	0, OPND_NONE,	OPND_NONE },
+	{ "shr",	0, OPND_NONE,	OPND_NONE },
+	{ "sshr",	0, OPND_NONE,	OPND_NONE },
+	{ "shl.c.pri",	1, OPND_NUM,	OPND_NONE },
+	{ "shl.c.alt",	1, OPND_NUM,	OPND_NONE },
+	{ "shr.c.pri",	1, OPND_NUM,	OPND_NONE },
+	{ "shr.c.alt",	1, OPND_NUM,	OPND_NONE },
+	{ "smul",	0, OPND_NONE,	OPND_NONE },
+	{ "sdiv",	0, OPND_NONE,	OPND_NONE },
+	{ "sdiv.alt",	0, OPND_NONE,	OPND_NONE },
+	{ "umul",	0, OPND_NONE,	OPND_NONE },
+	{ "udiv",	0, OPND_NONE,	OPND_NONE },
+	{ "udiv.alt",	0, OPND_NONE,	OPND_NONE },
+	{ "add",	0, OPND_NONE,	OPND_NONE },
+	{ "sub",	0, OPND_NONE,	OPND_NONE },
+	{ "sub.alt",	0, OPND_NONE,	OPND_NONE },
+	{ "and",	0, OPND_NONE,	OPND_NONE },
+	{ "or",		0, OPND_NONE,	OPND_NONE },
+	{ "xor",	0, OPND_NONE,	OPND_NONE },
+	{ "not",	0, OPND_NONE,	OPND_NONE },
+	{ "neg",	0, OPND_NONE,	OPND_NONE },
+	{ "invert",	0, OPND_NONE,	OPND_NONE },
+	{ "add.c",	1, OPND_NUM,	OPND_NONE },
+	{ "smul.c",	1, OPND_NUM,	OPND_NONE },
+	{ "zero.pri",	0, OPND_NONE,	OPND_NONE },
+	{ "zero.alt",	0, OPND_NONE,	OPND_NONE },
+	{ "zero",	1, OPND_DATA,	OPND_NONE },
+	{ "zero.s",	1, OPND_STACK,	OPND_NONE },
+	{ "sign.pri",	0, OPND_NONE,	OPND_NONE },
+	{ "sign.alt",	0, OPND_NONE,	OPND_NONE },
+	{ "eq",		0, OPND_NONE,	OPND_NONE },
+	{ "neq",	0, OPND_NONE,	OPND_NONE },
+	{ "less",	0, OPND_NONE,	OPND_NONE },
+	{ "leq",	0, OPND_NONE,	OPND_NONE },
+	{ "grtr",	0, OPND_NONE,	OPND_NONE },
+	{ "geq",	0, OPND_NONE,	OPND_NONE },
+	{ "sless",	0, OPND_NONE,	OPND_NONE },
+	{ "sleq",	0, OPND_NONE,	OPND_NONE },
+	{ "sgrtr",	0, OPND_NONE,	OPND_NONE },
+	{ "sgeq",	0, OPND_NONE,	OPND_NONE },
+	{ "eq.c.pri",	1, OPND_NUM,	OPND_NONE },
+	{ "eq.c.alt",	1, OPND_NUM,	OPND_NONE },
+	{ "inc.pri",	0, OPND_NONE,	OPND_NONE },
+	{ "inc.alt",	0, OPND_NONE,	OPND_NONE },
+	{ "inc",	1, OPND_DATA,	OPND_NONE },
+	{ "inc.s",	1, OPND_STACK,	OPND_NONE },
+	{ "inc.i",	0, OPND_NONE,	OPND_NONE },
+	{ "dec.pri",	0, OPND_NONE,	OPND_NONE },
+	{ "dec.alt",	0, OPND_NONE,	OPND_NONE },
+	{ "dec",	1, OPND_DATA,	OPND_NONE },
+	{ "dec.s",	1, OPND_STACK,	OPND_NONE },
+	{ "dec.i",	0, OPND_NONE,	OPND_NONE },
+	{ "movs",	1, OPND_NUM,	OPND_NONE },
+	{ "cmps",	1, OPND_NUM,	OPND_NONE },
+	{ "fill",	1, OPND_NUM,	OPND_NONE },
+	{ "halt",	1, OPND_NUM,	OPND_NONE },
+	{ "bounds",	1, OPND_NUM,	OPND_NONE },
+	{ "sysreq.pri",	0, OPND_NONE,	OPND_NONE },
+	{ "sysreq.c",	1, OPND_NATIVE,	OPND_NONE },
+	{ "file",	0, OPND_SKIP,	OPND_NONE },
+	{ "line",	2, OPND_NUM,	OPND_NUM },
+	{ "symbol",	0, OPND_SKIP,	OPND_NONE },
+	{ "srange",	2, OPND_NUM,	OPND_NUM },
+	{ "jump.pri",	0, OPND_NONE,	OPND_NONE },
+	{ "switch",	1, OPND_CODE,	OPND_NONE },
+	{ "casetbl",	0, OPND_CASETBL, OPND_NONE },
+	{ "swap.pri",	0, OPND_NONE,	OPND_NONE },
+	{ "swap.alt",	0, OPND_NONE,	OPND_NONE },
+	{ "push.adr",	1, OPND_STACK,	OPND_NONE },
+	{ "nop",	0, OPND_NONE,	OPND_NONE },
+	{ "sysreq.n",	2, OPND_NATIVE,	OPND_NUM },
+	{ "symtag",	1, OPND_NUM,	OPND_NONE },
+	{ "break",	0, OPND_NONE,	OPND_NONE },
+	{ "push2.c",	2, OPND_NUM,	OPND_NUM },
+	{ "push2",	2, OPND_DATA,	OPND_DATA },
+	{ "push2.s",	2, OPND_STACK,	OPND_STACK },
+	{ "push2.adr",	2, OPND_STACK,	OPND_STACK },
+	{ "push3.c",	3, OPND_NUM,	OPND_NUM },
+	{ "push3",	3, OPND_DATA,	OPND_DATA },
+	{ "push3.s",	3, OPND_STACK,	OPND_STACK },
+	{ "push3.adr",	3, OPND_STACK,	OPND_STACK },
+	{ "push4.c",	4, OPND_NUM,	OPND_NUM },
+	{ "push4",	4, OPND_DATA,	OPND_DATA },
+	{ "push4.s",	4, OPND_STACK,	OPND_STACK },
+	{ "push4.adr",	4, OPND_STACK,	OPND_STACK },
+	{ "push5.c",	5, OPND_NUM,	OPND_NUM },
+	{ "push5",	5, OPND_DATA,	OPND_DATA },
+	{ "push5.s",	5, OPND_STACK,	OPND_STACK },
+	{ "push5.adr",	5, OPND_STACK,	OPND_STACK },
+	{ "load.both",	2, OPND_DATA,	OPND_DATA },
+	{ "load.s.both", 2, OPND_STACK,	OPND_STACK },
+	{ "const",	2, OPND_DATA,	OPND_NUM },
+	{ "const.s",	2, OPND_STACK,	OPND_NUM }
+};
+
+#define AMX_OP_PROC	46
+#define AMX_OP_CASETBL	130
+#define AMX_NUM_OPCODES	(sizeof(amx_opcodes) / sizeof(amx_opcodes[0]))
+
+/*
+ * Bring the code segment into plain (non-compact) form.  For compact
+ * images the code and data segments are expanded together into one
+ * heap buffer, so in both cases the data segment starts at
+ * amx->code + amx->code_size.
+ */
+int
+dog_amx_load_code(AmxImage *amx)
+{
+	const unsigned char *p, *end;
+	unsigned char	*buf;
+	size_t		 memsize, o;
+	uint32_t	 c;
+
+	if (amx->code != NULL)
+		return (0);
+
+	amx->code_size = amx->dat - amx->cod;
+	if ((amx->flags & AMX_FLAG_COMPACT) == 0) {
+		if ((size_t)amx->hea > amx->length) {
+			pr_error(stdout, "amx: image is truncated");
+			return (-1);
+		}
+		amx->code = amx->base + amx->cod;
+		return (0);
+	}
+
+	memsize = (size_t)(amx->hea - amx->cod);
+	buf = dog_calloc(1, memsize + sizeof(uint32_t));
+	if (buf == NULL)
+		return (-1);
+
+	p = amx->base + amx->cod;
+	end = amx->base + amx->size;
+	o = 0;
+	while (p < end && o + sizeof(uint32_t) <= memsize) {
+		c = (*p & 0x40) ? 0xFFFFFFFFu : 0;
+		do {
+			c = (c << 7) | (*p & 0x7f);
+		} while ((*p++ & 0x80) != 0 && p < end);
+		buf[o++] = (unsigned char)(c & 0xff);
+		buf[o++] = (unsigned char)((c >> 8) & 0xff);
+		buf[o++] = (unsigned char)((c >> 16) & 0xff);
+		buf[o++] = (unsigned char)((c >> 24) & 0xff);
+	}
+
+	amx->code_heap = buf;
+	amx->code = buf;
+	return (0);
+}
+
+/*
+ * Size of the instruction at `cip' in cells, clamped to the end of
+ * the code segment.  Unknown opcodes count as a single cell.
+ */
+int
+dog_amx_insn_cells(const AmxImage *amx, uint32_t cip)
+{
+	uint32_t	 op;
+	int32_t		 n;
+	int64_t		 cells, left;
+
+	left = ((int64_t)amx->code_size - (int64_t)cip) / 4;
+	if (left <= 0)
+		return (0);
+
+	op = (uint32_t)amx_rd32(amx->code + cip);
+	if (op >= AMX_NUM_OPCODES)
+		return (1);
+
+	switch (amx_opcodes[op].kind) {
+	case OPND_CASETBL:
+		n = (left > 1) ? amx_rd32(amx->code + cip + 4) : 0;
+		cells = (n < 0) ? 1 : 3 + 2 * (int64_t)n;
+		break;
+	case OPND_SKIP:
+		n = (left > 1) ? amx_rd32(amx->code + cip + 4) : 0;
+		cells = (n < 0) ? 1 : 2 + ((int64_t)n + 3) / 4;
+		break;
+	default:
+		cells = 1 + amx_opcodes[op].nparams;
+		break;
+	}
+
+	return ((int)((cells > left) ? left : cells));
+}
+
+static int
+amx_func_cmp(const void *a, const void *b)
+{
+	const AmxFunction *fa = a, *fb = b;
+
+	return ((fa->start > fb->start) - (fa->start < fb->start));
+}
+
+static int
+amx_var_cmp(const void *a, const void *b)
+{
+	const AmxVariable *va = a, *vb = b;
+
+	return ((va->address > vb->address) - (va->address < vb->address));
+}
+
+static AmxFunction *
+amx_add_function(AmxImage *amx, int *cap, uint32_t start, uint32_t end,
+    const char *name)
+{
+	AmxFunction	*f;
+
+	if (amx->nfuncs == *cap) {
+		int	 ncap = (*cap > 0) ? *cap * 2 : 64;
+
+		f = dog_realloc(amx->funcs, (size_t)ncap * sizeof(*f));
+		if (f == NULL)
+			return (NULL);
+		amx->funcs = f;
+		*cap = ncap;
+	}
+	f = &amx->funcs[amx->nfuncs++];
+	f->start = start;
+	f->end = end;
+	f->anonymous = 0;
+	snprintf(f->name, sizeof(f->name), "%s", name);
+	return (f);
+}
+
+static int
+amx_add_variable(AmxImage *amx, int *cap, uint32_t address, const char *name)
+{
+	AmxVariable	*v;
+
+	if (amx->nvars == *cap) {
+		int	 ncap = (*cap > 0) ? *cap * 2 : 64;
+
+		v = dog_realloc(amx->vars, (size_t)ncap * sizeof(*v));
+		if (v == NULL)
+			return (-1);
+		amx->vars = v;
+		*cap = ncap;
+	}
+	v = &amx->vars[amx->nvars++];
+	v->address = address;
+	snprintf(v->name, sizeof(v->name), "%s", name);
+	return (0);
+}
+
+static const unsigned char *
+amx_skip_string(const unsigned char *p, const unsigned char *end)
+{
+	const unsigned char *z;
+
+	if (p >= end)
+		return (NULL);
+	z = memchr(p, '\0', (size_t)(end - p));
+	return ((z != NULL) ? z + 1 : NULL);
+}
+
+/*
+ * Walk the debug chunk that follows the image (AMX_DBG, magic 0xF1EF)
+ * and collect function ranges plus global variable names.
+ */
+static void
+amx_load_debug(AmxImage *amx, int *fcap, int *vcap)
+{
+	const unsigned char *p, *end, *name;
+	int32_t		 dsize;
+	int		 nfiles, nlines, nsyms, i;
+
+	if ((amx->flags & AMX_FLAG_DEBUG) == 0 ||
+	    amx->length < (size_t)amx->size + 22)
+		return;
+
+	p = amx->base + amx->size;
+	dsize = amx_rd32(p);
+	if (amx_rd16(p + 4) != AMX_MAGIC_DBG || dsize < 22)
+		return;
+	end = p + (((size_t)dsize < amx->length - (size_t)amx->size) ?
+	    (size_t)dsize : amx->length - (size_t)amx->size);
+
+	nfiles = amx_rd16(p + 10);
+	nlines = amx_rd16(p + 12);
+	nsyms = amx_rd16(p + 14);
+	p += 22;
+
+	for (i = 0; i < nfiles && p != NULL; i++)
+		p = amx_skip_string(p + 4, end);
+	if (p == NULL)
+		return;
+	p += (size_t)nlines * 8;
+
+	for (i = 0; i < nsyms; i++) {
+		uint32_t	 addr, cstart, cend;
+		uint8_t		 ident, vclass;
+		uint16_t	 dim;
+
+		if (p + 18 > end)
+			return;
+		addr = (uint32_t)amx_rd32(p);
+		cstart = (uint32_t)amx_rd32(p + 6);
+		cend = (uint32_t)amx_rd32(p + 10);
+		ident = p[14];
+		vclass = p[15];
+		dim = amx_rd16(p + 16);
+		name = p + 18;
+		p = amx_skip_string(name, end);
+		if (p == NULL)
+			return;
+		p += (size_t)dim * 6;
+
+		if (ident == 9 && cstart < cend)
+			amx_add_function(amx, fcap, cstart, cend,
+			    (const char *)name);
+		else if ((ident == 1 || ident == 3) && vclass != 1)
+			amx_add_variable(amx, vcap, addr, (const char *)name);
+	}
+}
+
+/*
+ * Build the function list: from debug symbols when the image carries
+ * them, otherwise by splitting the code at every PROC and naming the
+ * pieces after matching publics.
+ */
+int
+dog_amx_load_functions(AmxImage *amx)
+{
+	AmxFunction	*f;
+	int		 fcap = 0, vcap = 0;
+	int		 i, np, anonymous;
+	uint32_t	 cip, addr;
+	char		 name[64];
+
+	if (amx->funcs != NULL)
+		return (0);
+	if (dog_amx_load_code(amx) != 0)
+		return (-1);
+
+	amx_load_debug(amx, &fcap, &vcap);
+
+	if (amx->nfuncs == 0) {
+		np = dog_amx_table_count(amx, AMX_TABLE_PUBLICS);
+		cip = 0;
+		while (cip < (uint32_t)amx->code_size) {
+			int	 cells = dog_amx_insn_cells(amx, cip);
+
+			if (cells <= 0)
+				break;
+			if (amx_rd32(amx->code + cip) == AMX_OP_PROC) {
+				if (amx->nfuncs > 0)
+					amx->funcs[amx->nfuncs - 1].end = cip;
+				anonymous = 0;
+				if (amx->cip >= 0 && cip == (uint32_t)amx->cip) {
+					snprintf(name, sizeof(name), "main");
+				} else {
+					snprintf(name, sizeof(name), "func_%08x", cip);
+					anonymous = 1;
+				}
+				for (i = 0; i < np; i++) {
+					const char *pname = dog_amx_table_entry(amx,
+					    AMX_TABLE_PUBLICS, i, &addr);
+					if (addr == cip) {
+						snprintf(name, sizeof(name), "%s", pname);
+						anonymous = 0;
+						break;
+					}
+				}
+				f = amx_add_function(amx, &fcap, cip,
+				    (uint32_t)amx->code_size, name);
+				if (f == NULL)
+					return (-1);
+				f->anonymous = anonymous;
+			}
+			cip += (uint32_t)cells * 4;
+		}
+	}
+
+	if (amx->nfuncs > 1)
+		qsort(amx->funcs, (size_t)amx->nfuncs, sizeof(*amx->funcs),
+		    amx_func_cmp);
+	if (amx->nvars > 1)
+		qsort(amx->vars, (size_t)amx->nvars, sizeof(*amx->vars),
+		    amx_var_cmp);
+
+	/* keep funcs non-NULL so a second call does not rescan */
+	if (amx->funcs == NULL)
+		amx->funcs = dog_calloc(1, sizeof(*amx->funcs));
+	return (0);
+}
+
+static const char *
+amx_compiler_hint(uint8_t file_version)
+{
+	switch (file_version) {
+	case 6:
+	case 7:
+		return ("pawncc 3.0/3.1");
+	case 8:
+		return ("pawncc 3.2 (SA-MP) / community 3.10");
+	case 9:
+		return ("pawncc 3.3");
+	default:
+		if (file_version >= 10)
+			return ("pawncc 4.x");
+		return ("unknown");
+	}
+}
+
+static void
+amx_print_table(const AmxImage *amx, AmxTable table)
+{
+	int		 n, i;
+	uint32_t	 addr;
+	const char	*name;
+
+	n = dog_amx_table_count(amx, table);
+	pr_color(stdout, DOG_COL_CYAN, " %s (%d)\n", amx_table_names[table], n);
+	for (i = 0; i < n; i++) {
+		name = dog_amx_table_entry(amx, table, i, &addr);
+		if (table == AMX_TABLE_NATIVES || table == AMX_TABLE_LIBRARIES)
+			printf("   %4d  %s\n", i, name);
+		else
+			printf("   %08X  %s\n", addr, name);
+	}
+}
+
+static void
+amx_print_overlays(const AmxImage *amx)
+{
+	int		 n, i;
+	const unsigned char *rec;
+
+	n = dog_amx_overlay_count(amx);
+	pr_color(stdout, DOG_COL_CYAN, " overlays (%d)\n", n);
+	for (i = 0; i < n; i++) {
+		rec = amx->base + amx->overlays + (size_t)i * 8;
+		if ((size_t)(rec - amx->base) + 8 > amx->length)
+			break;
+		printf("   %4d  offset %08X  size %d\n", i,
+		    (uint32_t)amx_rd32(rec), amx_rd32(rec + 4));
+	}
+}
+
+/*
+ * amx info <file.amx> [section]
+ * Print the header summary of an AMX image and its symbol tables.
+ * `section' limits the listing to one of publics, natives, libraries,
+ * pubvars, tags, overlays or "header"; NULL/empty lists everything.
+ */
+int
+dog_amx_info(const char *path, const char *section)
+{
+	AmxImage	 amx;
+	int		 i;
+	int		 all;
+
+	if (dog_amx_open(path, &amx) != 0)
+		return (-1);
+
+	all = (section == NULL || *section == '\0' ||
+	    strcmp(section, "all") == 0);
+
+	printf(" AMX         : " DOG_COL_YELLOW "%s" DOG_COL_DEFAULT
+	    " (%zu bytes)\n", path, amx.length);
+	printf(" version     : file %u / amx %u  (%s)\n",
+	    amx.file_version, amx.amx_version,
+	    amx_compiler_hint(amx.file_version));
+	printf(" flags       : 0x%04X%s%s%s%s\n", amx.flags,
+	    (amx.flags & AMX_FLAG_DEBUG) ? " debug" : "",
+	    (amx.flags & AMX_FLAG_COMPACT) ? " compact" : "",
+	    (amx.flags & AMX_FLAG_NOCHECKS) ? " nochecks" : "",
+	    (amx.flags & AMX_FLAG_CHAR16) ? " char16" : "");
+	printf(" header      : %d bytes\n", amx.cod);
+	printf(" code        : %d bytes\n", amx.dat - amx.cod);
+	printf(" data        : %d bytes\n", amx.hea - amx.dat);
+	printf(" stack/heap  : %d bytes\n", amx.stp - amx.hea);
+	printf(" total       : %d bytes\n", amx.stp);
+	if (amx.cip >= 0)
+		printf(" main()      : %08X\n", (uint32_t)amx.cip);
+	else
+		printf(" main()      : none\n");
+	if ((amx.flags & AMX_FLAG_DEBUG) && amx.length > (size_t)amx.size)
+		printf(" debug info  : %zu bytes\n",
+		    amx.length - (size_t)amx.size);
+	for (i = 0; i < AMX_TABLE_MAX; i++)
+		printf(" %-11s : %d\n", amx_table_names[i],
+		    dog_amx_table_count(&amx, (AmxTable)i));
+	if (amx.file_version >= 10)
+		printf(" overlays    : %d\n", dog_amx_overlay_count(&amx));
+
+	if (section != NULL && strcmp(section, "header") == 0)
+		goto done;
+
+	for (i = 0; i < AMX_TABLE_MAX; i++) {
+		if (all && dog_amx_table_count(&amx, (AmxTable)i) == 0)
+			continue;
+		if (all || strcmp(section, amx_table_names[i]) == 0)
+			amx_print_table(&amx, (AmxTable)i);
+	}
+	if ((all && dog_amx_overlay_count(&amx) > 0) ||
+	    (!all && strcmp(section, "overlays") == 0))
+		amx_print_overlays(&amx);
+
+done:
+	fflush(stdout);
+	dog_amx_close(&amx);
+	return (0);
+}
+
+static const AmxFunction *
+amx_find_function(const AmxImage *amx, uint32_t start)
+{
+	AmxFunction	 key;
+
+	if (amx->nfuncs == 0)
+		return (NULL);
+	key.start = start;
+	return (bsearch(&key, amx->funcs, (size_t)amx->nfuncs,
+	    sizeof(*amx->funcs), amx_func_cmp));
+}
+
+static const AmxVariable *
+amx_find_variable(const AmxImage *amx, uint32_t address)
+{
+	AmxVariable	 key;
+
+	if (amx->nvars == 0)
+		return (NULL);
+	key.address = address;
+	return (bsearch(&key, amx->vars, (size_t)amx->nvars,
+	    sizeof(*amx->vars), amx_var_cmp));
+}
+
+/*
+ * Decode [start, end) of the code segment into `out', one instruction
+ * per line in pawndisasm layout.  Call targets, natives and globals are
+ * annotated with their names when known.
+ */
+static void
+amx_disasm_range(const AmxImage *amx, FILE *out, uint32_t start, uint32_t end)
+{
+	char		 line[512];
+	int		 len, cells, i, nnat;
+	uint32_t	 cip, op, v;
+	const char	*note;
+
+	nnat = dog_amx_table_count(amx, AMX_TABLE_NATIVES);
+	cip = start;
+	while (cip < end) {
+		cells = dog_amx_insn_cells(amx, cip);
+		if (cells <= 0)
+			break;
+		op = (uint32_t)amx_rd32(amx->code + cip);
+
+		if (op == 0 || op >= AMX_NUM_OPCODES) {
+			fprintf(out, "%08x  .cell %08x\n", cip, op);
+			cip += 4;
+			continue;
+		}
+
+		if (amx_opcodes[op].kind == OPND_CASETBL) {
+			int32_t	 n = (cells >= 3) ?
+			    amx_rd32(amx->code + cip + 4) : 0;
+
+			fprintf(out, "%08x  casetbl      %d default %08x\n",
+			    cip, n, (cells >= 3) ?
+			    (uint32_t)amx_rd32(amx->code + cip + 8) : 0);
+			for (i = 3; i + 1 < cells; i += 2)
+				fprintf(out, "                case %d %08x\n",
+				    amx_rd32(amx->code + cip + (uint32_t)i * 4),
+				    (uint32_t)amx_rd32(amx->code + cip +
+				    (uint32_t)(i + 1) * 4));
+			cip += (uint32_t)cells * 4;
+			continue;
+		}
+
+		len = snprintf(line, sizeof(line), "%08x  %-12s",
+		    cip, amx_opcodes[op].name);
+		note = NULL;
+		for (i = 1; i < cells && len < (int)sizeof(line) - 16; i++) {
+			uint8_t	 kind = (i == 1) ? amx_opcodes[op].kind :
+			    amx_opcodes[op].kind2;
+			const AmxFunction *f;
+			const AmxVariable *var;
+
+			v = (uint32_t)amx_rd32(amx->code + cip + (uint32_t)i * 4);
+			len += snprintf(line + len, sizeof(line) - (size_t)len,
+			    " %08x", v);
+			if (note != NULL)
+				continue;
+			if (kind == OPND_CODE &&
+			    (f = amx_find_function(amx, v)) != NULL)
+				note = f->name;
+			else if (kind == OPND_NATIVE && nnat > 0 &&
+			    v < (uint32_t)nnat)
+				note = dog_amx_table_entry(amx,
+				    AMX_TABLE_NATIVES, (int)v, NULL);
+			else if (kind == OPND_DATA &&
+			    (var = amx_find_variable(amx, v)) != NULL)
+				note = var->name;
+		}
+		while (len > 0 && line[len - 1] == ' ')
+			line[--len] = '\0';
+		if (note != NULL)
+			fprintf(out, "%s\t; %s\n", line, note);
+		else
+			fprintf(out, "%s\n", line);
+		cip += (uint32_t)cells * 4;
+	}
+}
+
+static int
+amx_name_selected(const char *list, const char *name)
+{
+	size_t		 n;
+	const char	*p;
+
+	if (list == NULL || *list == '\0')
+		return (1);
+	n = strlen(name);
+	for (p = list; *p != '\0'; ) {
+		const char *comma = strchr(p, ',');
+		size_t	 len = (comma != NULL) ? (size_t)(comma - p) : strlen(p);
+
+		if (len == n && strncmp(p, name, n) == 0)
+			return (1);
+		if (comma == NULL)
+			break;
+		p = comma + 1;
+	}
+	return (0);
+}
+
+static FILE *
+amx_open_split(const char *dir, const char *name)
+{
+	char		 path[DOG_PATH_MAX];
+	char		 safe[64];
+	size_t		 i;
+
+	for (i = 0; name[i] != '\0' && i + 1 < sizeof(safe); i++)
+		safe[i] = (isalnum((unsigned char)name[i]) ||
+		    name[i] == '_' || name[i] == '@') ? name[i] : '_';
+	safe[i] = '\0';
+	snprintf(path, sizeof(path), "%s" "%s" "%s.asm",
+	    dir, _PATH_STR_SEP_POSIX, safe);
+	return (fopen(path, "w"));
+}
+
+/*
+ * amx disasm <file.amx> [-f name,...] [-o out.asm] [--split dir]
+ * Disassemble the code segment without pawndisasm.  `functions' is a
+ * comma separated filter (NULL for everything), `output' the target
+ * file (NULL for stdout) and `split_dir' writes one file per function.
+ */
+int
+dog_amx_disasm(const char *path, const char *functions, const char *output,
+    const char *split_dir)
+{
+	static char	 outbuf[1 << 20];
+	AmxImage	 amx;
+	FILE		*out = stdout;
+	uint32_t	 cip;
+	int		 i, nout = 0;
+
+	if (dog_amx_open(path, &amx) != 0)
+		return (-1);
+	if (dog_amx_load_functions(&amx) != 0) {
+		dog_amx_close(&amx);
+		return (-1);
+	}
+
+	if (split_dir != NULL) {
+		dog_mkdir_recursive(split_dir);
+		for (i = 0; i < amx.nfuncs; i++) {
+			const AmxFunction *f = &amx.funcs[i];
+			FILE	*fp;
+
+			if (!amx_name_selected(functions, f->name))
+				continue;
+			fp = amx_open_split(split_dir, f->name);
+			if (fp == NULL) {
+				pr_error(stdout, "amx: cannot write %s/%s.asm..: %s",
+				    split_dir, f->name, strerror(errno));
+				continue;
+			}
+			fprintf(fp, "; %s [%08x - %08x]\n", f->name, f->start, f->end);
+			amx_disasm_range(&amx, fp, f->start, f->end);
+			fclose(fp);
+			++nout;
+		}
+		pr_info(stdout, "amx: %d function(s) written to %s",
+		    nout, split_dir);
+		dog_amx_close(&amx);
+		return (0);
+	}
+
+	if (output != NULL) {
+		out = fopen(output, "w");
+		if (out == NULL) {
+			pr_error(stdout, "amx: cannot write %s..: %s",
+			    output, strerror(errno));
+			dog_amx_close(&amx);
+			return (-1);
+		}
+		setvbuf(out, outbuf, _IOFBF, sizeof(outbuf));
+	}
+
+	fprintf(out, "; %s\n; file version %u, amx version %u, "
+	    "code %d bytes, data %d bytes\n",
+	    path, amx.file_version, amx.amx_version,
+	    amx.code_size, amx.hea - amx.dat);
+
+	cip = 0;
+	for (i = 0; i < amx.nfuncs; i++) {
+		const AmxFunction *f = &amx.funcs[i];
+
+		if (functions != NULL && *functions != '\0') {
+			if (!amx_name_selected(functions, f->name))
+				continue;
+		} else if (cip < f->start) {
+			amx_disasm_range(&amx, out, cip, f->start);
+		}
+		fprintf(out, "\n; %s\n", f->name);
+		amx_disasm_range(&amx, out, f->start, f->end);
+		cip = f->end;
+		++nout;
+	}
+	if ((functions == NULL || *functions == '\0') &&
+	    cip < (uint32_t)amx.code_size)
+		amx_disasm_range(&amx, out, cip, (uint32_t)amx.code_size);
+
+	fflush(out);
+	if (out != stdout)
+		fclose(out);
+
+	if (functions != NULL && *functions != '\0' && nout == 0)
+		pr_warning(stdout, "amx: no function matches '%s'", functions);
+
+	dog_amx_close(&amx);
+	return (0);
+}
+
+typedef struct {
+	const AmxFunction *func;
+	uint64_t	 hash;
+	int		 matched;
+} AmxFuncHash;
+
+static uint64_t
+amx_fnv1a(uint64_t h, const void *data, size_t len)
+{
+	const unsigned char *p = data;
+
+	while (len-- > 0) {
+		h ^= *p++;
+		h *= 0x100000001b3ULL;
+	}
+	return (h);
+}
+
+static uint64_t
+amx_hash_operand(const AmxImage *amx, const AmxFunction *fn, uint64_t h,
+    uint8_t kind, uint32_t v)
+{
+	const AmxFunction *f;
+	const AmxVariable *var;
+	uint32_t	 rel;
+
+	switch (kind) {
+	case OPND_CODE:
+		if (v >= fn->start && v < fn->end) {
+			rel = v - fn->start;
+			h = amx_fnv1a(h, "r", 1);
+			return (amx_fnv1a(h, &rel, sizeof(rel)));
+		}
+		f = amx_find_function(amx, v);
+		if (f != NULL && !f->anonymous)
+			return (amx_fnv1a(h, f->name, strlen(f->name) + 1));
+		return (amx_fnv1a(h, "x", 1));
+	case OPND_NATIVE:
+		if (dog_amx_table_count(amx, AMX_TABLE_NATIVES) > 0 &&
+		    v < (uint32_t)dog_amx_table_count(amx,
+		    AMX_TABLE_NATIVES)) {
+			const char *n = dog_amx_table_entry(amx,
+			    AMX_TABLE_NATIVES, (int)v, NULL);
+			return (amx_fnv1a(h, n, strlen(n) + 1));
+		}
+		return (amx_fnv1a(h, &v, sizeof(v)));
+	case OPND_DATA:
+		var = amx_find_variable(amx, v);
+		if (var != NULL)
+			return (amx_fnv1a(h, var->name, strlen(var->name) + 1));
+		return (amx_fnv1a(h, "d", 1));
+	default:
+		return (amx_fnv1a(h, &v, sizeof(v)));
+	}
+}
+
+/*
+ * Hash one function body with relocation-normalised operands: jumps
+ * inside the function become relative offsets, calls, natives and
+ * globals hash by name, and unnamed data addresses are dropped, so
+ * code that merely moved does not count as changed.
+ */
+static uint64_t
+amx_hash_function(const AmxImage *amx, const AmxFunction *fn)
+{
+	uint64_t	 h = 0xcbf29ce484222325ULL;
+	uint32_t	 cip, op, v;
+	int		 cells, i;
+
+	for (cip = fn->start; cip < fn->end; cip += (uint32_t)cells * 4) {
+		cells = dog_amx_insn_cells(amx, cip);
+		if (cells <= 0)
+			break;
+		op = (uint32_t)amx_rd32(amx->code + cip);
+		h = amx_fnv1a(h, &op, sizeof(op));
+		if (op >= AMX_NUM_OPCODES) {
+			continue;
+		}
+		for (i = 1; i < cells; i++) {
+			uint8_t	 kind;
+
+			v = (uint32_t)amx_rd32(amx->code + cip + (uint32_t)i * 4);
+			if (amx_opcodes[op].kind == OPND_CASETBL)
+				kind = (i >= 2 && (i % 2) == 0) ? OPND_CODE :
+				    OPND_NUM;
+			else if (amx_opcodes[op].kind == OPND_SKIP)
+				kind = OPND_NUM;
+			else
+				kind = (i == 1) ? amx_opcodes[op].kind :
+				    amx_opcodes[op].kind2;
+			h = amx_hash_operand(amx, fn, h, kind, v);
+		}
+	}
+	return (h);
+}
+
+static int
+amx_hash_name_cmp(const void *a, const void *b)
+{
+	const AmxFuncHash *ha = a, *hb = b;
+
+	if (ha->func->anonymous != hb->func->anonymous)
+		return (ha->func->anonymous - hb->func->anonymous);
+	if (ha->func->anonymous)
+		return ((ha->hash > hb->hash) - (ha->hash < hb->hash));
+	return (strcmp(ha->func->name, hb->func->name));
+}
+
+static AmxFuncHash *
+amx_hash_functions(const AmxImage *amx)
+{
+	AmxFuncHash	*fh;
+	int		 i;
+
+	fh = dog_calloc((size_t)amx->nfuncs + 1, sizeof(*fh));
+	if (fh == NULL)
+		return (NULL);
+	for (i = 0; i < amx->nfuncs; i++) {
+		fh[i].func = &amx->funcs[i];
+		fh[i].hash = amx_hash_function(amx, &amx->funcs[i]);
+	}
+	qsort(fh, (size_t)amx->nfuncs, sizeof(*fh), amx_hash_name_cmp);
+	return (fh);
+}
+
+static void
+amx_diff_data(const AmxImage *a, const AmxImage *b)
+{
+	const unsigned char *da, *db;
+	uint32_t	 la, lb, n, o, first = 0;
+	int		 cells = 0;
+
+	da = a->code + a->code_size;
+	db = b->code + b->code_size;
+	la = (uint32_t)(a->hea - a->dat);
+	lb = (uint32_t)(b->hea - b->dat);
+	n = (la < lb) ? la : lb;
+
+	for (o = 0; o + 4 <= n; o += 4) {
+		if (memcmp(da + o, db + o, 4) != 0) {
+			if (cells++ == 0)
+				first = o;
+		}
+	}
+
+	if (la == lb && cells == 0) {
+		printf(" data        : unchanged (%u bytes)\n", la);
+		return;
+	}
+	printf(" data        : %u -> %u bytes (%+d), %d cell(s) differ",
+	    la, lb, (int)lb - (int)la, cells);
+	if (cells > 0)
+		printf(", first at %08x", first);
+	printf("\n");
+}
+
+/*
+ * amx diff <old.amx> <new.amx>
+ * Compare two builds function by function.  Named functions (debug
+ * symbols, publics, main) are paired by name; anonymous ones are
+ * paired by body hash.  Returns the number of differences found, or
+ * -1 when either image cannot be loaded.
+ */
+int
+dog_amx_diff(const char *old_path, const char *new_path)
+{
+	AmxImage	 a, b;
+	AmxFuncHash	*ha = NULL, *hb = NULL;
+	int		 i, j, cmp;
+	int		 added = 0, removed = 0, changed = 0, same = 0;
+	int		 ret = -1;
+
+	if (dog_amx_open(old_path, &a) != 0)
+		return (-1);
+	if (dog_amx_open(new_path, &b) != 0) {
+		dog_amx_close(&a);
+		return (-1);
+	}
+	if (dog_amx_load_functions(&a) != 0 || dog_amx_load_functions(&b) != 0)
+		goto done;
+
+	ha = amx_hash_functions(&a);
+	hb = amx_hash_functions(&b);
+	if (ha == NULL || hb == NULL)
+		goto done;
+
+	printf(" amx diff    : " DOG_COL_YELLOW "%s" DOG_COL_DEFAULT
+	    " -> " DOG_COL_YELLOW "%s" DOG_COL_DEFAULT "\n", old_path, new_path);
+
+	/* both lists are sorted named-first, then by name or hash */
+	i = j = 0;
+	while (i < a.nfuncs || j < b.nfuncs) {
+		if (i >= a.nfuncs)
+			cmp = 1;
+		else if (j >= b.nfuncs)
+			cmp = -1;
+		else
+			cmp = amx_hash_name_cmp(&ha[i], &hb[j]);
+
+		if (cmp < 0) {
+			pr_color(stdout, DOG_COL_RED, "  - %s (%u bytes)\n",
+			    ha[i].func->name, ha[i].func->end - ha[i].func->start);
+			++removed;
+			++i;
+		} else if (cmp > 0) {
+			pr_color(stdout, DOG_COL_GREEN, "  + %s (%u bytes)\n",
+			    hb[j].func->name, hb[j].func->end - hb[j].func->start);
+			++added;
+			++j;
+		} else {
+			if (ha[i].hash != hb[j].hash) {
+				pr_color(stdout, DOG_COL_YELLOW,
+				    "  ~ %s (%u -> %u bytes)\n", ha[i].func->name,
+				    ha[i].func->end - ha[i].func->start,
+				    hb[j].func->end - hb[j].func->start);
+				++changed;
+			} else {
+				++same;
+			}
+			++i;
+			++j;
+		}
+	}
+
+	printf(" functions   : %d added, %d removed, %d changed, %d unchanged\n",
+	    added, removed, changed, same);
+	amx_diff_data(&a, &b);
+	fflush(stdout);
+
+	ret = added + removed + changed;
+	if (a.hea - a.dat != b.hea - b.dat ||
+	    memcmp(a.code + a.code_size, b.code + b.code_size,
+	    (size_t)(a.hea - a.dat)) != 0)
+		++ret;
+
+done:
+	dog_free(ha);
+	dog_free(hb);
+	dog_amx_close(&a);
+	dog_amx_close(&b);
+	return (ret);
+}
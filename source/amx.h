@@ -0,0 +1,88 @@
+/*-
+ * Copyright (c) 2026 Watchdogs Team and contributors
+ * All rights reserved. under The 2-Clause BSD License
+ * See COPYING or https://opensource.org/license/bsd-2-clause
+ */
+
+#ifndef AMX_H
+#define AMX_H
+
+#include "utils.h"
+
+#define AMX_MAGIC_32        0xF1E0
+#define AMX_MAGIC_DBG       0xF1EF
+#define AMX_HEADER_SIZE     56
+#define AMX_HEADER_SIZE_OVL 60
+
+#define AMX_FLAG_CHAR16     0x0001
+#define AMX_FLAG_DEBUG      0x0002
+#define AMX_FLAG_COMPACT    0x0004
+#define AMX_FLAG_BYTEOPC    0x0008
+#define AMX_FLAG_NOCHECKS   0x0010
+
+typedef enum {
+    AMX_TABLE_PUBLICS,
+    AMX_TABLE_NATIVES,
+    AMX_TABLE_LIBRARIES,
+    AMX_TABLE_PUBVARS,
+    AMX_TABLE_TAGS,
+    AMX_TABLE_MAX
+} AmxTable;
+
+typedef struct {
+    uint32_t start;                /* code offset of PROC */
+    uint32_t end;                  /* one past the last instruction */
+    int      anonymous;            /* no symbol, named after its address */
+    char     name[64];
+} AmxFunction;
+
+typedef struct {
+    uint32_t address;              /* data offset */
+    char     name[64];
+} AmxVariable;
+
+typedef struct {
+    const unsigned char *base;     /* mapped file */
+    size_t   length;               /* mapped length */
+    int      mapped;               /* 1 = mmap, 0 = heap copy */
+    int32_t  size;
+    uint16_t magic;
+    uint8_t  file_version;
+    uint8_t  amx_version;
+    uint16_t flags;
+    uint16_t defsize;
+    int32_t  cod;
+    int32_t  dat;
+    int32_t  hea;
+    int32_t  stp;
+    int32_t  cip;
+    int32_t  table[AMX_TABLE_MAX];
+    int32_t  nametable;
+    int32_t  overlays;
+    const unsigned char *code;     /* plain code, see dog_amx_load_code() */
+    int32_t  code_size;
+    unsigned char *code_heap;      /* expanded compact code */
+    AmxFunction *funcs;            /* sorted by start */
+    int      nfuncs;
+    AmxVariable *vars;             /* sorted by address */
+    int      nvars;
+} AmxImage;
+
+int dog_amx_open(const char *path, AmxImage *amx);
+void dog_amx_close(AmxImage *amx);
+
+int dog_amx_table_count(const AmxImage *amx, AmxTable table);
+const char *dog_amx_table_entry(const AmxImage *amx, AmxTable table,
+                                int index, uint32_t *address);
+int dog_amx_overlay_count(const AmxImage *amx);
+
+int dog_amx_load_code(AmxImage *amx);
+int dog_amx_load_functions(AmxImage *amx);
+int dog_amx_insn_cells(const AmxImage *amx, uint32_t cip);
+
+int dog_amx_info(const char *path, const char *section);
+int dog_amx_disasm(const char *path, const char *functions,
+                   const char *output, const char *split_dir);
+int dog_amx_diff(const char *old_path, const char *new_path);
+
+#endif
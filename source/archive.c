@@ -21,7 +21,8 @@ arch_extraction_path(const char *dest, const char *path,
 	{
 		snprintf(out, out_size, "%s", path);
 	} else {
-		if (strncmp(path, dest, strlen(dest)) == 0) {
+		if (strncmp(path, dest, strlen(dest)) == 0 &&
+		    (path[strlen(dest)] == '/' || path[strlen(dest)] == '\0')) {
 			snprintf(out, out_size, "%s", path);
 		} else {
 			snprintf(out, out_size, "%s" "%s" "%s",
@@ -685,6 +686,215 @@ error:
 	return (-1);
 }
 
+/*
+ * Extraction straight off a download.  libarchive pulls the body from
+ * the stream piece by piece, and every regular file that `route' gives
+ * a destination for is written there directly (through a ".part" file
+ * renamed into place); everything else is skipped without touching the
+ * disk.  `placed' is told about each file once it is in place.
+ */
+static la_ssize_t
+arch_stream_read(struct archive *a, void *udata, const void **buf)
+{
+	long	 n;
+
+	n = dog_stream_read(udata, buf);
+	if (n < 0) {
+		archive_set_error(a, EIO, "download failed");
+		return (-1);
+	}
+	return ((la_ssize_t)n);
+}
+
+/* write the data of the current entry to `dest', through a ".part" file */
+static int
+arch_write_part(struct archive *a, const char *dest)
+{
+	char		 part[DOG_PATH_MAX * 2 + 8];
+	char		*sep;
+	const void	*block;
+	size_t		 size;
+	la_int64_t	 offset;
+	FILE		*fp;
+	int		 r;
+
+	snprintf(part, sizeof(part), "%s", dest);
+	sep = strrchr(part, _PATH_CHR_SEP_POSIX);
+	if (sep == NULL)
+		sep = strrchr(part, _PATH_CHR_SEP_WIN32);
+	if (sep != NULL) {
+		*sep = '\0';
+		if (dir_exists(part) == 0)
+			dog_mkdir_recursive(part);
+	}
+	snprintf(part, sizeof(part), "%s.part", dest);
+
+	fp = fopen(part, "wb");
+	if (fp == NULL) {
+		pr_error(stdout, "failed to create %s", part);
+		return (-1);
+	}
+	while ((r = archive_read_data_block(a, &block, &size,
+	    &offset)) == ARCHIVE_OK) {
+		if (fseek(fp, (long)offset, SEEK_SET) != 0 ||
+		    fwrite(block, 1, size, fp) != size) {
+			r = ARCHIVE_FATAL;
+			break;
+		}
+	}
+	if (fclose(fp) != 0 || r != ARCHIVE_EOF) {
+		pr_error(stdout, "failed to extract %s..: %s", dest,
+		    archive_error_string(a));
+		unlink(part);
+		return (-1);
+	}
+	remove(dest);
+	if (rename(part, dest) != 0) {
+		pr_error(stdout, "failed to move %s into place", dest);
+		unlink(part);
+		return (-1);
+	}
+	return (0);
+}
+
+int
+dog_extract_stream(struct dog_stream *stream, ArchiveRouteFn route,
+    ArchivePlacedFn placed, void *udata)
+{
+	struct archive		*a;
+	struct archive_entry	*entry;
+	char			 dest[DOG_PATH_MAX * 2];
+	int			 r, ret = 0;
+
+	a = archive_read_new();
+	if (a == NULL)
+		return (-1);
+	archive_read_support_format_all(a);
+	archive_read_support_filter_all(a);
+
+	if (archive_read_open(a, stream, NULL, arch_stream_read,
+	    NULL) != ARCHIVE_OK) {
+		pr_error(stdout, "failed to opening the stream..: %s",
+		    archive_error_string(a));
+		archive_read_free(a);
+		return (-1);
+	}
+
+	while ((r = archive_read_next_header(a, &entry)) == ARCHIVE_OK) {
+		if (archive_entry_filetype(entry) != AE_IFREG ||
+		    route(udata, archive_entry_pathname(entry), dest,
+		    sizeof(dest)) <= 0)
+			continue;
+		if (arch_write_part(a, dest) != 0) {
+			ret = -1;
+			break;
+		}
+		placed(udata, archive_entry_pathname(entry), dest);
+	}
+	if (ret == 0 && r != ARCHIVE_EOF) {
+		pr_error(stdout, "failed to reading header..: %s",
+		    archive_error_string(a));
+		ret = -1;
+	}
+
+	archive_read_free(a);
+	return (ret);
+}
+
+/*
+ * Extraction of an archive file that decides on every regular file by
+ * its header alone.  When `route' returns 0 the entry is skipped and
+ * its data never reaches the disk (a zip is not even inflated past
+ * it); ARCHIVE_ENTRY_KEEP extracts it under `dir' as
+ * dog_extract_archive would; any other value puts it at `dest' the way
+ * dog_extract_stream does.  Directories and links are left out, the
+ * directories of the files written are made as needed.  `placed', if
+ * given, is told about each file written.  Returns how many files were
+ * written, -1 on error.
+ */
+int
+dog_extract_filtered(const char *filename, const char *dir,
+    ArchiveRouteFn route, ArchivePlacedFn placed, void *udata)
+{
+	struct archive		*a, *ext;
+	struct archive_entry	*entry;
+	char			 name[DOG_PATH_MAX * 2], dest[DOG_PATH_MAX * 2];
+	int			 r, how, flags, ret = 0;
+
+	flags = ARCHIVE_EXTRACT_TIME;
+	if (!strend(filename, ".zip", true))
+		flags |= ARCHIVE_EXTRACT_PERM | ARCHIVE_EXTRACT_ACL |
+		    ARCHIVE_EXTRACT_FFLAGS;
+
+	a = archive_read_new();
+	ext = archive_write_disk_new();
+	if (a == NULL || ext == NULL) {
+		pr_error(stdout, "failed to creating archive handler");
+		minimal_debugging();
+		if (a != NULL)
+			archive_read_free(a);
+		if (ext != NULL)
+			archive_write_free(ext);
+		return (-1);
+	}
+	archive_read_support_format_all(a);
+	archive_read_support_filter_all(a);
+	archive_write_disk_set_options(ext, flags);
+	archive_write_disk_set_standard_lookup(ext);
+
+	if (archive_read_open_filename(a, filename, 1024 * 1024) !=
+	    ARCHIVE_OK) {
+		pr_error(stdout, "failed to opening the archive: %s..: %s",
+		    filename, archive_error_string(a));
+		minimal_debugging();
+		archive_read_free(a);
+		archive_write_free(ext);
+		return (-1);
+	}
+
+	while ((r = archive_read_next_header(a, &entry)) == ARCHIVE_OK) {
+		if (archive_entry_filetype(entry) != AE_IFREG ||
+		    archive_entry_pathname(entry) == NULL)
+			continue;
+		snprintf(name, sizeof(name), "%s",
+		    archive_entry_pathname(entry));
+		how = route(udata, name, dest, sizeof(dest));
+		if (how == 0)
+			continue;
+
+		if (how == ARCHIVE_ENTRY_KEEP) {
+			arch_extraction_path(dir, name, dest, sizeof(dest));
+			archive_entry_set_pathname(entry, dest);
+			if (archive_write_header(ext, entry) != ARCHIVE_OK ||
+			    arch_copy_data(a, ext) != ARCHIVE_OK ||
+			    archive_write_finish_entry(ext) != ARCHIVE_OK) {
+				pr_error(stdout, "failed to extract %s..: %s",
+				    dest, archive_error_string(ext));
+				ret = -1;
+				break;
+			}
+		} else if (arch_write_part(a, dest) != 0) {
+			ret = -1;
+			break;
+		}
+		++ret;
+		if (placed != NULL)
+			placed(udata, name, dest);
+	}
+	if (ret >= 0 && r != ARCHIVE_EOF) {
+		pr_error(stdout, "failed to reading header: %s..: %s",
+		    filename, archive_error_string(a));
+		minimal_debugging();
+		ret = -1;
+	}
+
+	archive_read_close(a);
+	archive_read_free(a);
+	archive_write_close(ext);
+	archive_write_free(ext);
+	return (ret);
+}
+
 void
 destroy_arch_dir(const char *filename)
 {
@@ -33,4 +33,25 @@ is_archive_file(const char *filename);
 
 void dog_extract_archive(const char *filename, const char *dir);
 
+struct dog_stream;
+
+/*
+ * Destination for an archive entry: fill `dest' and return a positive
+ * value to extract the entry there, return 0 to skip it.  For
+ * dog_extract_filtered ARCHIVE_ENTRY_KEEP extracts it under the
+ * extraction directory as it is named.
+ */
+#define ARCHIVE_ENTRY_KEEP	(-1)
+
+typedef int (*ArchiveRouteFn)(void *udata, const char *entry,
+                              char *dest, size_t size);
+typedef void (*ArchivePlacedFn)(void *udata, const char *entry,
+                                const char *dest);
+
+int dog_extract_stream(struct dog_stream *stream, ArchiveRouteFn route,
+                       ArchivePlacedFn placed, void *udata);
+int dog_extract_filtered(const char *filename, const char *dir,
+                         ArchiveRouteFn route, ArchivePlacedFn placed,
+                         void *udata);
+
 #endif
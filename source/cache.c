@@ -0,0 +1,631 @@
+/*-
+ * Copyright (c) 2026 Watchdogs Team and contributors
+ * All rights reserved. under The 2-Clause BSD License
+ * See COPYING or https://opensource.org/license/bsd-2-clause
+ */
+
+#include  <utime.h>
+#include  <sys/stat.h>
+#if defined(DOG_LINUX) && !defined(DOG_ANDROID)
+#include  <sys/ioctl.h>
+#include  <linux/fs.h>
+#endif
+
+#include  "utils.h"
+#include  "curl.h"
+#include  "crypto.h"
+#include  "cache.h"
+
+/*
+ * Archive store shared by every server directory of the user.  Each
+ * downloaded archive is kept once under objects/, named by the SHA-256
+ * of its content, and urls/ maps the SHA-256 of every URL it was
+ * fetched from to that object.  An URL is never revalidated, so only
+ * those pinned to a tag are kept: branch archives, "latest" links and
+ * local file:// sources are left out.  An archive is handed out as a
+ * reflink or a copy, so nothing done to it reaches the cache.  Using
+ * an object bumps its mtime, and the least recently used objects are
+ * evicted once the store grows past archive_cache_max megabytes.
+ */
+
+#define CACHE_HEX_LEN	(SHA256_DIGEST_LENGTH * 2)
+#define CACHE_PATH_MAX	(DOG_PATH_MAX + 128)
+
+typedef struct {
+	char		 name[CACHE_HEX_LEN + 1];
+	long long	 size;
+	time_t		 used;
+} CacheObject;
+
+static int
+cache_base(char *dir, size_t size)
+{
+	char	 sub[CACHE_PATH_MAX];
+
+	if (dogconfig.dog_toml_archive_cache_max <= 0 ||
+	    dog_cache_dir(CACHE_ARCHIVES, dir, size) != 0)
+		return (-1);
+	snprintf(sub, sizeof(sub), "%s/objects", dir);
+	if (dir_exists(sub) == 0 && dog_mkdir_recursive(sub) != 0)
+		return (-1);
+	snprintf(sub, sizeof(sub), "%s/urls", dir);
+	if (dir_exists(sub) == 0 && dog_mkdir_recursive(sub) != 0)
+		return (-1);
+	return (0);
+}
+
+static void
+cache_hex(const unsigned char *digest, char *out)
+{
+	static const char	 hex[] = "0123456789abcdef";
+	int			 i;
+
+	for (i = 0; i < SHA256_DIGEST_LENGTH; i++) {
+		out[i * 2] = hex[digest[i] >> 4];
+		out[i * 2 + 1] = hex[digest[i] & 0xF];
+	}
+	out[CACHE_HEX_LEN] = '\0';
+}
+
+/* hex SHA-256 of the file at `path', read through the streaming API */
+static int
+cache_hash_file(const char *path, char *out, uint64_t *size)
+{
+	SHA256_CTX	 ctx;
+	unsigned char	 buf[65536], digest[SHA256_DIGEST_LENGTH];
+	size_t		 n;
+	FILE		*fp;
+
+	fp = fopen(path, "rb");
+	if (fp == NULL)
+		return (-1);
+	crypto_sha256_init(&ctx);
+	*size = 0;
+	while ((n = fread(buf, 1, sizeof(buf), fp)) > 0) {
+		crypto_sha256_update(&ctx, buf, n);
+		*size += n;
+	}
+	if (ferror(fp)) {
+		fclose(fp);
+		return (-1);
+	}
+	fclose(fp);
+	crypto_sha256_final(&ctx, digest);
+	cache_hex(digest, out);
+	return (0);
+}
+
+/*
+ * URLs whose content moves under them: branch archives and "latest"
+ * links.  Only what is pinned to a tag is worth keeping.
+ */
+static int
+cache_url_mutable(const char *url)
+{
+	if (strncmp(url, "file:", 5) == 0 ||
+	    strstr(url, "/refs/heads/") != NULL ||
+	    strstr(url, "/latest/") != NULL)
+		return (1);
+	/* GitLab and Gitea archives here are always of a branch */
+	return (strstr(url, "/archive/") != NULL &&
+	    strstr(url, "/refs/tags/") == NULL);
+}
+
+static int
+cache_url_key(const char *url, char *out)
+{
+	unsigned char	 digest[SHA256_DIGEST_LENGTH];
+
+	if (!crypto_generate_sha256_hash(url, digest))
+		return (-1);
+	cache_hex(digest, out);
+	return (0);
+}
+
+/* a copy of `src' at `dst' sharing its extents, where supported */
+static int
+cache_reflink(const char *src, const char *dst, mode_t mode)
+{
+#if defined(FICLONE)
+	int	 in, out, ret;
+
+	in = open(src, O_RDONLY);
+	if (in < 0)
+		return (-1);
+	out = open(dst, O_WRONLY | O_CREAT | O_TRUNC, mode);
+	if (out < 0) {
+		close(in);
+		return (-1);
+	}
+	ret = ioctl(out, FICLONE, in);
+	close(in);
+	close(out);
+	if (ret != 0)
+		unlink(dst);
+	return (ret == 0 ? 0 : -1);
+#else
+	(void)src;
+	(void)dst;
+	(void)mode;
+	return (-1);
+#endif
+}
+
+/*
+ * A reflink where the file system can share extents, else a plain
+ * copy; never a hard link, which would let an edit of the copy write
+ * through into the cache.
+ */
+static int
+cache_copy(const char *src, const char *dst)
+{
+	char	 buf[65536];
+	size_t	 n;
+	FILE	*in, *out;
+	int	 ok = 1;
+
+	remove(dst);
+	if (cache_reflink(src, dst, 0644) == 0)
+		return (0);
+	in = fopen(src, "rb");
+	if (in == NULL)
+		return (-1);
+	out = fopen(dst, "wb");
+	if (out == NULL) {
+		fclose(in);
+		return (-1);
+	}
+	while ((n = fread(buf, 1, sizeof(buf), in)) > 0)
+		if (fwrite(buf, 1, n, out) != n) {
+			ok = 0;
+			break;
+		}
+	if (ferror(in))
+		ok = 0;
+	fclose(in);
+	if (fclose(out) != 0)
+		ok = 0;
+	if (!ok) {
+		remove(dst);
+		return (-1);
+	}
+	return (0);
+}
+
+/* the object and size an URL entry points at */
+static int
+cache_url_read(const char *path, char *object, long long *size)
+{
+	char	 line[128];
+	FILE	*fp;
+	int	 ok;
+
+	fp = fopen(path, "r");
+	if (fp == NULL)
+		return (-1);
+	ok = fgets(line, sizeof(line), fp) != NULL &&
+	    strlen(line) > CACHE_HEX_LEN && line[CACHE_HEX_LEN] == ' ';
+	fclose(fp);
+	if (!ok)
+		return (-1);
+	memcpy(object, line, CACHE_HEX_LEN);
+	object[CACHE_HEX_LEN] = '\0';
+	*size = strtoll(line + CACHE_HEX_LEN + 1, NULL, 10);
+	return (0);
+}
+
+/*
+ * dog_cache_fetch
+ * Put the archive cached for `url' at `dest'.  Returns 0 on a hit,
+ * with the hex SHA-256 of the archive in `sha256' when that is not
+ * NULL, and -1 when the network has to be used.
+ */
+int
+dog_cache_fetch(const char *url, const char *dest, char *sha256)
+{
+	char		 dir[DOG_PATH_MAX], key[CACHE_HEX_LEN + 1],
+			 object[CACHE_HEX_LEN + 1], path[CACHE_PATH_MAX];
+	long long	 size;
+	struct stat	 st;
+
+	if (cache_url_mutable(url) ||
+	    cache_base(dir, sizeof(dir)) != 0 || cache_url_key(url, key) != 0)
+		return (-1);
+	snprintf(path, sizeof(path), "%s/urls/%s", dir, key);
+	if (cache_url_read(path, object, &size) != 0)
+		return (-1);
+
+	snprintf(path, sizeof(path), "%s/objects/%s", dir, object);
+	if (stat(path, &st) != 0 || (long long)st.st_size != size)
+		return (-1);
+	if (cache_copy(path, dest) != 0)
+		return (-1);
+	utime(path, NULL);
+	if (sha256 != NULL)
+		memcpy(sha256, object, CACHE_HEX_LEN + 1);
+	return (0);
+}
+
+/*
+ * dog_cache_store
+ * Add the archive at `path', downloaded from `url', to the store and
+ * evict down to the size limit.  `sha256' is its hex digest when the
+ * download already worked it out, else NULL to have the file hashed.
+ */
+void
+dog_cache_store(const char *url, const char *path, const char *sha256)
+{
+	char		 dir[DOG_PATH_MAX], key[CACHE_HEX_LEN + 1],
+			 object[CACHE_HEX_LEN + 1], dest[CACHE_PATH_MAX],
+			 tmp[CACHE_PATH_MAX + 8], entry[CACHE_PATH_MAX + 8];
+	uint64_t	 size;
+	struct stat	 st;
+	FILE		*fp;
+
+	if (cache_url_mutable(url) ||
+	    cache_base(dir, sizeof(dir)) != 0 || cache_url_key(url, key) != 0)
+		return;
+	if (sha256 != NULL && strlen(sha256) == CACHE_HEX_LEN) {
+		if (stat(path, &st) != 0)
+			return;
+		memcpy(object, sha256, CACHE_HEX_LEN + 1);
+		size = (uint64_t)st.st_size;
+	} else if (cache_hash_file(path, object, &size) != 0)
+		return;
+	if (size == 0)
+		return;
+
+	snprintf(dest, sizeof(dest), "%s/objects/%s", dir, object);
+	if (path_exists(dest) == 1) {
+		utime(dest, NULL);
+	} else {
+		snprintf(tmp, sizeof(tmp), "%s.tmp", dest);
+		if (cache_copy(path, tmp) != 0)
+			return;
+		if (rename(tmp, dest) != 0) {
+			remove(tmp);
+			return;
+		}
+	}
+
+	snprintf(entry, sizeof(entry), "%s/urls/%s", dir, key);
+	snprintf(tmp, sizeof(tmp), "%s/urls/%s.tmp", dir, key);
+	fp = fopen(tmp, "w");
+	if (fp == NULL)
+		return;
+	fprintf(fp, "%s %llu\n%s\n", object, (unsigned long long)size, url);
+	if (fclose(fp) != 0) {
+		remove(tmp);
+		return;
+	}
+#ifdef DOG_WINDOWS
+	remove(entry);
+#endif
+	if (rename(tmp, entry) != 0)
+		remove(tmp);
+
+	dog_cache_prune(-1);
+}
+
+static int
+cache_object_cmp(const void *a, const void *b)
+{
+	const CacheObject	*x = a, *y = b;
+
+	return ((x->used > y->used) - (x->used < y->used));
+}
+
+/* every finished object in the store, oldest use first */
+static CacheObject *
+cache_objects(const char *dir, int *count, long long *total)
+{
+	char		 path[CACHE_PATH_MAX];
+	CacheObject	*objs = NULL, *p;
+	DIR		*dirp;
+	struct dirent	*dent;
+	struct stat	 st;
+	int		 n = 0, cap = 0;
+
+	*count = 0;
+	*total = 0;
+	snprintf(path, sizeof(path), "%s/objects", dir);
+	dirp = opendir(path);
+	if (dirp == NULL)
+		return (NULL);
+	while ((dent = readdir(dirp)) != NULL) {
+		if (strlen(dent->d_name) != CACHE_HEX_LEN)
+			continue;
+		snprintf(path, sizeof(path), "%s/objects/%s", dir,
+		    dent->d_name);
+		if (stat(path, &st) != 0)
+			continue;
+		if (n == cap) {
+			cap = cap ? cap * 2 : 64;
+			p = dog_realloc(objs, (size_t)cap * sizeof(*objs));
+			if (p == NULL)
+				break;
+			objs = p;
+		}
+		memcpy(objs[n].name, dent->d_name, CACHE_HEX_LEN + 1);
+		objs[n].size = (long long)st.st_size;
+		objs[n].used = st.st_mtime;
+		*total += objs[n].size;
+		++n;
+	}
+	closedir(dirp);
+	if (n > 1)
+		qsort(objs, (size_t)n, sizeof(*objs), cache_object_cmp);
+	*count = n;
+	return (objs);
+}
+
+/* URL entries, dropping those whose object is gone */
+static int
+cache_urls_sweep(const char *dir)
+{
+	char		 path[CACHE_PATH_MAX], object[CACHE_HEX_LEN + 1],
+			 target[CACHE_PATH_MAX];
+	long long	 size;
+	DIR		*dirp;
+	struct dirent	*dent;
+	int		 n = 0;
+
+	snprintf(path, sizeof(path), "%s/urls", dir);
+	dirp = opendir(path);
+	if (dirp == NULL)
+		return (0);
+	while ((dent = readdir(dirp)) != NULL) {
+		if (strlen(dent->d_name) != CACHE_HEX_LEN)
+			continue;
+		snprintf(path, sizeof(path), "%s/urls/%s", dir, dent->d_name);
+		if (cache_url_read(path, object, &size) == 0) {
+			snprintf(target, sizeof(target), "%s/objects/%s", dir,
+			    object);
+			if (path_exists(target) == 1) {
+				++n;
+				continue;
+			}
+		}
+		remove(path);
+	}
+	closedir(dirp);
+	return (n);
+}
+
+/*
+ * dog_cache_prune
+ * Evict least recently used archives until the store holds at most
+ * `max_bytes' (the configured limit when negative).  Returns the
+ * number of archives removed, or -1 when there is no store.
+ */
+int
+dog_cache_prune(long long max_bytes)
+{
+	char		 dir[DOG_PATH_MAX], path[CACHE_PATH_MAX];
+	CacheObject	*objs;
+	long long	 total;
+	int		 i, count, removed = 0;
+
+	if (cache_base(dir, sizeof(dir)) != 0)
+		return (-1);
+	if (max_bytes < 0)
+		max_bytes = (long long)dogconfig.dog_toml_archive_cache_max *
+		    1024 * 1024;
+
+	objs = cache_objects(dir, &count, &total);
+	for (i = 0; i < count && total > max_bytes; i++) {
+		snprintf(path, sizeof(path), "%s/objects/%s", dir,
+		    objs[i].name);
+		if (remove(path) != 0)
+			continue;
+		total -= objs[i].size;
+		++removed;
+	}
+	dog_free(objs);
+	if (removed > 0)
+		cache_urls_sweep(dir);
+	return (removed);
+}
+
+int
+dog_cache_stats(void)
+{
+	char		 dir[DOG_PATH_MAX], when[64];
+	CacheObject	*objs;
+	long long	 total, cap;
+	int		 count, urls;
+
+	if (cache_base(dir, sizeof(dir)) != 0) {
+		pr_info(stdout, "archive cache is off (archive_cache_max = 0)");
+		return (-1);
+	}
+	objs = cache_objects(dir, &count, &total);
+	urls = cache_urls_sweep(dir);
+	cap = (long long)dogconfig.dog_toml_archive_cache_max * 1024 * 1024;
+
+	printf("archive cache: %s\n", dir);
+	printf("  archives : %d (%d URLs)\n", count, urls);
+	printf("  size     : %.1f MB of %.1f MB (%.0f%%)\n",
+	    (double)total / (1024.0 * 1024.0),
+	    (double)cap / (1024.0 * 1024.0),
+	    cap > 0 ? (double)total * 100.0 / (double)cap : 0.0);
+	if (count > 0) {
+		strftime(when, sizeof(when), "%Y-%m-%d %H:%M",
+		    localtime(&objs[0].used));
+		printf("  oldest   : %s\n", when);
+		strftime(when, sizeof(when), "%Y-%m-%d %H:%M",
+		    localtime(&objs[count - 1].used));
+		printf("  newest   : %s\n", when);
+	}
+	dog_free(objs);
+	return (0);
+}
+
+/*
+ * Installed file store.  With link_store on, every include, plugin and
+ * component put into a server directory is copied into store/, named
+ * by the SHA-256 of its content, and put back as a reflink of that
+ * object, so every server directory shares its extents.  The installed
+ * file never shares an inode with the store, so editing it or changing
+ * its mode cannot reach the stored copy.  A plain copy would only add
+ * to the disk use the store is meant to cut, so where the file system
+ * cannot reflink (ext4, across devices) the store is skipped for the
+ * rest of the run, with one warning.  Using an object bumps its mtime,
+ * and objects left unused for STORE_IDLE_DAYS are pruned.
+ */
+
+#define STORE_IDLE_DAYS	30
+
+static int	store_unshared;	/* a reflink into the store failed */
+
+static int
+store_base(char *dir, size_t size)
+{
+	if (!dogconfig.dog_toml_link_store ||
+	    dog_cache_dir(CACHE_STORE, dir, size) != 0)
+		return (-1);
+	if (dir_exists(dir) == 0 && dog_mkdir_recursive(dir) != 0)
+		return (-1);
+	return (0);
+}
+
+/*
+ * dog_store_place
+ * Swap the file installed at `path' for a reflink of its stored copy.
+ * Returns 0 when it now shares extents with the store, -1 when it was
+ * left alone.
+ */
+int
+dog_store_place(const char *path)
+{
+#ifdef DOG_WINDOWS
+	(void)path;
+	return (-1);
+#else
+	char		 dir[DOG_PATH_MAX], object[CACHE_PATH_MAX],
+			 hex[CACHE_HEX_LEN + 1], tmp[CACHE_PATH_MAX + 16];
+	uint64_t	 size;
+	struct stat	 st, ost;
+
+	if (store_unshared || store_base(dir, sizeof(dir)) != 0 ||
+	    lstat(path, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0)
+		return (-1);
+	if (cache_hash_file(path, hex, &size) != 0)
+		return (-1);
+	snprintf(object, sizeof(object), "%s/%s", dir, hex);
+
+	if (stat(object, &ost) != 0) {
+		/* first copy: the store keeps its own, read-only */
+		snprintf(tmp, sizeof(tmp), "%s.tmp", object);
+		if (cache_reflink(path, tmp, 0444) != 0) {
+			store_unshared = 1;
+			pr_warning(stdout, "link_store: cannot reflink %s "
+			    "into %s, keeping plain copies", path, dir);
+			return (-1);
+		}
+		if (rename(tmp, object) != 0) {
+			unlink(tmp);
+			return (-1);
+		}
+		return (0);	/* it shares the extents of the installed file */
+	} else if ((uint64_t)ost.st_size != size) {
+		return (-1);
+	}
+	utime(object, NULL);
+
+	snprintf(tmp, sizeof(tmp), "%s.store", path);
+	unlink(tmp);
+	if (cache_reflink(object, tmp, st.st_mode & 0777) != 0) {
+		store_unshared = 1;
+		pr_warning(stdout, "link_store: cannot reflink %s "
+		    "from %s, keeping plain copies", path, dir);
+		return (-1);
+	}
+	if (rename(tmp, path) != 0) {
+		unlink(tmp);
+		return (-1);
+	}
+	return (0);
+#endif
+}
+
+/*
+ * Count the stored files and those unused for STORE_IDLE_DAYS,
+ * removing the latter when `prune' is set.  Returns the number
+ * removed.
+ */
+static int
+store_scan(const char *dir, int prune, int *count, long long *total,
+    int *idle, long long *idle_bytes)
+{
+	char		 path[CACHE_PATH_MAX];
+	DIR		*dirp;
+	struct dirent	*dent;
+	struct stat	 st;
+	time_t		 cutoff;
+	int		 removed = 0;
+
+	*count = *idle = 0;
+	*total = *idle_bytes = 0;
+	cutoff = time(NULL) - (time_t)STORE_IDLE_DAYS * 24 * 60 * 60;
+	dirp = opendir(dir);
+	if (dirp == NULL)
+		return (0);
+	while ((dent = readdir(dirp)) != NULL) {
+		if (strlen(dent->d_name) != CACHE_HEX_LEN)
+			continue;
+		snprintf(path, sizeof(path), "%s/%s", dir, dent->d_name);
+		if (stat(path, &st) != 0)
+			continue;
+		if (st.st_mtime < cutoff && prune && remove(path) == 0) {
+			++removed;
+			continue;
+		}
+		++*count;
+		*total += (long long)st.st_size;
+		if (st.st_mtime < cutoff) {
+			++*idle;
+			*idle_bytes += (long long)st.st_size;
+		}
+	}
+	closedir(dirp);
+	return (removed);
+}
+
+/*
+ * dog_store_prune
+ * Drop stored files no install has used for STORE_IDLE_DAYS.  Installed
+ * files are never the stored inode, so this only costs sharing with
+ * later installs.  Returns the number removed, or -1 when the store is
+ * off.
+ */
+int
+dog_store_prune(void)
+{
+	char		 dir[DOG_PATH_MAX];
+	long long	 total, idle_bytes;
+	int		 count, idle;
+
+	if (store_base(dir, sizeof(dir)) != 0)
+		return (-1);
+	return (store_scan(dir, 1, &count, &total, &idle, &idle_bytes));
+}
+
+void
+dog_store_stats(void)
+{
+	char		 dir[DOG_PATH_MAX];
+	long long	 total, idle_bytes;
+	int		 count, idle;
+
+	if (store_base(dir, sizeof(dir)) != 0) {
+		pr_info(stdout, "file store is off (link_store = false)");
+		return;
+	}
+	store_scan(dir, 0, &count, &total, &idle, &idle_bytes);
+	printf("file store: %s\n", dir);
+	printf("  files    : %d, %.1f MB\n", count,
+	    (double)total / (1024.0 * 1024.0));
+	printf("  idle     : %d, %.1f MB (unused for %d days)\n", idle,
+	    (double)idle_bytes / (1024.0 * 1024.0), STORE_IDLE_DAYS);
+}
@@ -0,0 +1,24 @@
+/*-
+ * Copyright (c) 2026 Watchdogs Team and contributors
+ * All rights reserved. under The 2-Clause BSD License
+ * See COPYING or https://opensource.org/license/bsd-2-clause
+ */
+
+#ifndef CACHE_H
+#define CACHE_H
+
+#include "utils.h"
+
+#define CACHE_ARCHIVES "archives"
+#define CACHE_STORE "store"
+
+int dog_cache_fetch(const char *url, const char *dest, char *sha256);
+void dog_cache_store(const char *url, const char *path, const char *sha256);
+int dog_cache_stats(void);
+int dog_cache_prune(long long max_bytes);
+
+int dog_store_place(const char *path);
+int dog_store_prune(void);
+void dog_store_stats(void);
+
+#endif
@@ -9,6 +9,8 @@
 #include  "crypto.h"
 #include  "debug.h"
 #include  "replicate.h"
+#include  "compiler.h"
+#include  "include.h"
 #include  "cause.h"
 
 extern causeExplanation ccs[];
@@ -113,6 +115,85 @@ static void compiler_detailed(const char *dog_output, int debug,
     print_restore_color();
 }
 
+/* headers offered during the current compile's report */
+static char offered[32][DOG_PATH_MAX];
+static int n_offered = 0;
+
+/*
+ * error 017: name the header that declares the symbol and offer to
+ * add the #include to the file that failed, once per header and
+ * compile.
+ */
+static void cause_suggest_include(const char *line)
+{
+    char symbol[64], header[DOG_PATH_MAX], where[DOG_PATH_MAX];
+    char source[DOG_PATH_MAX], directive[DOG_PATH_MAX + 16];
+    const char *p, *q;
+    size_t len;
+
+    p = strstr(line, "undefined symbol \"");
+    if (!p)
+        return;
+    p += strlen("undefined symbol \"");
+    q = strchr(p, '"');
+    if (!q || q == p || (size_t)(q - p) >= sizeof(symbol))
+        return;
+    memcpy(symbol, p, (size_t)(q - p));
+    symbol[q - p] = '\0';
+
+    if (dog_include_suggest(compiler_full_includes, symbol, header,
+                            sizeof(header), where, sizeof(where)) != 1)
+        return;
+
+    pr_color(stdout, DOG_COL_CYAN, "  \"%s\" is declared in %s - #include <%s>\n",
+             symbol, where, header);
+
+    for (int i = 0; i < n_offered; ++i)
+        if (strcmp(offered[i], header) == 0)
+            return;
+    if (n_offered < 32)
+        snprintf(offered[n_offered++], DOG_PATH_MAX, "%s", header);
+
+    /* "file.pwn(12) : error 017: ..." */
+    q = strchr(line, '(');
+    len = q ? (size_t)(q - line) : 0;
+    if (len == 0 || len >= sizeof(source))
+        return;
+    memcpy(source, line, len);
+    source[len] = '\0';
+    if (path_exists(source) == 0 || !isatty(STDIN_FILENO))
+        return;
+
+    printf("\x1b[32m==> Add #include <%s> to %s?\x1b[0m\n", header, source);
+    char *confirm = readline("   answer (y/n): ");
+    fflush(stdout);
+    if (confirm && (confirm[0] == '\0' || strfind(confirm, "Y", true))) {
+        snprintf(directive, sizeof(directive), "#include <%s>", header);
+        package_add_include(source, directive,
+                            fetch_server_env() == 2 ? "#include <open.mp>" :
+                                                      "#include <a_samp>");
+    }
+    dog_free(confirm);
+}
+
+/*
+ * Plain (non --detailed) output: the log has been printed as it is,
+ * follow it with an include suggestion for each undefined symbol.
+ */
+void cause_compiler_suggest(const char *log_file)
+{
+    FILE *_log_file = fopen(log_file, "r");
+    char compiler_line[DOG_MORE_MAX_PATH];
+
+    if (!_log_file)
+        return;
+    n_offered = 0;
+    while (fgets(compiler_line, sizeof(compiler_line), _log_file))
+        if (strstr(compiler_line, "error 017"))
+            cause_suggest_include(compiler_line);
+    fclose(_log_file);
+}
+
 void cause_compiler_expl(const char *log_file, const char *dog_output, int debug)
 {
     minimal_debugging();
@@ -120,6 +201,7 @@ void cause_compiler_expl(const char *log_file, const char *dog_output, int debug
     FILE *_log_file = fopen(log_file, "r");
     if (!_log_file)
         return;
+    n_offered = 0;
 
     long warning_count = 0, error_count = 0;
     int header_size = 0, code_size = 0, data_size = 0, stack_size = 0, total_size = 0;
@@ -202,6 +284,8 @@ void cause_compiler_expl(const char *log_file, const char *dog_output, int debug
             }
 #endif
             pr_color(stdout, DOG_COL_CYAN, "^ %s \n", description);
+            if (strstr(compiler_line, "error 017"))
+                cause_suggest_include(compiler_line);
         }
     }
 
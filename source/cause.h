@@ -209,5 +209,6 @@ typedef struct {
 #define COMPILER_DT_SEL0000038 "Trailing tokens after preprocessor directive. Preprocessor directives must occupy complete logical line (except line continuation). Common with stray semicolons or comments on `#include` lines."
 
 void cause_compiler_expl(const char *log_file,const char *dog_output,int debug);    
+void cause_compiler_suggest(const char *log_file);
 
 #endif
@@ -11,6 +11,9 @@
 #include  "crypto.h"
 #include  "cause.h"
 #include  "compiler.h"
+#include  "pawnc.h"
+#include  "include.h"
+#include  "xref.h"
 
 /*
  * Compiler option flags mapping table.
@@ -39,6 +42,11 @@ static bool    		compiler_dog_flag_compat = false;	/* Compatibility mode flag */
 static bool    		compiler_dog_flag_prolix = false;	/* Verbose output flag */
 static bool    		compiler_dog_flag_compact = false;	/* Compact output flag */
 static bool    		compiler_dog_flag_fast = false;	/* Fast compilation flag */
+static bool    		compiler_dog_flag_inproc = false;	/* In-process libpawnc flag */
+static bool    		compiler_dog_flag_prune = false;	/* Include path pruning */
+static bool    		compiler_dog_flag_analyze = false;	/* Per-include cost analysis */
+static bool    		compiler_dog_flag_xref = false;	/* Symbol cross-reference database */
+static char          *compiler_option_flags = NULL;	/* pawncc options after -o */
 
 static OptionMap compiler_all_flag_map[] = {
 #define _detailed "--detailed"
@@ -50,6 +58,10 @@ static OptionMap compiler_all_flag_map[] = {
 #define _compact "--compact"
 #define _prolix "--prolix"
 #define _fast "--fast"
+#define _inproc "--inproc"
+#define _prune "--prune-includes"
+#define _analyze "--analyze"
+#define _xref "--xref"
     {_detailed,       "-w",
     	&compiler_dog_flag_detailed},
     {_watchdogs,      "-w",
@@ -68,6 +80,14 @@ static OptionMap compiler_all_flag_map[] = {
     	&compiler_dog_flag_prolix},
     {_fast,           "-f",
     	&compiler_dog_flag_fast},
+    {_inproc,         "-l",
+    	&compiler_dog_flag_inproc},
+    {_prune,          "-u",
+    	&compiler_dog_flag_prune},
+    {_analyze,        "-z",
+    	&compiler_dog_flag_analyze},
+    {_xref,           "-x",
+    	&compiler_dog_flag_xref},
     {NULL, NULL, NULL}
 };
 
@@ -136,7 +156,10 @@ compiler_refresh_data ( void )  {
 	compiler_dog_flag_detailed = false, compiler_dog_flag_debug = false,
 	compiler_dog_flag_clean = false, compiler_dog_flag_asm = false,
 	compiler_dog_flag_compat = false, compiler_dog_flag_prolix = false,
-	compiler_dog_flag_compact = false, compiler_long_time = false,
+	compiler_dog_flag_compact = false, compiler_dog_flag_inproc = false,
+	compiler_dog_flag_prune = false, compiler_dog_flag_analyze = false,
+	compiler_dog_flag_xref = false,
+	compiler_long_time = false,
 	compiler_empty_dog_flag = false, compiler_unix_file_fail = false,
 	compiler_retry_stat = 0;
 
@@ -170,7 +193,7 @@ compiler_refresh_data ( void )  {
  * that contain the library to the environment variable.
  */
 static void
-compiler_configure_libpath(void)
+compiler_configure_libpath(const char *pawncc_path)
 {
 #ifdef DOG_LINUX
 	if ((getenv("WSL_INTEROP") || getenv("WSL_DISTRO_NAME")) &&
@@ -221,10 +244,24 @@ compiler_configure_libpath(void)
 	if (len > 0) {
 		setenv("LD_LIBRARY_PATH", buf, 1);
 		done = 1;
-	} else {
-		pr_warning(stdout,
-		    "libpawnc.so not found in any target path..");
+		return;
+	}
+
+	/* pawncc finds a libpawnc.so of its own directory by itself */
+	if (compiler_dog_flag_inproc == true &&
+	    dog_pawnc_load(pawncc_path) == 0)
+		return;
+	if (pawncc_path != NULL && strrchr(pawncc_path, '/') != NULL) {
+		n = snprintf(so, sizeof(so), "%.*s/libpawnc.so",
+		    (int)(strrchr(pawncc_path, '/') - pawncc_path),
+		    pawncc_path);
+		if (n > 0 && (size_t)n < sizeof(so) && path_exists(so))
+			return;
 	}
+	pr_warning(stdout,
+	    "libpawnc.so not found in any target path..");
+#else
+	(void)pawncc_path;
 #endif
 }
 
@@ -290,7 +327,7 @@ void compiler_stage_trying(const char *stage, int ms) {
 static
 void dog_proj_init(char *input_path, char *pawncc_path) {
 
-	compiler_configure_libpath();
+	compiler_configure_libpath(pawncc_path);
 	
 	static bool rate_init_proc = false;
 	if (rate_init_proc == false) {
@@ -460,7 +497,50 @@ int dog_exec_compiler_process(char *pawncc_path,
 	if (compiler_full_includes == NULL)
 		compiler_full_includes = strdup("-ipawno/include -iqawno/include -igamemodes");
 
-	dog_proj_init(pawncc_path, input_path);
+	/* Pass pawncc only the include paths the sources draw from */
+	static char *compiler_pruned_includes = NULL;
+	const char  *compiler_includes;
+	if (compiler_pruned_includes) {
+		dog_free(compiler_pruned_includes);
+		compiler_pruned_includes = NULL;
+	}
+	if (compiler_dog_flag_prune == true)
+		compiler_pruned_includes = dog_include_prune(pawncc_path,
+			input_path, compiler_full_includes, compiler_path_include_buf);
+	compiler_includes = compiler_pruned_includes ?
+		compiler_pruned_includes : compiler_full_includes;
+
+	/* Options after -o, kept for --analyze and --xref */
+	dog_free(compiler_option_flags);
+	compiler_option_flags = NULL;
+	size_t option_len = strlen(dogconfig.dog_toml_all_flags ?
+		dogconfig.dog_toml_all_flags : "") +
+		strlen(compiler_includes) +
+		strlen(compiler_path_include_buf) + 3;
+	compiler_option_flags = dog_malloc(option_len);
+	if (compiler_option_flags)
+		snprintf(compiler_option_flags, option_len, "%s %s %s",
+			dogconfig.dog_toml_all_flags ?
+			dogconfig.dog_toml_all_flags : "",
+			compiler_includes,
+			compiler_path_include_buf);
+
+	/* --analyze measures the includes instead of building */
+	if (compiler_dog_flag_analyze == true) {
+		if (compiler_option_flags)
+			dog_include_analyze(pawncc_path, input_path,
+				compiler_option_flags);
+		return (1);
+	}
+
+	/* --xref has pawncc write its cross-reference report */
+	const char *compiler_xref_opt = "";
+	if (compiler_dog_flag_xref == true) {
+		remove(XREF_REPORT);
+		compiler_xref_opt = " -r" XREF_REPORT;
+	}
+
+	dog_proj_init(input_path, pawncc_path);
 
 	/* Initialize log file path based on platform */
 #ifdef DOG_WINDOWS
@@ -507,13 +587,14 @@ int dog_exec_compiler_process(char *pawncc_path,
 		/* Build compiler command line string */
 		result_configure = snprintf(compiler_input,
 			sizeof(compiler_input),
-			"%s %s -o%s %s %s %s",
+			"%s %s -o%s %s %s %s%s",
 			pawncc_path,
 			input_path,
 			output_path,
 			dogconfig.dog_toml_all_flags,
-			compiler_full_includes,
-			compiler_path_include_buf);
+			compiler_includes,
+			compiler_path_include_buf,
+			compiler_xref_opt);
 
 		if (compiler_input_debug == true) {
 		#ifdef DOG_ANDROID
@@ -665,13 +746,14 @@ int dog_exec_compiler_process(char *pawncc_path,
 	#else
 		result_configure = snprintf(compiler_input,
 			sizeof(compiler_input),
-			"%s %s -o%s %s %s %s",
+			"%s %s -o%s %s %s %s%s",
 			pawncc_path,
 			input_path,
 			output_path,
 			dogconfig.dog_toml_all_flags,
-			compiler_full_includes,
-			compiler_path_include_buf);
+			compiler_includes,
+			compiler_path_include_buf,
+			compiler_xref_opt);
 
 		if (result_configure < 0 ||
 			result_configure >= sizeof(compiler_input)) {
@@ -789,6 +871,30 @@ int dog_exec_compiler_process(char *pawncc_path,
 				minimal_debugging();
 			}
 		#else
+			/* In-process compile through libpawnc.so when requested */
+			if (compiler_dog_flag_inproc == true) {
+				if (dog_pawnc_load(pawncc_path) == 0) {
+					int pawnc_status;
+					dog_include_preload(pawncc_path, input_path,
+						compiler_option_flags);
+					clock_gettime(CLOCK_MONOTONIC, &pre_start);
+					pawnc_status = dog_pawnc_compile(
+						dog_compiler_unix_args, COMPILER_LOG);
+					clock_gettime(CLOCK_MONOTONIC, &post_end);
+					if (pawnc_status >= 0) {
+						if (pawnc_status != 0 && pawnc_status != 1) {
+							pr_error(stdout,
+								"libpawnc compile exited with code (%d)",
+								pawnc_status);
+							minimal_debugging();
+						}
+						return (0);
+					}
+				}
+				pr_warning(stdout,
+					"libpawnc.so not usable, falling back to pawncc..");
+			}
+
 			posix_spawn_file_actions_t process_file_actions;
 			/* Initialize file actions for output redirection */
 			posix_spawn_file_actions_init(
@@ -1545,6 +1651,10 @@ dog_exec_compiler(const char *args, const char *compile_args_val,
 			if (_process != 0) {
 				goto compiler_end;
 			}
+			if (compiler_dog_flag_xref == true)
+				dog_xref_update(dogconfig.dog_sef_found_list[0],
+					dogconfig.dog_toml_proj_input,
+					compiler_option_flags);
 
 			/* Process compiler log output */
 			if (path_exists(".watchdogs/compiler.log")) {
@@ -1561,9 +1671,12 @@ dog_exec_compiler(const char *args, const char *compile_args_val,
 					goto compiler_done;
 				}
 
-				if (compiler_unix_file_fail == false)
+				if (compiler_unix_file_fail == false) {
 					dog_printfile(
 						".watchdogs/compiler.log");
+					cause_compiler_suggest(
+						".watchdogs/compiler.log");
+				}
 			}
 		compiler_done:
 			/* Check log file for compilation errors */
@@ -1903,6 +2016,11 @@ dog_exec_compiler(const char *args, const char *compile_args_val,
 				if (_process != 0) {
 					goto compiler_end;
 				}
+				if (compiler_dog_flag_xref == true)
+					dog_xref_update(
+						dogconfig.dog_sef_found_list[0],
+						compiler_proj_path,
+						compiler_option_flags);
 				if (compiler_proj_path) {
 					free(compiler_proj_path);
 					compiler_proj_path = NULL;
@@ -1923,9 +2041,12 @@ dog_exec_compiler(const char *args, const char *compile_args_val,
 						goto compiler_done2;
 					}
 
-					if (compiler_unix_file_fail == false)
+					if (compiler_unix_file_fail == false) {
 						dog_printfile(
 							".watchdogs/compiler.log");
+						cause_compiler_suggest(
+							".watchdogs/compiler.log");
+					}
 				}
 
 		compiler_done2:
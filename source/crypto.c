@@ -121,10 +121,17 @@ void crypto_crc32_init_table(void) {
       }
 }
 
-/* Compute CRC-32 checksum for given data using lookup table method */
-uint32_t crypto_generate_crc32(const void *data, size_t length) {
+/* Start a running CRC-32 */
+uint32_t crypto_crc32_init(void) {
+      /* The table is built on first use when nobody did it earlier */
+      if (crc32_table[1] == 0)
+            crypto_crc32_init_table();
+      return (0xFFFFFFFF); /* Initial CRC value (all bits set) */
+}
+
+/* Fold more data into a running CRC-32 */
+uint32_t crypto_crc32_update(uint32_t crc, const void *data, size_t length) {
       const uint8_t *bytes = (const uint8_t *)data;
-      uint32_t crc = 0xFFFFFFFF; /* Initial CRC value (all bits set) */
 
       /* Process each byte in the input data */
       for (size_t i = 0; i < length; i++) {
@@ -134,10 +141,22 @@ uint32_t crypto_generate_crc32(const void *data, size_t length) {
         crc = (crc >> 8) ^ crc32_table[index];
       }
 
-      /* Return final CRC after inverting all bits */
+      return (crc);
+}
+
+/* Finish a running CRC-32 by inverting all bits */
+uint32_t crypto_crc32_final(uint32_t crc) {
       return (crc ^ 0xFFFFFFFF);
 }
 
+/* Compute CRC-32 checksum for given data using lookup table method */
+uint32_t crypto_generate_crc32(const void *data, size_t length) {
+      uint32_t crc = crypto_crc32_init();
+
+      crc = crypto_crc32_update(crc, data, length);
+      return (crypto_crc32_final(crc));
+}
+
 /* DJB2 hash function - simple string hashing algorithm */
 uint32_t crypto_string_hash(const char *s)
 {
@@ -275,7 +294,7 @@ static void crypto_sha1_transform(SHA1_CTX *ctx, const uint8_t data[SHA1_BLOCK_S
 }
 
 /* Initialize SHA-1 context with initial hash values */
-static void crypto_sha1_init(SHA1_CTX *ctx) {
+void crypto_sha1_init(SHA1_CTX *ctx) {
       ctx->state[0] = 0x67452301;
       ctx->state[1] = 0xEFCDAB89;
       ctx->state[2] = 0x98BADCFE;
@@ -285,29 +304,44 @@ static void crypto_sha1_init(SHA1_CTX *ctx) {
 }
 
 /* Update SHA-1 context with new data */
-static void crypto_sha1_update(SHA1_CTX *ctx, const uint8_t *data, size_t len) {
-      size_t i;
+void crypto_sha1_update(SHA1_CTX *ctx, const void *data, size_t len) {
+      const uint8_t *p = data;
       size_t index = (ctx->count[0] >> 3) & 63; /* Current byte position in buffer */
+      size_t fill;
 
       /* Update total bit count (handling 64-bit overflow) */
-      if ((ctx->count[0] += (len << 3)) < (len << 3)) {
+      if ((ctx->count[0] += (uint32_t)(len << 3)) < (uint32_t)(len << 3)) {
             ctx->count[1]++; /* Carry to high word */
       }
-      ctx->count[1] += (len >> 29); /* Add high bits */
+      ctx->count[1] += (uint32_t)(len >> 29); /* Add high bits */
+
+      /* Top up a partly filled buffer first */
+      if (index > 0) {
+            fill = SHA1_BLOCK_SIZE - index;
+            if (len < fill) {
+                  memcpy(ctx->buffer + index, p, len);
+                  return;
+            }
+            memcpy(ctx->buffer + index, p, fill);
+            crypto_sha1_transform(ctx, ctx->buffer);
+            p += fill;
+            len -= fill;
+      }
 
-      /* Process input data */
-      for (i = 0; i < len; i++) {
-      ctx->buffer[index++] = data[i];
-      /* Transform when buffer is full (64 bytes) */
-      if (index == 64) {
-          crypto_sha1_transform(ctx, ctx->buffer);
-          index = 0;
+      /* Whole blocks are transformed straight from the input */
+      while (len >= SHA1_BLOCK_SIZE) {
+            crypto_sha1_transform(ctx, p);
+            p += SHA1_BLOCK_SIZE;
+            len -= SHA1_BLOCK_SIZE;
       }
-    }
+
+      /* Keep the tail for the next update */
+      if (len > 0)
+            memcpy(ctx->buffer, p, len);
 }
 
 /* Finalize SHA-1 computation and produce digest */
-static void crypto_sha1_final(SHA1_CTX *ctx, uint8_t digest[SHA1_DIGEST_SIZE]) {
+void crypto_sha1_final(SHA1_CTX *ctx, uint8_t digest[SHA1_DIGEST_SIZE]) {
       uint8_t bits[8]; /* 64-bit bit count in big-endian */
       size_t index, pad_len;
       int i;
@@ -411,7 +445,7 @@ static void crypto_sha256_transform(SHA256_CTX *ctx,
 }
 
 /* Initialize SHA-256 context with initial hash values (first 32 bits of fractional parts of square roots of first 8 primes) */
-static void crypto_sha256_init(SHA256_CTX *ctx) {
+void crypto_sha256_init(SHA256_CTX *ctx) {
       ctx->state[0] = 0x6a09e667;
       ctx->state[1] = 0xbb67ae85;
       ctx->state[2] = 0x3c6ef372;
@@ -424,27 +458,40 @@ static void crypto_sha256_init(SHA256_CTX *ctx) {
 }
 
 /* Update SHA-256 context with new data */
-static void crypto_sha256_update(SHA256_CTX *ctx, const uint8_t *data, size_t len) {
-      size_t i;
+void crypto_sha256_update(SHA256_CTX *ctx, const void *data, size_t len) {
+      const uint8_t *p = data;
       size_t index = ctx->count % SHA256_BLOCK_SIZE; /* Current position in buffer */
+      size_t fill;
 
       ctx->count += len; /* Update total byte count */
 
-      /* Process complete blocks first */
-      for (i = 0; i + SHA256_BLOCK_SIZE <= len; i += SHA256_BLOCK_SIZE) {
-            memcpy(ctx->buffer + index, data + i, SHA256_BLOCK_SIZE - index);
+      /* Top up a partly filled buffer first */
+      if (index > 0) {
+            fill = SHA256_BLOCK_SIZE - index;
+            if (len < fill) {
+                  memcpy(ctx->buffer + index, p, len);
+                  return;
+            }
+            memcpy(ctx->buffer + index, p, fill);
             crypto_sha256_transform(ctx, ctx->buffer);
-            index = 0;
+            p += fill;
+            len -= fill;
       }
 
-      /* Store remaining data in buffer */
-      if (i < len) {
-            memcpy(ctx->buffer + index, data + i, len - i);
+      /* Whole blocks are transformed straight from the input */
+      while (len >= SHA256_BLOCK_SIZE) {
+            crypto_sha256_transform(ctx, p);
+            p += SHA256_BLOCK_SIZE;
+            len -= SHA256_BLOCK_SIZE;
       }
+
+      /* Keep the tail for the next update */
+      if (len > 0)
+            memcpy(ctx->buffer, p, len);
 }
 
 /* Finalize SHA-256 computation and produce digest */
-static void crypto_sha256_final(SHA256_CTX *ctx, uint8_t digest[SHA256_DIGEST_SIZE]) {
+void crypto_sha256_final(SHA256_CTX *ctx, uint8_t digest[SHA256_DIGEST_SIZE]) {
       uint64_t bit_count = ctx->count * 8; /* Convert byte count to bit count */
       size_t index = ctx->count % SHA256_BLOCK_SIZE; /* Current position in buffer */
       int i;
@@ -49,6 +49,9 @@ void charset_random(char *buffer, size_t size);
 
 void crypto_crc32_init_table(void);
 
+uint32_t crypto_crc32_init(void);
+uint32_t crypto_crc32_update(uint32_t crc, const void *data, size_t length);
+uint32_t crypto_crc32_final(uint32_t crc);
 uint32_t crypto_generate_crc32(const void *data, size_t length);
 
 uint32_t crypto_string_hash(const char *s);
@@ -61,8 +64,15 @@ void crypto_print_hex(const unsigned char *buf, size_t len, int null_terminator)
 
 int crypto_convert_to_hex(const unsigned char *in, int in_len, char **out);
 
+void crypto_sha1_init(SHA1_CTX *ctx);
+void crypto_sha1_update(SHA1_CTX *ctx, const void *data, size_t len);
+void crypto_sha1_final(SHA1_CTX *ctx, unsigned char digest[SHA1_DIGEST_SIZE]);
 int crypto_generate_sha1_hash(const char *input, unsigned char output[20]);
 
+void crypto_sha256_init(SHA256_CTX *ctx);
+void crypto_sha256_update(SHA256_CTX *ctx, const void *data, size_t len);
+void crypto_sha256_final(SHA256_CTX *ctx, unsigned char digest[SHA256_DIGEST_SIZE]);
+
 int crypto_generate_sha256_hash(const char *input, unsigned char output[SHA256_DIGEST_LENGTH]);
 
 char *crypto_base64_encode(const unsigned char *input, int len);
@@ -12,6 +12,7 @@
 #include  "units.h"
 #include  "debug.h"
 #include  "library.h"
+#include  "cache.h"
 #include  "curl.h"
 
 static char
@@ -772,6 +773,765 @@ parsing_filename(char *filename)
 	}
 }
 
+/*
+ * Connection reuse.  Every request made while installing goes through
+ * an easy handle from dog_curl_acquire.  All of them are attached to
+ * one CURLSH that shares the DNS cache, the connection pool and TLS
+ * sessions, so a run of requests to github.com and api.github.com
+ * keeps reusing a few warm connections.  Released handles are reset
+ * and kept for the next request.
+ */
+
+#define DOG_CURL_POOL_IDLE	8
+
+static CURLSH	*curl_share;
+static CURL	*curl_idle[DOG_CURL_POOL_IDLE];
+static int	 curl_nidle;
+
+static void
+curl_pool_cleanup(void)
+{
+	while (curl_nidle > 0)
+		curl_easy_cleanup(curl_idle[--curl_nidle]);
+	if (curl_share != NULL) {
+		curl_share_cleanup(curl_share);
+		curl_share = NULL;
+	}
+}
+
+CURL *
+dog_curl_acquire(void)
+{
+	CURL	*curl;
+
+	if (curl_share == NULL) {
+		curl_share = curl_share_init();
+		if (curl_share != NULL) {
+			curl_share_setopt(curl_share, CURLSHOPT_SHARE,
+			    CURL_LOCK_DATA_DNS);
+			curl_share_setopt(curl_share, CURLSHOPT_SHARE,
+			    CURL_LOCK_DATA_SSL_SESSION);
+			curl_share_setopt(curl_share, CURLSHOPT_SHARE,
+			    CURL_LOCK_DATA_CONNECT);
+			atexit(curl_pool_cleanup);
+		}
+	}
+
+	curl = (curl_nidle > 0) ? curl_idle[--curl_nidle] : curl_easy_init();
+	if (curl != NULL && curl_share != NULL)
+		curl_easy_setopt(curl, CURLOPT_SHARE, curl_share);
+	return (curl);
+}
+
+void
+dog_curl_release(CURL *curl)
+{
+	if (curl == NULL)
+		return;
+	if (curl_nidle == DOG_CURL_POOL_IDLE) {
+		curl_easy_cleanup(curl);
+		return;
+	}
+	curl_easy_reset(curl);
+	curl_idle[curl_nidle++] = curl;
+}
+
+/* request headers for a download, with the GitHub token for packages */
+static struct curl_slist *
+download_headers(int announce)
+{
+	struct curl_slist *headers = NULL;
+
+	if (installing_package) {
+		if (!dogconfig.dog_toml_github_tokens ||
+		    strfind(dogconfig.dog_toml_github_tokens,
+		    "DO_HERE", true) ||
+		    strlen(dogconfig.dog_toml_github_tokens) < 1) {
+			if (announce)
+				pr_color(stdout, DOG_COL_YELLOW,
+				    " ~ GitHub token not available\n");
+		} else {
+			char auth_header[512];
+			snprintf(auth_header, sizeof(auth_header),
+			    "Authorization: token %s",
+			    dogconfig.dog_toml_github_tokens);
+			headers = curl_slist_append(headers,
+			    auth_header);
+			if (announce)
+				pr_color(stdout, DOG_COL_GREEN,
+				    " ~ Using GitHub token: %s\n",
+				    dog_masked_text(8,
+				    dogconfig.dog_toml_github_tokens));
+		}
+	}
+
+	headers = curl_slist_append(headers,
+	    "User-Agent: watchdogs/1.0");
+	headers = curl_slist_append(headers,
+	    "Accept: application/vnd.github.v3.raw");
+	return (headers);
+}
+
+/*
+ * Downloads are streamed into "<name>.part".  When an attempt breaks
+ * off, the next one asks only for the missing bytes with a Range
+ * request.  The strong ETag (or else the Last-Modified date) of the
+ * response that started the file is kept in "<name>.part.meta" and
+ * sent back as If-Range, so a server whose file has changed since
+ * answers with the whole new body, which overwrites the partial file;
+ * a partial file without a validator is not resumed at all.  The file
+ * is renamed into place once its length matches what the server
+ * announced and it starts the way its archive extension says.  No
+ * Accept-Encoding is sent: ranges have to count bytes of the file
+ * itself, and the archives are compressed already.  The bytes are
+ * hashed as they arrive, so a finished file comes with its SHA-256 and
+ * is not read back to check it.
+ */
+typedef struct {
+	FILE		*fp;
+	CURL		*curl;
+	const char	*path;
+	char		 meta[DOG_MAX_PATH + 16];	/* If-Range validator */
+	char		 validator[256];	/* of the current response */
+	curl_off_t	 offset;	/* bytes kept from earlier attempts */
+	int		 started;
+	SHA256_CTX	 sha;
+	char		 sha256[SHA256_DIGEST_LENGTH * 2 + 1];
+} DownloadPart;
+
+/* keep the validator of the final response, a strong ETag first */
+static size_t
+download_part_header(char *ptr, size_t size, size_t nmemb, void *userdata)
+{
+	DownloadPart	*part = userdata;
+	size_t		 n = size * nmemb, len;
+	const char	*value;
+
+	if (n >= 5 && strncmp(ptr, "HTTP/", 5) == 0) {
+		part->validator[0] = '\0';
+		return (n);
+	}
+	if (n > 5 && strncasecmp(ptr, "etag:", 5) == 0)
+		value = ptr + 5;
+	else if (n > 14 && strncasecmp(ptr, "last-modified:", 14) == 0 &&
+	    part->validator[0] != '"')
+		value = ptr + 14;
+	else
+		return (n);
+	while (value < ptr + n && (*value == ' ' || *value == '\t'))
+		++value;
+	len = (size_t)(ptr + n - value);
+	while (len > 0 && (value[len - 1] == '\r' || value[len - 1] == '\n' ||
+	    value[len - 1] == ' '))
+		--len;
+	/* a weak ETag cannot be used with If-Range */
+	if (len == 0 || len >= sizeof(part->validator) ||
+	    strncmp(value, "W/", 2) == 0)
+		return (n);
+	memcpy(part->validator, value, len);
+	part->validator[len] = '\0';
+	return (n);
+}
+
+static void
+download_part_forget(DownloadPart *part)
+{
+	unlink(part->path);
+	remove(part->meta);
+}
+
+/* what the partial file was started from, "" when unknown */
+static void
+download_part_meta_read(DownloadPart *part, char *out, size_t size)
+{
+	FILE		*fp;
+
+	out[0] = '\0';
+	fp = fopen(part->meta, "r");
+	if (fp == NULL)
+		return;
+	if (fgets(out, (int)size, fp) == NULL)
+		out[0] = '\0';
+	out[strcspn(out, "\r\n")] = '\0';
+	fclose(fp);
+}
+
+static void
+download_part_meta_write(DownloadPart *part)
+{
+	FILE		*fp;
+
+	if (part->validator[0] == '\0') {
+		remove(part->meta);
+		return;
+	}
+	fp = fopen(part->meta, "w");
+	if (fp == NULL)
+		return;
+	fprintf(fp, "%s\n", part->validator);
+	fclose(fp);
+}
+
+/* feed the bytes already in the partial file to the hash */
+static int
+download_part_rehash(DownloadPart *part)
+{
+	unsigned char	 buf[65536];
+	size_t		 n;
+	curl_off_t	 left = part->offset;
+	FILE		*fp;
+
+	crypto_sha256_init(&part->sha);
+	if (left == 0)
+		return (0);
+	fp = fopen(part->path, "rb");
+	if (fp == NULL)
+		return (-1);
+	while (left > 0 && (n = fread(buf, 1, left < (curl_off_t)sizeof(buf) ?
+	    (size_t)left : sizeof(buf), fp)) > 0) {
+		crypto_sha256_update(&part->sha, buf, n);
+		left -= (curl_off_t)n;
+	}
+	fclose(fp);
+	return (left == 0 ? 0 : -1);
+}
+
+static size_t
+download_part_write(void *ptr, size_t size, size_t nmemb, void *userdata)
+{
+	DownloadPart	*part = userdata;
+	long		 response_code = 0;
+
+	if (!part->started) {
+		part->started = 1;
+		curl_easy_getinfo(part->curl, CURLINFO_RESPONSE_CODE,
+		    &response_code);
+		/* file:// has no status but honours the offset */
+		if (part->offset > 0 && response_code != 206 &&
+		    response_code != 0) {
+			/* range ignored or If-Range failed, start over */
+			part->fp = freopen(part->path, "wb", part->fp);
+			part->offset = 0;
+			crypto_sha256_init(&part->sha);
+			if (part->fp == NULL)
+				return (0);
+		}
+		if (part->offset == 0)
+			download_part_meta_write(part);
+	}
+	nmemb = fwrite(ptr, size, nmemb, part->fp);
+	crypto_sha256_update(&part->sha, ptr, size * nmemb);
+	return (nmemb);
+}
+
+/*
+ * Open `path' for the next attempt.  A resumed attempt gets its
+ * If-Range appended to `headers', which the caller hands to curl.
+ */
+static int
+download_part_open(DownloadPart *part, const char *path, CURL *curl,
+    struct curl_slist **headers)
+{
+	struct stat	 st;
+	char		 since[sizeof(part->validator)];
+	char		 line[sizeof(since) + 16];
+
+	memset(part, 0, sizeof(*part));
+	part->path = path;
+	part->curl = curl;
+	snprintf(part->meta, sizeof(part->meta), "%s.meta", path);
+	if (stat(path, &st) == 0 && S_ISREG(st.st_mode))
+		part->offset = (curl_off_t)st.st_size;
+	download_part_meta_read(part, since, sizeof(since));
+	if (part->offset > 0 && since[0] == '\0') {
+		/* nothing to tell whether the file is still the same */
+		download_part_forget(part);
+		part->offset = 0;
+	}
+	if (download_part_rehash(part) != 0) {
+		/* unreadable leftovers: start the file over */
+		download_part_forget(part);
+		part->offset = 0;
+		crypto_sha256_init(&part->sha);
+	}
+	part->fp = fopen(path, "ab");
+	if (part->fp == NULL)
+		return (-1);
+
+	curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, download_part_write);
+	curl_easy_setopt(curl, CURLOPT_WRITEDATA, part);
+	curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, download_part_header);
+	curl_easy_setopt(curl, CURLOPT_HEADERDATA, part);
+	if (part->offset > 0) {
+		/*
+		 * CURLOPT_RANGE rather than RESUME_FROM: libcurl fails a
+		 * resumed transfer that is answered with 200, which is
+		 * exactly the answer to an If-Range that no longer holds.
+		 */
+		snprintf(line, sizeof(line), "If-Range: %s", since);
+		*headers = curl_slist_append(*headers, line);
+		snprintf(line, sizeof(line), "%" PRIdMAX "-",
+		    (intmax_t)part->offset);
+		curl_easy_setopt(curl, CURLOPT_RANGE, line);
+	}
+	return (0);
+}
+
+/* does the file start the way its archive extension says it should */
+static int
+download_signature_ok(const char *path, const char *name)
+{
+	unsigned char	 head[512];
+	size_t		 n;
+	FILE		*fp;
+
+	if (!is_archive_file(name))
+		return (1);
+	fp = fopen(path, "rb");
+	if (fp == NULL)
+		return (0);
+	n = fread(head, 1, sizeof(head), fp);
+	fclose(fp);
+	if (strend(name, ".zip", true))
+		return (n >= 4 && head[0] == 'P' && head[1] == 'K');
+	if (strend(name, ".tar.gz", true))
+		return (n >= 2 && head[0] == 0x1f && head[1] == 0x8b);
+	return (n >= 262 && memcmp(head + 257, "ustar", 5) == 0);
+}
+
+static void
+download_sha256_hex(SHA256_CTX *sha, char *out)
+{
+	static const char	 hex[] = "0123456789abcdef";
+	unsigned char		 digest[SHA256_DIGEST_LENGTH];
+	int			 i;
+
+	crypto_sha256_final(sha, digest);
+	for (i = 0; i < SHA256_DIGEST_LENGTH; i++) {
+		out[i * 2] = hex[digest[i] >> 4];
+		out[i * 2 + 1] = hex[digest[i] & 0xF];
+	}
+	out[SHA256_DIGEST_LENGTH * 2] = '\0';
+}
+
+static void
+download_part_digest(DownloadPart *part)
+{
+	download_sha256_hex(&part->sha, part->sha256);
+}
+
+/*
+ * End of an attempt.  Returns 1 when the file is complete and has been
+ * renamed to `final', with its SHA-256 in part->sha256, 0 when the
+ * next attempt should resume it and -1 when it has been thrown away.
+ */
+static int
+download_part_close(DownloadPart *part, CURLcode res, const char *final)
+{
+	curl_off_t	 length = -1;
+	long		 response_code = 0;
+	struct stat	 st;
+	int		 closed;
+
+	curl_easy_getinfo(part->curl, CURLINFO_RESPONSE_CODE, &response_code);
+	curl_easy_getinfo(part->curl, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T,
+	    &length);
+	closed = part->fp != NULL && fclose(part->fp) == 0;
+	part->fp = NULL;
+
+	if (response_code == 416) {
+		/* nothing left to send for that offset, start over */
+		download_part_forget(part);
+		return (-1);
+	}
+	if (!closed || res != CURLE_OK ||
+	    (response_code != DOG_CURL_RESPONSE_OK && response_code != 206 &&
+	    response_code != 0))
+		return (0);
+	if (stat(part->path, &st) != 0 || st.st_size == 0) {
+		download_part_forget(part);
+		return (-1);
+	}
+	if (length >= 0 && (curl_off_t)st.st_size != part->offset + length) {
+		pr_color(stdout, DOG_COL_YELLOW,
+		    " ~ %s: got %" PRIdMAX " of %" PRIdMAX " bytes\n", final,
+		    (intmax_t)st.st_size, (intmax_t)(part->offset + length));
+		if ((curl_off_t)st.st_size < part->offset + length)
+			return (0);
+		download_part_forget(part);
+		return (-1);
+	}
+	if (!download_signature_ok(part->path, final)) {
+		pr_error(stdout, "%s does not look like the archive its "
+		    "name says, discarding it", final);
+		download_part_forget(part);
+		return (-1);
+	}
+
+	remove(part->meta);
+	remove(final);
+	if (rename(part->path, final) != 0) {
+		pr_color(stdout, DOG_COL_RED,
+		    "* Failed to move %s into place (errno: %d - %s)\n",
+		    part->path, errno, strerror(errno));
+		return (-1);
+	}
+	download_part_digest(part);
+	return (1);
+}
+
+/*
+ * Segmented downloads.  A large file from a server that takes byte
+ * ranges is split into dog_toml_download_segments ranges fetched over
+ * as many connections at once, each written straight to its offset in
+ * a "<name>.part" preallocated to the full length.  A broken range is
+ * asked for again from where it stopped.  Once every range has
+ * received all of its bytes the file is hashed (the ranges arrive out
+ * of order, so it is read back once), checked like a single stream
+ * and renamed into place; anything else throws it away and the caller
+ * falls back to one stream.
+ */
+
+#ifndef DOG_WINDOWS
+
+#define DOG_SEGMENT_MIN		((curl_off_t)8 * 1024 * 1024)
+#define DOG_SEGMENT_ATTEMPTS	3
+
+typedef struct {
+	CURL		*easy;
+	int		 fd;
+	curl_off_t	 start;		/* first byte of the range */
+	curl_off_t	 pos;		/* next byte to write */
+	curl_off_t	 end;		/* last byte of the range */
+	int		 attempts;
+	int		 ignored;	/* answered with the whole body */
+} DownloadSegment;
+
+static size_t
+download_probe_header(char *ptr, size_t size, size_t nmemb, void *userdata)
+{
+	int	*ranges = userdata;
+	size_t	 n = size * nmemb;
+
+	if (n >= 5 && strncmp(ptr, "HTTP/", 5) == 0)
+		*ranges = 0;
+	else if (n > 20 && strncasecmp(ptr, "accept-ranges:", 14) == 0 &&
+	    strstr(ptr + 14, "bytes") != NULL)
+		*ranges = 1;
+	return (n);
+}
+
+static size_t
+download_segment_write(void *ptr, size_t size, size_t nmemb, void *userdata)
+{
+	DownloadSegment	*seg = userdata;
+	size_t		 n = size * nmemb, left = n;
+	const char	*p = ptr;
+	long		 response_code = 0;
+	ssize_t		 w;
+
+	curl_easy_getinfo(seg->easy, CURLINFO_RESPONSE_CODE, &response_code);
+	if (response_code != 206) {
+		seg->ignored = 1;
+		return (0);
+	}
+	if (seg->pos + (curl_off_t)n > seg->end + 1)
+		return (0);
+	while (left > 0) {
+		w = pwrite(seg->fd, p, left, (off_t)seg->pos);
+		if (w <= 0)
+			return (0);
+		p += w;
+		left -= (size_t)w;
+		seg->pos += w;
+	}
+	return (n);
+}
+
+static int
+download_segment_start(CURLM *multi, DownloadSegment *seg, const char *url,
+    struct curl_slist *headers)
+{
+	char	 range[64];
+
+	seg->easy = dog_curl_acquire();
+	if (seg->easy == NULL)
+		return (-1);
+	++seg->attempts;
+	snprintf(range, sizeof(range), "%" PRIdMAX "-%" PRIdMAX,
+	    (intmax_t)seg->pos, (intmax_t)seg->end);
+	curl_easy_setopt(seg->easy, CURLOPT_URL, url);
+	curl_easy_setopt(seg->easy, CURLOPT_RANGE, range);
+	curl_easy_setopt(seg->easy, CURLOPT_PRIVATE, seg);
+	curl_easy_setopt(seg->easy, CURLOPT_WRITEFUNCTION,
+	    download_segment_write);
+	curl_easy_setopt(seg->easy, CURLOPT_WRITEDATA, seg);
+	curl_easy_setopt(seg->easy, CURLOPT_FAILONERROR, 1L);
+	curl_easy_setopt(seg->easy, CURLOPT_HTTPHEADER, headers);
+	curl_easy_setopt(seg->easy, CURLOPT_CONNECTTIMEOUT, 15L);
+	curl_easy_setopt(seg->easy, CURLOPT_LOW_SPEED_LIMIT, 1L);
+	curl_easy_setopt(seg->easy, CURLOPT_LOW_SPEED_TIME, 60L);
+	curl_easy_setopt(seg->easy, CURLOPT_FOLLOWLOCATION, 1L);
+	curl_easy_setopt(seg->easy, CURLOPT_MAXREDIRS, 5L);
+	curl_easy_setopt(seg->easy, CURLOPT_SSL_VERIFYPEER, 1L);
+	curl_easy_setopt(seg->easy, CURLOPT_SSL_VERIFYHOST, 2L);
+	curl_verify_cacert_pem(seg->easy);
+	if (curl_multi_add_handle(multi, seg->easy) != CURLM_OK) {
+		dog_curl_release(seg->easy);
+		seg->easy = NULL;
+		return (-1);
+	}
+	return (0);
+}
+
+/*
+ * Ask for the length and whether ranges are taken; `target' gets the
+ * URL after redirects so the ranges skip them.
+ */
+static curl_off_t
+download_probe(const char *url, struct curl_slist *headers, char *target,
+    size_t size)
+{
+	CURL		*curl;
+	curl_off_t	 length = -1;
+	long		 response_code = 0;
+	char		*effective = NULL;
+	int		 ranges = 0;
+
+	curl = dog_curl_acquire();
+	if (curl == NULL)
+		return (-1);
+	curl_easy_setopt(curl, CURLOPT_URL, url);
+	curl_easy_setopt(curl, CURLOPT_NOBODY, 1L);
+	curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+	curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, download_probe_header);
+	curl_easy_setopt(curl, CURLOPT_HEADERDATA, &ranges);
+	curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+	curl_easy_setopt(curl, CURLOPT_MAXREDIRS, 5L);
+	curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, 15L);
+	curl_easy_setopt(curl, CURLOPT_TIMEOUT, 30L);
+	curl_verify_cacert_pem(curl);
+
+	if (curl_easy_perform(curl) == CURLE_OK) {
+		curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE,
+		    &response_code);
+		curl_easy_getinfo(curl, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T,
+		    &length);
+		curl_easy_getinfo(curl, CURLINFO_EFFECTIVE_URL, &effective);
+		if (response_code != DOG_CURL_RESPONSE_OK || !ranges ||
+		    effective == NULL || strlen(effective) >= size)
+			length = -1;
+		else
+			snprintf(target, size, "%s", effective);
+	}
+	dog_curl_release(curl);
+	return (length);
+}
+
+/* do `a' and `b' name the same scheme, host and port */
+static int
+download_same_origin(const char *a, const char *b)
+{
+	const char	*ea, *eb;
+
+	ea = strstr(a, "://");
+	eb = strstr(b, "://");
+	if (ea == NULL || eb == NULL)
+		return (0);
+	ea = strchr(ea + 3, '/');
+	eb = strchr(eb + 3, '/');
+	ea = ea != NULL ? ea : a + strlen(a);
+	eb = eb != NULL ? eb : b + strlen(b);
+	return (ea - a == eb - b && strncasecmp(a, b, (size_t)(ea - a)) == 0);
+}
+
+/*
+ * 0 when `final' is in place, with its hex SHA-256 in `sha256', -1 to
+ * download it in one piece.  The ranges go straight to where the probe
+ * was redirected, which libcurl no longer sees as a redirect, so they
+ * carry the GitHub token only when that is the host it was meant for.
+ */
+static int
+download_segmented(const char *url, const char *part, const char *final,
+    char *sha256)
+{
+	DownloadSegment		*segs = NULL, *seg;
+	DownloadPart		 whole;
+	struct curl_slist	*headers;
+	CURLM			*multi = NULL;
+	CURLMsg			*msg;
+	curl_off_t		 length, chunk, received = 0;
+	struct stat		 st;
+	char			 target[DOG_MAX_PATH];
+	int			 nseg, i, running, left, fd = -1, ret = -1;
+
+	nseg = dogconfig.dog_toml_download_segments;
+	if (nseg < 2 || stat(part, &st) == 0)
+		return (-1);
+
+	headers = download_headers(0);
+	length = download_probe(url, headers, target, sizeof(target));
+	if (length < DOG_SEGMENT_MIN)
+		goto out;
+	if (!download_same_origin(url, target)) {
+		curl_slist_free_all(headers);
+		headers = curl_slist_append(NULL, "User-Agent: watchdogs/1.0");
+	}
+
+	fd = open(part, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+		goto out;
+	if (posix_fallocate(fd, 0, (off_t)length) != 0 &&
+	    ftruncate(fd, (off_t)length) != 0)
+		goto out;
+
+	segs = dog_calloc((size_t)nseg, sizeof(*segs));
+	multi = curl_multi_init();
+	if (segs == NULL || multi == NULL)
+		goto out;
+
+	pr_color(stdout, DOG_COL_GREEN,
+	    " ~ %s: %" PRIdMAX " bytes in %d ranges\n", final,
+	    (intmax_t)length, nseg);
+	chunk = length / nseg;
+	for (i = 0; i < nseg; i++) {
+		segs[i].fd = fd;
+		segs[i].start = segs[i].pos = chunk * i;
+		segs[i].end = (i == nseg - 1) ? length - 1 :
+		    chunk * (i + 1) - 1;
+		if (download_segment_start(multi, &segs[i], target,
+		    headers) != 0)
+			goto out;
+	}
+
+	ret = 0;
+	do {
+		curl_multi_perform(multi, &running);
+		while ((msg = curl_multi_info_read(multi, &left)) != NULL) {
+			if (msg->msg != CURLMSG_DONE)
+				continue;
+			curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE,
+			    &seg);
+			curl_multi_remove_handle(multi, seg->easy);
+			dog_curl_release(seg->easy);
+			seg->easy = NULL;
+			if (seg->pos == seg->end + 1)
+				continue;
+			if (seg->ignored || seg->attempts >=
+			    DOG_SEGMENT_ATTEMPTS || download_segment_start(
+			    multi, seg, target, headers) != 0) {
+				ret = -1;
+				break;
+			}
+			running = 1;
+		}
+		if (ret == 0 && running > 0)
+			curl_multi_wait(multi, NULL, 0, 1000, NULL);
+	} while (ret == 0 && running > 0);
+
+	/* every range short of even one byte fails the whole file */
+	for (i = 0; i < nseg && ret == 0; i++) {
+		if (segs[i].pos != segs[i].end + 1)
+			ret = -1;
+		received += segs[i].pos - segs[i].start;
+	}
+	if (ret == 0 && received != length) {
+		pr_color(stdout, DOG_COL_YELLOW,
+		    " ~ %s: got %" PRIdMAX " of %" PRIdMAX " bytes\n", final,
+		    (intmax_t)received, (intmax_t)length);
+		ret = -1;
+	}
+
+out:
+	if (segs != NULL) {
+		for (i = 0; i < nseg; i++) {
+			if (segs[i].easy == NULL)
+				continue;
+			curl_multi_remove_handle(multi, segs[i].easy);
+			dog_curl_release(segs[i].easy);
+		}
+		dog_free(segs);
+	}
+	if (multi != NULL)
+		curl_multi_cleanup(multi);
+	curl_slist_free_all(headers);
+	if (fd >= 0 && close(fd) != 0)
+		ret = -1;
+
+	if (ret == 0) {
+		memset(&whole, 0, sizeof(whole));
+		whole.path = part;
+		whole.offset = length;
+		if (download_part_rehash(&whole) != 0) {
+			ret = -1;
+		} else if (!download_signature_ok(part, final)) {
+			pr_error(stdout, "%s does not look like the archive "
+			    "its name says, discarding it", final);
+			ret = -1;
+		} else {
+			download_part_digest(&whole);
+			memcpy(sha256, whole.sha256, sizeof(whole.sha256));
+			remove(final);
+			if (rename(part, final) != 0)
+				ret = -1;
+		}
+	}
+	if (ret != 0 && fd >= 0) {
+		pr_color(stdout, DOG_COL_YELLOW,
+		    " ~ ranged download of %s failed, using one stream\n",
+		    final);
+		unlink(part);
+	}
+	return (ret);
+}
+
+#endif /* !DOG_WINDOWS */
+
+/* unpack a finished download and deal with the archive */
+static int
+download_unpack(const char *final_filename)
+{
+	char size_filename[DOG_PATH_MAX];
+	snprintf(size_filename, sizeof(size_filename), "%s", final_filename);
+
+	char *extension = NULL;
+	if ((extension = strstr(size_filename, ".tar.gz")) != NULL) {
+		*extension = '\0';
+	} else if ((extension = strstr(size_filename, ".tar")) != NULL) {
+		*extension = '\0';
+	} else if ((extension = strstr(size_filename, ".zip")) != NULL) {
+		*extension = '\0';
+	}
+
+	dog_extract_archive(final_filename, size_filename);
+
+	if (installing_package) {
+		if (path_exists(final_filename) == 1)
+			destroy_arch_dir(final_filename);
+	} else if (installing_pawncc) {
+		if (path_exists(final_filename) == 1)
+			destroy_arch_dir(final_filename);
+	} else {
+		pr_color(stdout, DOG_COL_CYAN, "==> Remove archive %s? ",
+		    final_filename);
+		char *confirm = readline("(y/n): ");
+
+		if (confirm[0] == '\0' || confirm[0] == 'Y' ||
+		    confirm[0] == 'y') {
+			if (path_exists(final_filename) == 1)
+				destroy_arch_dir(final_filename);
+		}
+		dog_free(confirm);
+	}
+
+	if (installing_pawncc && prompt_apply_pawncc() == 1) {
+		pawncc_dir_source = strdup(size_filename);
+		dog_apply_pawncc();
+	}
+
+	return (0);
+}
+
 int
 dog_download_file(const char *url, const char *output_filename)
 {
@@ -786,8 +1546,10 @@ dog_download_file(const char *url, const char *output_filename)
 	CURLcode res;
 	CURL *curl = NULL;
 	long response_code = 0;
-	int retry_count = 0;
+	int retry_count = 0, done;
 	struct stat file_stat;
+	DownloadPart part;
+	char part_filename[DOG_PATH_MAX + 8];
 
 	char clean_filename[DOG_PATH_MAX];
 	char *query_pos = strchr(output_filename, '?');
@@ -840,52 +1602,53 @@ dog_download_file(const char *url, const char *output_filename)
 
 	pr_color(stdout, DOG_COL_GREEN, "* Try Downloading %s", final_filename);
 
+	snprintf(part_filename, sizeof(part_filename), "%s.part",
+	    final_filename);
+
+	if (dog_cache_fetch(url, final_filename, NULL) == 0) {
+		pr_color(stdout, DOG_COL_GREEN,
+		    " %% cached: %s\n", final_filename);
+		return (download_unpack(final_filename));
+	}
+
+#ifndef DOG_WINDOWS
+	if (download_segmented(url, part_filename, final_filename,
+	    part.sha256) == 0 && stat(final_filename, &file_stat) == 0) {
+		pr_color(stdout, DOG_COL_GREEN,
+		    " %% successful: %" PRIdMAX " bytes to %s\n",
+		    (intmax_t)file_stat.st_size, final_filename);
+		fflush(stdout);
+		dog_cache_store(url, final_filename, part.sha256);
+		return (download_unpack(final_filename));
+	}
+#endif
+
 	while (retry_count < 5) {
-		curl = curl_easy_init();
+		curl = dog_curl_acquire();
 		if (!curl) {
 			pr_color(stdout, DOG_COL_RED,
 			    "Failed to initialize CURL\n");
 			return (-1);
 		}
 
-		struct curl_slist *headers = NULL;
-
-		if (installing_package) {
-			if (!dogconfig.dog_toml_github_tokens ||
-			    strfind(dogconfig.dog_toml_github_tokens,
-			    "DO_HERE", true) ||
-			    strlen(dogconfig.dog_toml_github_tokens) < 1) {
-				pr_color(stdout, DOG_COL_YELLOW,
-				    " ~ GitHub token not available\n");
-			} else {
-				char auth_header[512];
-				snprintf(auth_header, sizeof(auth_header),
-				    "Authorization: token %s",
-				    dogconfig.dog_toml_github_tokens);
-				headers = curl_slist_append(headers,
-				    auth_header);
-				pr_color(stdout, DOG_COL_GREEN,
-				    " ~ Using GitHub token: %s\n",
-				    dog_masked_text(8,
-				    dogconfig.dog_toml_github_tokens));
-			}
-		}
-
-		headers = curl_slist_append(headers,
-		    "User-Agent: watchdogs/1.0");
-		headers = curl_slist_append(headers,
-		    "Accept: application/vnd.github.v3.raw");
+		struct curl_slist *headers = download_headers(1);
 
 		curl_easy_setopt(curl, CURLOPT_URL, url);
-		curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION,
-		    write_memory_callback);
-
-		struct buf download_buffer;
-		buf_init(&download_buffer);
-
-		curl_easy_setopt(curl, CURLOPT_WRITEDATA, &download_buffer);
+		if (download_part_open(&part, part_filename, curl,
+		    &headers) != 0) {
+			pr_color(stdout, DOG_COL_RED,
+			    "* Failed to open file for writing: %s "
+			    "(errno: %d - %s)\n",
+			    part_filename, errno, strerror(errno));
+			dog_curl_release(curl);
+			curl_slist_free_all(headers);
+			return (-1);
+		}
+		if (part.offset > 0)
+			pr_color(stdout, DOG_COL_GREEN,
+			    " ~ Resuming %s at %" PRIdMAX " bytes\n",
+			    final_filename, (intmax_t)part.offset);
 
-		curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING, "gzip");
 		curl_easy_setopt(curl, CURLOPT_FAILONERROR, 1L);
 		curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
 		curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, 15L);
@@ -913,111 +1676,19 @@ dog_download_file(const char *url, const char *output_filename)
 		fflush(stdout);
 		res = curl_easy_perform(curl);
 		curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &response_code);
+		done = download_part_close(&part, res, final_filename);
 
-		curl_easy_cleanup(curl);
+		dog_curl_release(curl);
 		curl_slist_free_all(headers);
 
-		if (res == CURLE_OK &&
-		    response_code == DOG_CURL_RESPONSE_OK &&
-		    download_buffer.len > 0) {
-			FILE *fp = fopen(final_filename, "wb");
-			if (!fp) {
-				pr_color(stdout, DOG_COL_RED,
-				    "* Failed to open file for writing: %s "
-				    "(errno: %d - %s)\n",
-				    final_filename, errno, strerror(errno));
-				dog_free(download_buffer.data);
-				++retry_count;
-				continue;
-			}
-
-			size_t written = fwrite(download_buffer.data, 1,
-			    download_buffer.len, fp);
-			fclose(fp);
-
-			if (written != download_buffer.len) {
-				pr_color(stdout, DOG_COL_RED,
-				    "* Failed to write all data to file: %s "
-				    "(written: %zu, expected: %zu)\n",
-				    final_filename, written,
-				    download_buffer.len);
-				dog_free(download_buffer.data);
-				unlink(final_filename);
-				++retry_count;
-				continue;
-			}
-
-			buf_free(&download_buffer);
-
-			if (stat(final_filename, &file_stat) == 0 &&
-			    file_stat.st_size > 0) {
-				pr_color(stdout, DOG_COL_GREEN,
-				    " %% successful: %" PRIdMAX " bytes to %s\n",
-				    (intmax_t)file_stat.st_size,
-				    final_filename);
-				fflush(stdout);
-
-				char size_filename[DOG_PATH_MAX];
-				snprintf(size_filename, sizeof(size_filename),
-				    "%s", final_filename);
-
-				char *extension = NULL;
-				if ((extension = strstr(size_filename,
-				    ".tar.gz")) != NULL) {
-					*extension = '\0';
-				} else if ((extension = strstr(size_filename,
-				    ".tar")) != NULL) {
-					*extension = '\0';
-				} else if ((extension = strstr(size_filename,
-				    ".zip")) != NULL) {
-					*extension = '\0';
-				}
-
-				dog_extract_archive(final_filename,
-				    size_filename);
-
-				if (installing_package) {
-					if (path_exists(
-              final_filename) == 1) {
-              destroy_arch_dir(final_filename);
-          }
-        } else {
-					if (installing_pawncc) {
-						if (path_exists(
-						    final_filename) == 1) {
-							destroy_arch_dir(
-							    final_filename);
-						}
-					} else {
-						pr_color(stdout, DOG_COL_CYAN,
-							"==> Remove archive %s? ",
-							final_filename);
-						char *confirm = readline("(y/n): ");
-
-						if (confirm[0] == '\0' ||
-							confirm[0] == 'Y' ||
-							confirm[0] == 'y') {
-							if (path_exists(
-								final_filename) == 1) {
-								destroy_arch_dir(
-									final_filename);
-							}
-						}
-						dog_free(confirm);
-					}
-				}
-
-    			if (installing_pawncc && prompt_apply_pawncc() == 1)
-				{
-					pawncc_dir_source = strdup(
-					    size_filename);
-					dog_apply_pawncc();
-				}
-
-				return (0);
-			}
-		} else {
-			buf_free(&download_buffer);
+		if (done == 1 && stat(final_filename, &file_stat) == 0 &&
+		    file_stat.st_size > 0) {
+			pr_color(stdout, DOG_COL_GREEN,
+			    " %% successful: %" PRIdMAX " bytes to %s\n",
+			    (intmax_t)file_stat.st_size, final_filename);
+			fflush(stdout);
+			dog_cache_store(url, final_filename, part.sha256);
+			return (download_unpack(final_filename));
 		}
 
 		pr_color(stdout, DOG_COL_YELLOW,
@@ -1032,3 +1703,712 @@ dog_download_file(const char *url, const char *output_filename)
 
 	return (1);
 }
+
+/*
+ * Concurrent downloads.  Transfers queued with dog_fetch_add are driven
+ * by dog_fetch_poll over one curl multi handle, at most `max_parallel'
+ * at a time, and each is handed back through the callback as soon as
+ * it finishes so the caller can work on it while the rest are still
+ * on the wire.  A failed transfer goes back to the end of the queue
+ * until it has been tried DOG_FETCH_ATTEMPTS times.
+ */
+
+#define DOG_FETCH_ATTEMPTS	5
+
+struct dog_fetch_item {
+	CURL			*easy;
+	struct curl_slist	*headers;
+	DownloadPart		 part;
+	char			*url;
+	char			 filename[DOG_PATH_MAX];
+	char			 partname[DOG_PATH_MAX + 8];
+	void			*udata;
+	int			 attempts;
+};
+
+struct dog_fetch {
+	CURLM			 *multi;
+	struct dog_fetch_item	**queue;
+	int			  nqueue;
+	int			  head;
+	int			  cap;
+	int			  active;
+	int			  max_parallel;
+	int			  announced;
+};
+
+DogFetch *
+dog_fetch_new(int max_parallel)
+{
+	DogFetch	*f;
+
+	f = dog_calloc(1, sizeof(*f));
+	if (f == NULL)
+		return (NULL);
+	f->multi = curl_multi_init();
+	if (f->multi == NULL) {
+		dog_free(f);
+		return (NULL);
+	}
+	f->max_parallel = (max_parallel > 0) ? max_parallel : 4;
+	return (f);
+}
+
+static int
+fetch_push(DogFetch *f, struct dog_fetch_item *item)
+{
+	struct dog_fetch_item	**q;
+	int			  cap;
+
+	if (f->nqueue == f->cap) {
+		cap = f->cap ? f->cap * 2 : 16;
+		q = dog_realloc(f->queue, (size_t)cap * sizeof(*q));
+		if (q == NULL)
+			return (-1);
+		f->queue = q;
+		f->cap = cap;
+	}
+	f->queue[f->nqueue++] = item;
+	return (0);
+}
+
+int
+dog_fetch_add(DogFetch *f, const char *url, const char *filename,
+    void *udata)
+{
+	struct dog_fetch_item	*item;
+	const char		*query;
+
+	item = dog_calloc(1, sizeof(*item));
+	if (item == NULL)
+		return (-1);
+	item->url = strdup(url);
+	query = strchr(filename, '?');
+	snprintf(item->filename, sizeof(item->filename), "%.*s",
+	    query ? (int)(query - filename) : (int)strlen(filename),
+	    filename);
+	parsing_filename(item->filename);
+	snprintf(item->partname, sizeof(item->partname), "%s.part",
+	    item->filename);
+	item->udata = udata;
+	if (item->url == NULL || fetch_push(f, item) != 0) {
+		dog_free(item->url);
+		dog_free(item);
+		return (-1);
+	}
+	return (0);
+}
+
+static void
+fetch_item_free(struct dog_fetch_item *item)
+{
+	if (item->part.fp)
+		fclose(item->part.fp);
+	if (item->headers)
+		curl_slist_free_all(item->headers);
+	dog_free(item->url);
+	dog_free(item);
+}
+
+static int
+fetch_start(DogFetch *f, struct dog_fetch_item *item)
+{
+	item->easy = dog_curl_acquire();
+	if (item->easy == NULL)
+		return (-1);
+	item->headers = download_headers(!f->announced);
+	f->announced = 1;
+	if (download_part_open(&item->part, item->partname,
+	    item->easy, &item->headers) != 0) {
+		pr_color(stdout, DOG_COL_RED,
+		    "* Failed to open file for writing: %s "
+		    "(errno: %d - %s)\n",
+		    item->partname, errno, strerror(errno));
+		curl_slist_free_all(item->headers);
+		item->headers = NULL;
+		dog_curl_release(item->easy);
+		item->easy = NULL;
+		return (-1);
+	}
+	++item->attempts;
+
+	pr_color(stdout, DOG_COL_GREEN, "* Try Downloading %s\n",
+	    item->filename);
+
+	curl_easy_setopt(item->easy, CURLOPT_URL, item->url);
+	curl_easy_setopt(item->easy, CURLOPT_PRIVATE, item);
+	curl_easy_setopt(item->easy, CURLOPT_FAILONERROR, 1L);
+	curl_easy_setopt(item->easy, CURLOPT_HTTPHEADER, item->headers);
+	curl_easy_setopt(item->easy, CURLOPT_CONNECTTIMEOUT, 15L);
+	curl_easy_setopt(item->easy, CURLOPT_TIMEOUT, 300L);
+	curl_easy_setopt(item->easy, CURLOPT_FOLLOWLOCATION, 1L);
+	curl_easy_setopt(item->easy, CURLOPT_MAXREDIRS, 5L);
+	curl_easy_setopt(item->easy, CURLOPT_SSL_VERIFYPEER, 1L);
+	curl_easy_setopt(item->easy, CURLOPT_SSL_VERIFYHOST, 2L);
+	curl_verify_cacert_pem(item->easy);
+
+	if (curl_multi_add_handle(f->multi, item->easy) != CURLM_OK) {
+		fclose(item->part.fp);
+		item->part.fp = NULL;
+		dog_curl_release(item->easy);
+		item->easy = NULL;
+		return (-1);
+	}
+	++f->active;
+	return (0);
+}
+
+/* a finished transfer: retry it or hand it back */
+static void
+fetch_finish(DogFetch *f, struct dog_fetch_item *item, CURLcode res,
+    DogFetchDoneFn done, void *ctx)
+{
+	long		 response_code = 0;
+	struct stat	 st;
+	int		 ok = 0;
+
+	if (item->easy != NULL) {
+		curl_easy_getinfo(item->easy, CURLINFO_RESPONSE_CODE,
+		    &response_code);
+		ok = download_part_close(&item->part, res,
+		    item->filename) == 1 &&
+		    stat(item->filename, &st) == 0;
+		curl_multi_remove_handle(f->multi, item->easy);
+		dog_curl_release(item->easy);
+		item->easy = NULL;
+		--f->active;
+	}
+	curl_slist_free_all(item->headers);
+	item->headers = NULL;
+
+	if (!ok) {
+		if (item->attempts < DOG_FETCH_ATTEMPTS) {
+			pr_color(stdout, DOG_COL_YELLOW,
+			    " Attempt %d/%d for %s failed (HTTP: %ld). "
+			    "Retrying...\n", item->attempts,
+			    DOG_FETCH_ATTEMPTS, item->filename,
+			    response_code);
+			if (fetch_push(f, item) == 0)
+				return;
+		}
+		pr_color(stdout, DOG_COL_RED,
+		    " Failed to download %s from %s after %d retries\n",
+		    item->filename, item->url, item->attempts);
+	} else {
+		pr_color(stdout, DOG_COL_GREEN,
+		    " %% successful: %" PRIdMAX " bytes to %s\n",
+		    (intmax_t)st.st_size, item->filename);
+		dog_cache_store(item->url, item->filename,
+		    item->part.sha256);
+	}
+	fflush(stdout);
+	done(ctx, item->udata, item->filename, ok ? item->part.sha256 : NULL,
+	    ok);
+	fetch_item_free(item);
+}
+
+/*
+ * dog_fetch_poll
+ * Start queued transfers up to the limit, wait at most `timeout_ms'
+ * for traffic and report the transfers that finished.  Returns the
+ * number of transfers still queued or running.
+ */
+int
+dog_fetch_poll(DogFetch *f, int timeout_ms, DogFetchDoneFn done, void *ctx)
+{
+	struct dog_fetch_item	*item;
+	CURLMsg			*msg;
+	char			 sha256[SHA256_DIGEST_LENGTH * 2 + 1];
+	int			 running, left;
+
+	while (f->active < f->max_parallel && f->head < f->nqueue) {
+		item = f->queue[f->head++];
+		if (item->attempts == 0 &&
+		    dog_cache_fetch(item->url, item->filename, sha256) == 0) {
+			pr_color(stdout, DOG_COL_GREEN, " %% cached: %s\n",
+			    item->filename);
+			done(ctx, item->udata, item->filename, sha256, 1);
+			fetch_item_free(item);
+			continue;
+		}
+		if (fetch_start(f, item) != 0) {
+			item->attempts = DOG_FETCH_ATTEMPTS;
+			fetch_finish(f, item, CURLE_FAILED_INIT, done, ctx);
+		}
+	}
+
+	curl_multi_perform(f->multi, &running);
+	if (running > 0 && timeout_ms > 0) {
+		curl_multi_wait(f->multi, NULL, 0, timeout_ms, NULL);
+		curl_multi_perform(f->multi, &running);
+	}
+
+	while ((msg = curl_multi_info_read(f->multi, &left)) != NULL) {
+		if (msg->msg != CURLMSG_DONE)
+			continue;
+		curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, &item);
+		fetch_finish(f, item, msg->data.result, done, ctx);
+	}
+
+	return (f->active + f->nqueue - f->head);
+}
+
+void
+dog_fetch_free(DogFetch *f)
+{
+	int	 i;
+
+	if (f == NULL)
+		return;
+	for (i = f->head; i < f->nqueue; i++)
+		fetch_item_free(f->queue[i]);
+	curl_multi_cleanup(f->multi);
+	dog_free(f->queue);
+	dog_free(f);
+}
+
+/*
+ * Pull-style body reader.  dog_stream_read drives the transfer only
+ * until the next piece of the body has arrived and hands that piece
+ * out, so a consumer such as libarchive can decode the response while
+ * the rest of it is still downloading.  The piece stays valid until
+ * the next call.  Every piece handed out is hashed, so the SHA-256 of
+ * the body is known when the stream is closed.
+ */
+struct dog_stream {
+	CURLM			*multi;
+	CURL			*easy;
+	struct curl_slist	*headers;
+	char			*buf;
+	size_t			 len;
+	size_t			 cap;
+	int			 running;
+	CURLcode		 result;
+	SHA256_CTX		 sha;
+	long long		 size;		/* handed out so far */
+};
+
+static size_t
+stream_write(void *ptr, size_t size, size_t nmemb, void *userdata)
+{
+	DogStream	*s = userdata;
+	size_t		 n = size * nmemb, cap;
+	char		*p;
+
+	if (s->len + n > s->cap) {
+		cap = s->cap ? s->cap : CURL_MAX_WRITE_SIZE * 4;
+		while (cap < s->len + n)
+			cap *= 2;
+		p = dog_realloc(s->buf, cap);
+		if (p == NULL)
+			return (0);
+		s->buf = p;
+		s->cap = cap;
+	}
+	memcpy(s->buf + s->len, ptr, n);
+	s->len += n;
+	return (n);
+}
+
+DogStream *
+dog_stream_open(const char *url)
+{
+	DogStream	*s;
+
+	s = dog_calloc(1, sizeof(*s));
+	if (s == NULL)
+		return (NULL);
+	s->multi = curl_multi_init();
+	s->easy = dog_curl_acquire();
+	if (s->multi == NULL || s->easy == NULL) {
+		dog_stream_close(s, NULL, NULL);
+		return (NULL);
+	}
+	s->headers = download_headers(1);
+	s->result = CURLE_OK;
+	crypto_sha256_init(&s->sha);
+
+	curl_easy_setopt(s->easy, CURLOPT_URL, url);
+	curl_easy_setopt(s->easy, CURLOPT_WRITEFUNCTION, stream_write);
+	curl_easy_setopt(s->easy, CURLOPT_WRITEDATA, s);
+	curl_easy_setopt(s->easy, CURLOPT_FAILONERROR, 1L);
+	curl_easy_setopt(s->easy, CURLOPT_HTTPHEADER, s->headers);
+	curl_easy_setopt(s->easy, CURLOPT_CONNECTTIMEOUT, 15L);
+	curl_easy_setopt(s->easy, CURLOPT_TIMEOUT, 300L);
+	curl_easy_setopt(s->easy, CURLOPT_FOLLOWLOCATION, 1L);
+	curl_easy_setopt(s->easy, CURLOPT_MAXREDIRS, 5L);
+	curl_easy_setopt(s->easy, CURLOPT_SSL_VERIFYPEER, 1L);
+	curl_easy_setopt(s->easy, CURLOPT_SSL_VERIFYHOST, 2L);
+	curl_verify_cacert_pem(s->easy);
+
+	if (curl_multi_add_handle(s->multi, s->easy) != CURLM_OK) {
+		dog_stream_close(s, NULL, NULL);
+		return (NULL);
+	}
+	s->running = 1;
+	return (s);
+}
+
+/*
+ * dog_stream_read
+ * Point `data' at the next piece of the body.  Returns its length, 0
+ * at the end of the body and -1 when the transfer failed.
+ */
+long
+dog_stream_read(DogStream *s, const void **data)
+{
+	CURLMsg		*msg;
+	int		 left;
+
+	s->len = 0;
+	while (s->len == 0 && s->running) {
+		curl_multi_perform(s->multi, &s->running);
+		if (s->len == 0 && s->running)
+			curl_multi_wait(s->multi, NULL, 0, 1000, NULL);
+	}
+	if (!s->running) {
+		while ((msg = curl_multi_info_read(s->multi, &left)) != NULL)
+			if (msg->msg == CURLMSG_DONE)
+				s->result = msg->data.result;
+	}
+	if (s->len == 0 && s->result != CURLE_OK)
+		return (-1);
+	crypto_sha256_update(&s->sha, s->buf, s->len);
+	s->size += (long long)s->len;
+	*data = s->buf;
+	return ((long)s->len);
+}
+
+/*
+ * dog_stream_close
+ * Returns 0 when the whole body was received.  When `sha256' is given
+ * the rest of the body is read first, since a decoder may stop before
+ * trailing padding, and its hex SHA-256 and `size' are stored.
+ */
+int
+dog_stream_close(DogStream *s, char *sha256, long long *size)
+{
+	const void	*data;
+	int		 ret;
+
+	if (s == NULL)
+		return (-1);
+	if (sha256 != NULL)
+		while (dog_stream_read(s, &data) > 0)
+			;
+	ret = (!s->running && s->result == CURLE_OK) ? 0 : -1;
+	if (ret == 0 && sha256 != NULL) {
+		download_sha256_hex(&s->sha, sha256);
+		if (size != NULL)
+			*size = s->size;
+	}
+	if (s->easy != NULL) {
+		if (s->multi != NULL)
+			curl_multi_remove_handle(s->multi, s->easy);
+		dog_curl_release(s->easy);
+	}
+	if (s->multi != NULL)
+		curl_multi_cleanup(s->multi);
+	curl_slist_free_all(s->headers);
+	dog_free(s->buf);
+	dog_free(s);
+	return (ret);
+}
+
+/*
+ * dog_cache_dir
+ * Per-user cache directory for `sub': $XDG_CACHE_HOME/watchdogs/`sub',
+ * ~/.cache/watchdogs/`sub', or %LOCALAPPDATA%\watchdogs\`sub' on
+ * Windows.  Created on demand; returns 0 on success.
+ */
+int
+dog_cache_dir(const char *sub, char *path, size_t size)
+{
+	const char	*base;
+	int		 n;
+
+#ifdef DOG_WINDOWS
+	base = getenv("LOCALAPPDATA");
+	if (base == NULL || *base == '\0')
+		return (-1);
+	n = snprintf(path, size, "%s/watchdogs/%s", base, sub);
+#else
+	base = getenv("XDG_CACHE_HOME");
+	if (base != NULL && *base != '\0')
+		n = snprintf(path, size, "%s/watchdogs/%s", base, sub);
+	else if ((base = getenv("HOME")) != NULL && *base != '\0')
+		n = snprintf(path, size, "%s/.cache/watchdogs/%s", base, sub);
+	else
+		return (-1);
+#endif
+	if (n < 0 || (size_t)n >= size)
+		return (-1);
+	if (dir_exists(path) == 0 && dog_mkdir_recursive(path) != 0)
+		return (-1);
+	return (0);
+}
+
+/*
+ * API responses are kept under the "http" cache directory as a body
+ * file and a small meta file (validators and the time the copy was
+ * last known good), both named after the SHA-256 of the URL.  A copy
+ * younger than http_cache_ttl seconds is used without a request; an
+ * older one is revalidated with If-None-Match / If-Modified-Since,
+ * and a 304 -- which GitHub does not count against the rate limit --
+ * is answered from disk.
+ */
+
+typedef struct {
+	char	 etag[256];
+	char	 modified[128];
+	long long stamp;
+} HttpCacheMeta;
+
+static int
+http_cache_paths(const char *url, char *body, char *meta, size_t size)
+{
+	char		 dir[DOG_PATH_MAX];
+	unsigned char	 digest[SHA256_DIGEST_LENGTH];
+	char		*hex = NULL;
+	int		 n;
+
+	if (dog_cache_dir("http", dir, sizeof(dir)) != 0 ||
+	    !crypto_generate_sha256_hash(url, digest) ||
+	    !crypto_convert_to_hex(digest, SHA256_DIGEST_LENGTH, &hex))
+		return (-1);
+	snprintf(body, size, "%s/%s.body", dir, hex);
+	n = snprintf(meta, size, "%s/%s.meta", dir, hex);
+	dog_free(hex);
+	return ((n < 0 || (size_t)n >= size) ? -1 : 0);
+}
+
+static int
+http_cache_meta_read(const char *path, HttpCacheMeta *m)
+{
+	char	 line[512];
+	size_t	 len;
+	FILE	*fp;
+
+	memset(m, 0, sizeof(*m));
+	fp = fopen(path, "r");
+	if (fp == NULL)
+		return (-1);
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		len = strcspn(line, "\r\n");
+		line[len] = '\0';
+		if (strncmp(line, "stamp ", 6) == 0)
+			m->stamp = strtoll(line + 6, NULL, 10);
+		else if (strncmp(line, "etag ", 5) == 0 &&
+		    len - 5 < sizeof(m->etag))
+			memcpy(m->etag, line + 5, len - 4);
+		else if (strncmp(line, "last-modified ", 14) == 0 &&
+		    len - 14 < sizeof(m->modified))
+			memcpy(m->modified, line + 14, len - 13);
+	}
+	fclose(fp);
+	return (m->stamp > 0 ? 0 : -1);
+}
+
+/* write `path' through a temporary file; `data' may be text or not */
+static int
+http_cache_write(const char *path, const char *data, size_t len)
+{
+	char	 tmp[DOG_PATH_MAX + 8];
+	FILE	*fp;
+	int	 ok;
+
+	snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+	fp = fopen(tmp, "wb");
+	if (fp == NULL)
+		return (-1);
+	ok = fwrite(data, 1, len, fp) == len;
+	if (fclose(fp) != 0)
+		ok = 0;
+#ifdef DOG_WINDOWS
+	if (ok)
+		remove(path);
+#endif
+	if (!ok || rename(tmp, path) != 0) {
+		remove(tmp);
+		return (-1);
+	}
+	return (0);
+}
+
+static void
+http_cache_meta_write(const char *path, const char *url,
+    const HttpCacheMeta *m)
+{
+	char	 text[DOG_PATH_MAX * 2];
+	int	 n;
+
+	n = snprintf(text, sizeof(text),
+	    "url %s\nstamp %lld\netag %s\nlast-modified %s\n",
+	    url, m->stamp, m->etag, m->modified);
+	if (n > 0 && (size_t)n < sizeof(text))
+		http_cache_write(path, text, (size_t)n);
+}
+
+static char *
+http_cache_body(const char *path)
+{
+	struct stat	 st;
+	char		*data;
+	FILE		*fp;
+
+	if (stat(path, &st) != 0 || st.st_size <= 0)
+		return (NULL);
+	fp = fopen(path, "rb");
+	if (fp == NULL)
+		return (NULL);
+	data = dog_malloc((size_t)st.st_size + 1);
+	if (data != NULL &&
+	    fread(data, 1, (size_t)st.st_size, fp) != (size_t)st.st_size) {
+		dog_free(data);
+		data = NULL;
+	}
+	fclose(fp);
+	if (data != NULL)
+		data[st.st_size] = '\0';
+	return (data);
+}
+
+/* keep the validators of the final response; redirects start over */
+static size_t
+http_cache_header(char *ptr, size_t size, size_t nmemb, void *userdata)
+{
+	HttpCacheMeta	*m = userdata;
+	size_t		 n = size * nmemb, vlen;
+	char		*dest;
+	const char	*value;
+
+	if (n >= 5 && strncmp(ptr, "HTTP/", 5) == 0) {
+		m->etag[0] = m->modified[0] = '\0';
+		return (n);
+	}
+	if (n > 5 && strncasecmp(ptr, "etag:", 5) == 0) {
+		value = ptr + 5;
+		dest = m->etag;
+		vlen = sizeof(m->etag);
+	} else if (n > 14 && strncasecmp(ptr, "last-modified:", 14) == 0) {
+		value = ptr + 14;
+		dest = m->modified;
+		vlen = sizeof(m->modified);
+	} else {
+		return (n);
+	}
+	while (value < ptr + n && (*value == ' ' || *value == '\t'))
+		++value;
+	n = (size_t)(ptr + size * nmemb - value);
+	while (n > 0 && (value[n - 1] == '\r' || value[n - 1] == '\n'))
+		--n;
+	if (n < vlen) {
+		memcpy(dest, value, n);
+		dest[n] = '\0';
+	}
+	return (size * nmemb);
+}
+
+/*
+ * dog_http_get_cached
+ * GET `url' with `headers' through the response cache.  On success
+ * `*out' is the NUL-terminated body, to be freed by the caller.  When
+ * the request fails or is refused (rate limit, server error) a stale
+ * cached copy is used if there is one.
+ */
+int
+dog_http_get_cached(const char *url, const struct curl_slist *headers,
+    char **out)
+{
+	char			 bodypath[DOG_PATH_MAX], metapath[DOG_PATH_MAX],
+				 line[512];
+	HttpCacheMeta		 cached, fresh;
+	struct memory_struct	 buffer = { 0 };
+	struct curl_slist	*list = NULL;
+	const struct curl_slist	*h;
+	CURL			*curl;
+	CURLcode		 res;
+	long			 code = 0;
+	long long		 now = (long long)time(NULL);
+	int			 ttl, usable, have = 0;
+
+	*out = NULL;
+	ttl = dogconfig.dog_toml_http_cache_ttl;
+	usable = ttl >= 0 && http_cache_paths(url, bodypath, metapath,
+	    sizeof(bodypath)) == 0;
+	if (usable && http_cache_meta_read(metapath, &cached) == 0 &&
+	    path_exists(bodypath) == 1)
+		have = 1;
+
+	if (have && now - cached.stamp < ttl &&
+	    (*out = http_cache_body(bodypath)) != NULL)
+		return (1);
+
+	curl = dog_curl_acquire();
+	if (curl == NULL)
+		return (0);
+
+	for (h = headers; h != NULL; h = h->next)
+		list = curl_slist_append(list, h->data);
+	if (have && cached.etag[0] != '\0') {
+		snprintf(line, sizeof(line), "If-None-Match: %s", cached.etag);
+		list = curl_slist_append(list, line);
+	}
+	if (have && cached.modified[0] != '\0') {
+		snprintf(line, sizeof(line), "If-Modified-Since: %s",
+		    cached.modified);
+		list = curl_slist_append(list, line);
+	}
+
+	memset(&fresh, 0, sizeof(fresh));
+	memory_struct_init(&buffer);
+	curl_easy_setopt(curl, CURLOPT_URL, url);
+	curl_easy_setopt(curl, CURLOPT_HTTPHEADER, list);
+	curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_memory_callback);
+	curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *)&buffer);
+	curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, http_cache_header);
+	curl_easy_setopt(curl, CURLOPT_HEADERDATA, &fresh);
+	curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+	curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, 15L);
+	curl_easy_setopt(curl, CURLOPT_TIMEOUT, 60L);
+	curl_verify_cacert_pem(curl);
+
+	res = curl_easy_perform(curl);
+	curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &code);
+	dog_curl_release(curl);
+	curl_slist_free_all(list);
+
+	if (res == CURLE_OK && code == 304 && have) {
+		memory_struct_free(&buffer);
+		*out = http_cache_body(bodypath);
+		cached.stamp = now;
+		if (*out != NULL)
+			http_cache_meta_write(metapath, url, &cached);
+		return (*out != NULL);
+	}
+
+	if (res == CURLE_OK && code == DOG_CURL_RESPONSE_OK &&
+	    buffer.size > 0) {
+		if (usable && http_cache_write(bodypath, buffer.memory,
+		    buffer.size) == 0) {
+			fresh.stamp = now;
+			http_cache_meta_write(metapath, url, &fresh);
+		}
+		*out = buffer.memory;
+		return (1);
+	}
+
+	if (have && (res != CURLE_OK || code == 403 || code == 429 ||
+	    code >= 500) && (*out = http_cache_body(bodypath)) != NULL) {
+		pr_warning(stdout, "using the cached response for %s", url);
+		memory_struct_free(&buffer);
+		return (1);
+	}
+
+	if (res != CURLE_OK || buffer.size == 0) {
+		memory_struct_free(&buffer);
+		return (0);
+	}
+	*out = buffer.memory;
+	return (1);
+}
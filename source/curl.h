@@ -88,6 +88,31 @@ void tracker_discrepancy(const char *base,
                          int *variation_count);
 void tracking_username(CURL *curl, const char *username);
 
+CURL *dog_curl_acquire(void);
+void dog_curl_release(CURL *curl);
+
 int dog_download_file(const char *url, const char *fname);
 
+typedef struct dog_fetch DogFetch;
+/* `sha256' is the hex digest of a finished file, NULL when it failed */
+typedef void (*DogFetchDoneFn)(void *ctx, void *udata, const char *filename,
+                               const char *sha256, int ok);
+
+DogFetch *dog_fetch_new(int max_parallel);
+int dog_fetch_add(DogFetch *f, const char *url, const char *filename,
+                  void *udata);
+int dog_fetch_poll(DogFetch *f, int timeout_ms, DogFetchDoneFn done,
+                   void *ctx);
+void dog_fetch_free(DogFetch *f);
+
+int dog_cache_dir(const char *sub, char *path, size_t size);
+int dog_http_get_cached(const char *url, const struct curl_slist *headers,
+                        char **out);
+
+typedef struct dog_stream DogStream;
+
+DogStream *dog_stream_open(const char *url);
+long dog_stream_read(DogStream *s, const void **data);
+int dog_stream_close(DogStream *s, char *sha256, long long *size);
+
 #endif
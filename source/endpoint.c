@@ -162,16 +162,8 @@ update_samp_config(const char *g)
             return (-1);
         }
     #else
-        /* Unix/Linux: Use fork+exec for mv command */
-        pid_t process_id = fork();
-        if (process_id == 0) {
-            execlp("mv", "mv", "-f",
-                dogconfig.dog_toml_server_config,
-                size_config,
-                NULL);
-            _exit(127);
-        }
-        if (process_id < 0 || waitpid(process_id, NULL, 0) < 0) {
+        if (dog_file_move(dogconfig.dog_toml_server_config,
+                size_config) != 0) {
             pr_error(stdout, "Failed to create backup file");
             minimal_debugging();
             return (-1);
@@ -581,15 +573,8 @@ update_omp_config(const char *g)
                 return (-1);
             }
     #else
-            pid_t process_id = fork();
-            if (process_id == 0) {
-                execlp("mv", "mv", "-f",
-                    dogconfig.dog_toml_server_config,
-                    size_config,
-                    NULL);
-                _exit(127);
-            }
-            if (process_id < 0 || waitpid(process_id, NULL, 0) < 0) {
+            if (dog_file_move(dogconfig.dog_toml_server_config,
+                    size_config) != 0) {
                 pr_error(stdout, "Failed to create backup file");
                 minimal_debugging();
                 return (-1);
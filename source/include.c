@@ -0,0 +1,2055 @@
+/*-
+ * Copyright (c) 2026 Watchdogs Team and contributors
+ * All rights reserved. under The 2-Clause BSD License
+ * See COPYING or https://opensource.org/license/bsd-2-clause
+ */
+
+#include  "utils.h"
+#include  "debug.h"
+#include  "crypto.h"
+#include  "pawnc.h"
+#include  "include.h"
+
+/*
+ * Include search path pruning.  pawncc probes every -i directory, in
+ * order and with every extension, for each #include it meets.  Here the
+ * include directories are indexed once (header name -> directories that
+ * provide it), the #include graph of the input is walked against that
+ * index, and only the directories that actually supply a header are
+ * handed to pawncc, busiest first.  A directory that wins a header is
+ * always kept ahead of any other kept directory that has the same
+ * header, so every #include still resolves to the same file.  Headers
+ * are looked up in the order pawncc uses, and the index of each
+ * directory is cached on disk until one of its directories changes.
+ * Pruning is only done when asked for (--prune-includes).
+ */
+
+#define INCLUDE_BUCKETS		4096
+#define INCLUDE_MAX_DIRS	256
+#define INCLUDE_MAX_DEPTH	4
+#define INCLUDE_MAX_FILES	65536
+#define INCLUDE_MAX_NEST	64
+
+typedef struct {
+	char	*token;		/* flag as given, e.g. "-i=dir/" */
+	char	*path;		/* directory without trailing separator */
+	int	 pinned;	/* not subject to pruning */
+	int	 alias;		/* same directory as an earlier entry */
+	int	 hits;
+	long	 weight;	/* probes per miss, summed over its hits */
+} IncludeDir;
+
+typedef struct include_key {
+	struct include_key	*next;
+	char			*name;
+	int			*dirs;	/* ascending directory indices */
+	int			 ndirs;
+} IncludeKey;
+
+typedef struct include_scan {
+	IncludeDir	 dirs[INCLUDE_MAX_DIRS];
+	int		 ndirs;
+	IncludeKey	*index[INCLUDE_BUCKETS];
+	IncludeKey	*seen[INCLUDE_BUCKETS];
+	unsigned char	*before;	/* before[a * ndirs + b]: a must precede b */
+	long		 nfiles;
+	long		 probes_old;
+	long		 probes_new;
+	int		 resolved;
+	int		 failed;	/* scan cannot be trusted */
+	int		 tolerant;	/* keep scanning after a failure */
+	int		 owner;		/* top-level include being followed */
+	int		 ntops;
+	void		(*visit)(struct include_scan *, const char *, const char *);
+	void		*udata;
+} IncludeScan;
+
+static const char *include_exts[] = { "", ".inc", ".p", ".pawn" };
+
+/* modification time in nanoseconds where the platform has them */
+static int64_t
+include_mtime(const struct stat *st)
+{
+#ifdef DOG_LINUX
+	return ((int64_t)st->st_mtim.tv_sec * 1000000000 + st->st_mtim.tv_nsec);
+#else
+	return ((int64_t)st->st_mtime * 1000000000);
+#endif
+}
+
+static void
+include_key_norm(char *dst, size_t size, const char *src)
+{
+	size_t		 i;
+
+	if (src[0] == '.' && (src[1] == '/' || src[1] == '\\'))
+		src += 2;
+	for (i = 0; src[i] != '\0' && i + 1 < size; i++) {
+		char	 c = src[i];
+
+		if (c == '\\')
+			c = '/';
+#ifdef DOG_WINDOWS
+		c = (char)tolower((unsigned char)c);
+#endif
+		dst[i] = c;
+	}
+	dst[i] = '\0';
+}
+
+static IncludeKey *
+include_key_find(IncludeKey **table, const char *name, int create)
+{
+	IncludeKey	*k;
+	uint32_t	 b;
+
+	b = crypto_string_hash(name) % INCLUDE_BUCKETS;
+	for (k = table[b]; k != NULL; k = k->next)
+		if (strcmp(k->name, name) == 0)
+			return (k);
+	if (!create)
+		return (NULL);
+
+	k = dog_calloc(1, sizeof(*k));
+	if (k == NULL)
+		return (NULL);
+	k->name = strdup(name);
+	if (k->name == NULL) {
+		dog_free(k);
+		return (NULL);
+	}
+	k->next = table[b];
+	table[b] = k;
+	return (k);
+}
+
+static IncludeKey *
+include_key_push(IncludeKey **table, const char *name, int value)
+{
+	IncludeKey	*k;
+	int		*grow;
+
+	k = include_key_find(table, name, 1);
+	if (k == NULL)
+		return (NULL);
+	if (k->ndirs > 0 && k->dirs[k->ndirs - 1] == value)
+		return (k);
+	grow = dog_realloc(k->dirs, (size_t)(k->ndirs + 1) * sizeof(int));
+	if (grow == NULL)
+		return (k);
+	k->dirs = grow;
+	k->dirs[k->ndirs++] = value;
+	return (k);
+}
+
+static void
+include_key_free(IncludeKey **table)
+{
+	IncludeKey	*k, *next;
+	int		 b;
+
+	for (b = 0; b < INCLUDE_BUCKETS; b++) {
+		for (k = table[b]; k != NULL; k = next) {
+			next = k->next;
+			dog_free(k->dirs);
+			dog_free(k->name);
+			dog_free(k);
+		}
+		table[b] = NULL;
+	}
+}
+
+/*
+ * Index the headers under `path' for directory `dir'.  When `rec' is
+ * set, every directory walked (with its mtime) and every key pushed is
+ * also written to it, see include_index_root().
+ */
+static void
+include_index_dir(IncludeScan *sc, int dir, const char *path,
+    const char *rel, int depth, FILE *rec)
+{
+	DIR		*dirp;
+	struct dirent	*dent;
+	struct stat	 st;
+	char		 full[DOG_MAX_PATH], sub[DOG_MAX_PATH], key[DOG_MAX_PATH];
+	const char	*dot;
+	size_t		 i;
+
+	if (rec != NULL)
+		fprintf(rec, "D %lld %s\n", stat(path, &st) == 0 ?
+		    (long long)include_mtime(&st) : -1LL, path);
+	dirp = opendir(path);
+	if (dirp == NULL)
+		return;
+	while ((dent = readdir(dirp)) != NULL) {
+		if (dog_dot_or_dotdot(dent->d_name))
+			continue;
+		if (++sc->nfiles > INCLUDE_MAX_FILES) {
+			sc->failed = 1;
+			break;
+		}
+		snprintf(full, sizeof(full), "%s" "%s" "%s",
+		    path, _PATH_STR_SEP_POSIX, dent->d_name);
+		if (rel[0] != '\0')
+			snprintf(sub, sizeof(sub), "%s/%s", rel, dent->d_name);
+		else
+			snprintf(sub, sizeof(sub), "%s", dent->d_name);
+		if (stat(full, &st) != 0)
+			continue;
+		if (S_ISDIR(st.st_mode)) {
+			if (depth < INCLUDE_MAX_DEPTH)
+				include_index_dir(sc, dir, full, sub, depth + 1,
+				    rec);
+			continue;
+		}
+
+		include_key_norm(key, sizeof(key), sub);
+		include_key_push(sc->index, key, dir);
+		if (rec != NULL)
+			fprintf(rec, "K %s\n", key);
+
+		/* "name" also finds name.inc, name.p and name.pawn */
+		dot = strrchr(key, '.');
+		if (dot == NULL || strchr(dot, '/') != NULL)
+			continue;
+		for (i = 1; i < sizeof(include_exts) / sizeof(include_exts[0]);
+		    i++) {
+			if (strcmp(dot, include_exts[i]) == 0) {
+				key[dot - key] = '\0';
+				include_key_push(sc->index, key, dir);
+				if (rec != NULL)
+					fprintf(rec, "K %s\n", key);
+				break;
+			}
+		}
+	}
+	closedir(dirp);
+}
+
+/*
+ * The index of each search directory is kept in INCLUDE_INDEX_DIR, one
+ * file per directory: "WDI1 <root>", a "D <mtime> <dir>" line for every
+ * directory walked, a "K <key>" line for every key and a closing
+ * "E <entries>".  Creating, removing or renaming a header changes the
+ * mtime of its directory, so the record is reused as long as every
+ * directory it walked still has the same mtime.
+ */
+#define INCLUDE_INDEX_DIR	".watchdogs/include"
+
+static char *
+include_index_line(char *line)
+{
+	line[strcspn(line, "\r\n")] = '\0';
+	return (line);
+}
+
+static int
+include_index_load(IncludeScan *sc, int dir, const char *cache)
+{
+	FILE		*fp;
+	struct stat	 st;
+	char		 line[DOG_MAX_PATH + 64];
+	long long	 mtime, now;
+	long		 nfiles = -1;
+	int		 off;
+
+	fp = fopen(cache, "r");
+	if (fp == NULL)
+		return (0);
+	if (fgets(line, sizeof(line), fp) == NULL ||
+	    strncmp(line, "WDI1 ", 5) != 0 ||
+	    strcmp(include_index_line(line) + 5, sc->dirs[dir].path) != 0)
+		goto stale;
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		include_index_line(line);
+		if (line[0] == 'E' && line[1] == ' ') {
+			nfiles = strtol(line + 2, NULL, 10);
+			continue;
+		}
+		if (line[0] != 'D' || line[1] != ' ')
+			continue;
+		if (sscanf(line + 2, "%lld %n", &mtime, &off) != 1)
+			goto stale;
+		now = stat(line + 2 + off, &st) == 0 ?
+		    (long long)include_mtime(&st) : -1LL;
+		if (now != mtime)
+			goto stale;
+	}
+	if (nfiles < 0)
+		goto stale;
+
+	sc->nfiles += nfiles;
+	if (sc->nfiles > INCLUDE_MAX_FILES) {
+		sc->failed = 1;
+		fclose(fp);
+		return (1);
+	}
+	rewind(fp);
+	while (fgets(line, sizeof(line), fp) != NULL)
+		if (line[0] == 'K' && line[1] == ' ')
+			include_key_push(sc->index,
+			    include_index_line(line) + 2, dir);
+	fclose(fp);
+	return (1);
+stale:
+	fclose(fp);
+	return (0);
+}
+
+static void
+include_index_root(IncludeScan *sc, int dir)
+{
+	FILE		*rec;
+	char		 cache[DOG_MAX_PATH], tmp[DOG_MAX_PATH + 8];
+	long		 before = sc->nfiles;
+
+	snprintf(cache, sizeof(cache), "%s/%08x.idx", INCLUDE_INDEX_DIR,
+	    (unsigned)crypto_string_hash(sc->dirs[dir].path));
+	if (include_index_load(sc, dir, cache))
+		return;
+
+	MKDIR(".watchdogs");
+	MKDIR(INCLUDE_INDEX_DIR);
+	snprintf(tmp, sizeof(tmp), "%s.tmp", cache);
+	rec = fopen(tmp, "w");
+	if (rec != NULL)
+		fprintf(rec, "WDI1 %s\n", sc->dirs[dir].path);
+	include_index_dir(sc, dir, sc->dirs[dir].path, "", 0, rec);
+	if (rec == NULL)
+		return;
+	fprintf(rec, "E %ld\n", sc->nfiles - before);
+	if (fclose(rec) != 0 || sc->failed || rename(tmp, cache) != 0)
+		remove(tmp);
+}
+
+static int
+include_parse_flags(IncludeScan *sc, const char *flags, int pinned)
+{
+	char		*copy, *tok, *save = NULL;
+	const char	*dir;
+	size_t		 len;
+	int		 i;
+
+	if (flags == NULL)
+		return (0);
+	copy = strdup(flags);
+	if (copy == NULL)
+		return (-1);
+	for (tok = strtok_r(copy, " ", &save); tok != NULL;
+	    tok = strtok_r(NULL, " ", &save)) {
+		IncludeDir	*d;
+
+		if (strncmp(tok, "-i", 2) != 0) {
+			/* something other than a search path, leave it alone */
+			if (!pinned) {
+				dog_free(copy);
+				return (-1);
+			}
+			continue;
+		}
+		if (sc->ndirs >= INCLUDE_MAX_DIRS) {
+			dog_free(copy);
+			return (-1);
+		}
+		dir = tok + 2;
+		if (*dir == '=')
+			++dir;
+		len = strlen(dir);
+		while (len > 1 && (dir[len - 1] == _PATH_CHR_SEP_POSIX ||
+		    dir[len - 1] == _PATH_CHR_SEP_WIN32))
+			--len;
+		if (len == 0 || (len == 4 && strncmp(dir, "none", 4) == 0))
+			continue;
+
+		d = &sc->dirs[sc->ndirs];
+		d->token = strdup(tok);
+		d->path = dog_malloc(len + 1);
+		if (d->path != NULL) {
+			memcpy(d->path, dir, len);
+			d->path[len] = '\0';
+		}
+		d->pinned = pinned;
+		++sc->ndirs;
+		if (d->token == NULL || d->path == NULL) {
+			dog_free(copy);
+			return (-1);
+		}
+		for (i = 0; i < sc->ndirs - 1; i++)
+			if (strcmp(sc->dirs[i].path, d->path) == 0)
+				d->alias = 1;
+	}
+	dog_free(copy);
+	return (0);
+}
+
+static int
+include_is_file(const char *path)
+{
+	struct stat	 st;
+
+	return (stat(path, &st) == 0 && S_ISREG(st.st_mode));
+}
+
+/*
+ * Find `name' in `base' (as it is given when `base' is NULL), trying
+ * the extensions pawncc tries; the file that was found is written to
+ * `out'.
+ */
+static int
+include_probe(const char *base, const char *name, int nexts,
+    char *out, size_t size)
+{
+	int		 i;
+
+	for (i = 0; i < nexts; i++) {
+		if (base == NULL)
+			snprintf(out, size, "%s" "%s", name, include_exts[i]);
+		else
+			snprintf(out, size, "%s" "%s" "%s" "%s",
+			    base, _PATH_STR_SEP_POSIX, name, include_exts[i]);
+		if (include_is_file(out))
+			return (1);
+	}
+	return (0);
+}
+
+static void include_scan_file(IncludeScan *, const char *, int);
+
+static void
+include_resolve(IncludeScan *sc, const char *from, const char *name,
+    int quoted, int optional, int nest)
+{
+	IncludeKey	*k;
+	char		 key[DOG_MAX_PATH], found[DOG_MAX_PATH];
+	char		 dir[DOG_MAX_PATH];
+	const char	*dot, *slash;
+	int		 nexts, winner, i;
+	int		 local[INCLUDE_MAX_DIRS], nlocal = 0;
+
+	dot = strrchr(name, '.');
+	slash = strrchr(name, '/');
+	if (slash == NULL)
+		slash = strrchr(name, '\\');
+	nexts = (dot != NULL && (slash == NULL || dot > slash)) ? 1 :
+	    (int)(sizeof(include_exts) / sizeof(include_exts[0]));
+
+	/*
+	 * As pawncc's plungefile(): a "quoted" name is tried as it is
+	 * (against the working directory), then next to the including
+	 * file, and only then in the search paths, which an absolute name
+	 * never goes through.
+	 */
+	if (quoted) {
+		if (include_probe(NULL, name, nexts, found, sizeof(found))) {
+			include_scan_file(sc, found, nest + 1);
+			return;
+		}
+		snprintf(dir, sizeof(dir), "%s", from != NULL ? from : "");
+		slash = strrchr(dir, '/');
+		if (slash == NULL)
+			slash = strrchr(dir, '\\');
+		if (slash != NULL) {
+			dir[slash - dir] = '\0';
+			if (include_probe(dir, name, nexts, found,
+			    sizeof(found))) {
+				include_scan_file(sc, found, nest + 1);
+				return;
+			}
+		}
+	}
+	if (name[0] == '/' || name[0] == '\\') {
+		if (!optional)
+			sc->failed = 1;
+		return;
+	}
+
+	include_key_norm(key, sizeof(key), name);
+	k = include_key_find(sc->index, key, 0);
+	if (k != NULL) {
+		for (i = 0; i < k->ndirs; i++)
+			local[nlocal++] = k->dirs[i];
+	} else {
+		/* "../x", absolute paths and the like are not in the index */
+		for (i = 0; i < sc->ndirs; i++)
+			if (!sc->dirs[i].alias &&
+			    include_probe(sc->dirs[i].path, name, nexts,
+			    found, sizeof(found)))
+				local[nlocal++] = i;
+	}
+
+	if (nlocal == 0) {
+		if (!optional)
+			sc->failed = 1;
+		return;
+	}
+
+	winner = local[0];
+	++sc->dirs[winner].hits;
+	++sc->resolved;
+	for (i = 1; i < nlocal; i++)
+		sc->before[winner * sc->ndirs + local[i]] = 1;
+
+	/* every directory ahead of the winner is a failed probe */
+	sc->dirs[winner].weight += nexts;
+	sc->probes_old += (long)winner * nexts;
+
+	if (include_probe(sc->dirs[winner].path, name, nexts,
+	    found, sizeof(found)))
+		include_scan_file(sc, found, nest + 1);
+}
+
+static char *
+include_read_file(const char *path, long *sizep)
+{
+	FILE		*fp;
+	char		*buf;
+	long		 size;
+
+	fp = fopen(path, "rb");
+	if (fp == NULL)
+		return (NULL);
+	fseek(fp, 0, SEEK_END);
+	size = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	if (size < 0) {
+		fclose(fp);
+		return (NULL);
+	}
+	buf = dog_malloc((size_t)size + 1);
+	if (buf == NULL) {
+		fclose(fp);
+		return (NULL);
+	}
+	size = (long)fread(buf, 1, (size_t)size, fp);
+	buf[size] = '\0';
+	fclose(fp);
+	if (sizep != NULL)
+		*sizep = size;
+	return (buf);
+}
+
+/*
+ * Recognise an #include or #tryinclude on one line of source.  Returns
+ * 1 with the header in `name', 0 for any other line, and -1 for an
+ * include whose target is a macro.  `comment' carries the state of a
+ * block comment from one line to the next.
+ */
+static int
+include_parse_line(const char *line, int *comment, char *name, size_t size,
+    int *quoted, int *optional)
+{
+	const char	*p = line;
+	char		 close;
+	size_t		 n;
+
+	while (*p == ' ' || *p == '\t')
+		++p;
+	if (*comment) {
+		const char *c = strstr(p, "*/");
+		if (c == NULL)
+			return (0);
+		*comment = 0;
+		p = c + 2;
+		while (*p == ' ' || *p == '\t')
+			++p;
+	}
+	if (p[0] == '/' && p[1] == '*') {
+		if (strstr(p + 2, "*/") == NULL)
+			*comment = 1;
+		return (0);
+	}
+	if (*p != '#')
+		return (0);
+	++p;
+	while (*p == ' ' || *p == '\t')
+		++p;
+	if (strncmp(p, "include", 7) == 0) {
+		*optional = 0;
+		p += 7;
+	} else if (strncmp(p, "tryinclude", 10) == 0) {
+		*optional = 1;
+		p += 10;
+	} else
+		return (0);
+	if (*p != ' ' && *p != '\t' && *p != '<' && *p != '"')
+		return (0);
+	while (*p == ' ' || *p == '\t')
+		++p;
+
+	if (*p == '<') {
+		*quoted = 0;
+		close = '>';
+	} else if (*p == '"') {
+		*quoted = 1;
+		close = '"';
+	} else
+		return (-1);
+	++p;
+	for (n = 0; p[n] != '\0' && p[n] != close && n + 1 < size; n++)
+		name[n] = p[n];
+	name[n] = '\0';
+	if (p[n] != close || n == 0)
+		return (0);
+	return (1);
+}
+
+static void
+include_scan_file(IncludeScan *sc, const char *path, int nest)
+{
+	char		*buf, *end, *line;
+	char		 key[DOG_MAX_PATH], name[DOG_MAX_PATH];
+	int		 comment = 0, quoted, optional, r;
+
+	if (nest > INCLUDE_MAX_NEST || (sc->failed && !sc->tolerant))
+		return;
+	include_key_norm(key, sizeof(key), path);
+	if (include_key_find(sc->seen, key, 0) != NULL)
+		return;
+	include_key_find(sc->seen, key, 1);
+
+	buf = include_read_file(path, NULL);
+	if (buf == NULL) {
+		sc->failed = 1;
+		return;
+	}
+	if (sc->visit != NULL)
+		sc->visit(sc, path, buf);
+
+	for (line = buf; line != NULL && *line != '\0'; line = end) {
+		if (sc->failed && !sc->tolerant)
+			break;
+		end = strchr(line, '\n');
+		if (end != NULL)
+			*end++ = '\0';
+
+		r = include_parse_line(line, &comment, name, sizeof(name),
+		    &quoted, &optional);
+		if (r < 0) {
+			/* #include MACRO: cannot be followed statically */
+			sc->failed = 1;
+			if (nest == 0)
+				sc->ntops++;
+			continue;
+		}
+		if (r == 0)
+			continue;
+		if (nest == 0)
+			sc->owner = sc->ntops++;
+		include_resolve(sc, path, name, quoted, optional, nest);
+		if (nest == 0)
+			sc->owner = -1;
+	}
+	dog_free(buf);
+}
+
+static void
+include_scan_free(IncludeScan *sc)
+{
+	int		 i;
+
+	include_key_free(sc->index);
+	include_key_free(sc->seen);
+	for (i = 0; i < sc->ndirs; i++) {
+		dog_free(sc->dirs[i].token);
+		dog_free(sc->dirs[i].path);
+	}
+	dog_free(sc->before);
+	dog_free(sc);
+}
+
+/*
+ * pawncc appends its own include directory after every -i path: the
+ * "include" directory beside the executable, or its parent's for the
+ * bin/ layout of the community compiler.
+ */
+static void
+include_add_sysdirs(IncludeScan *sc, const char *pawncc_path)
+{
+	char		 bin[DOG_PATH_MAX], flag[DOG_PATH_MAX + 16];
+	const char	*slash;
+	struct stat	 st;
+
+	if (pawncc_path == NULL)
+		return;
+	slash = strrchr(pawncc_path, _PATH_CHR_SEP_POSIX);
+	if (slash == NULL)
+		slash = strrchr(pawncc_path, _PATH_CHR_SEP_WIN32);
+	if (slash != NULL)
+		snprintf(bin, sizeof(bin), "%.*s",
+		    (int)(slash - pawncc_path), pawncc_path);
+	else
+		snprintf(bin, sizeof(bin), ".");
+
+	snprintf(flag, sizeof(flag), "-i%s/include", bin);
+	if (stat(flag + 2, &st) == 0 && S_ISDIR(st.st_mode)) {
+		include_parse_flags(sc, flag, 1);
+		return;
+	}
+	snprintf(flag, sizeof(flag), "-i%s/../include", bin);
+	if (stat(flag + 2, &st) == 0 && S_ISDIR(st.st_mode))
+		include_parse_flags(sc, flag, 1);
+}
+
+/*
+ * dog_include_prune
+ * Reduce the -i flags in `includes' to the directories the input
+ * really draws headers from.  `pinned' holds further -i flags that
+ * follow them on the command line; they are indexed but never dropped
+ * or moved.  Returns a new flag string, or NULL when the original
+ * flags should be used as they are.
+ */
+char *
+dog_include_prune(const char *pawncc_path, const char *input_path,
+    const char *includes, const char *pinned)
+{
+	IncludeScan	*sc;
+	char		*out = NULL;
+	int		 order[INCLUDE_MAX_DIRS], placed[INCLUDE_MAX_DIRS];
+	int		 nkeep = 0, nfree = 0, changed = 0, i, j;
+	size_t		 len = 1;
+
+	if (input_path == NULL || includes == NULL)
+		return (NULL);
+
+	sc = dog_calloc(1, sizeof(*sc));
+	if (sc == NULL)
+		return (NULL);
+	sc->owner = -1;
+	if (include_parse_flags(sc, includes, 0) != 0 ||
+	    include_parse_flags(sc, pinned, 1) != 0)
+		goto done;
+	include_add_sysdirs(sc, pawncc_path);
+	for (i = 0; i < sc->ndirs; i++)
+		if (!sc->dirs[i].pinned)
+			++nfree;
+	if (nfree < 2)
+		goto done;
+
+	sc->before = dog_calloc((size_t)sc->ndirs * (size_t)sc->ndirs, 1);
+	if (sc->before == NULL)
+		goto done;
+	for (i = 0; i < sc->ndirs && !sc->failed; i++)
+		if (!sc->dirs[i].alias)
+			include_index_root(sc, i);
+	if (sc->failed)
+		goto done;
+
+	/* the compiler's prefix file, read when present */
+	include_resolve(sc, NULL, "default", 0, 1, 0);
+	include_scan_file(sc, input_path, 0);
+	if (sc->failed) {
+#if defined(_DBG_PRINT)
+		pr_info(stdout, "include index: scan incomplete, "
+		    "keeping all %d directories", sc->ndirs);
+#endif
+		goto done;
+	}
+
+	/*
+	 * Busiest directory first, as long as no directory is placed
+	 * ahead of one that must shadow it.
+	 */
+	memset(placed, 0, sizeof(placed));
+	for (;;) {
+		int	 best = -1;
+
+		for (i = 0; i < sc->ndirs; i++) {
+			if (placed[i] || sc->dirs[i].pinned ||
+			    sc->dirs[i].hits == 0)
+				continue;
+			for (j = 0; j < sc->ndirs; j++)
+				if (!placed[j] && !sc->dirs[j].pinned &&
+				    sc->dirs[j].hits > 0 &&
+				    sc->before[j * sc->ndirs + i])
+					break;
+			if (j < sc->ndirs)
+				continue;
+			if (best < 0 || sc->dirs[i].hits > sc->dirs[best].hits)
+				best = i;
+		}
+		if (best < 0)
+			break;
+		placed[best] = 1;
+		order[nkeep++] = best;
+	}
+
+	if (nkeep != nfree)
+		changed = 1;
+	for (i = 0; i < nkeep; i++)
+		if (i > 0 && order[i] < order[i - 1])
+			changed = 1;
+	if (!changed)
+		goto done;
+
+	/* pinned directories keep their place after the pruned ones */
+	for (i = 0; i < sc->ndirs; i++)
+		if (sc->dirs[i].pinned)
+			order[nkeep++] = i;
+
+	/* failed probes with the new order */
+	for (i = 0; i < nkeep; i++) {
+		int	 d = order[i];
+
+		len += strlen(sc->dirs[d].token) + 1;
+		sc->probes_new += (long)i * sc->dirs[d].weight;
+	}
+
+	out = dog_malloc(len);
+	if (out == NULL)
+		goto done;
+	out[0] = '\0';
+	for (i = 0; i < nkeep; i++) {
+		if (sc->dirs[order[i]].pinned)
+			continue;
+		if (out[0] != '\0')
+			strcat(out, " ");
+		strcat(out, sc->dirs[order[i]].token);
+	}
+
+	pr_info(stdout,
+	    "include index: %d of %d search paths needed, "
+	    "~%ld failed lookups avoided",
+	    nkeep, sc->ndirs,
+	    sc->probes_old > sc->probes_new ?
+	    sc->probes_old - sc->probes_new : 0L);
+done:
+	include_scan_free(sc);
+	return (out);
+}
+
+/*
+ * Follow the whole #include graph of `input_path' with the search
+ * paths in `flags', calling `visit' on every file, and keep going past
+ * anything that cannot be resolved.
+ */
+static IncludeScan *
+include_scan_graph(const char *pawncc_path, const char *input_path,
+    const char *flags,
+    void (*visit)(IncludeScan *, const char *, const char *), void *udata)
+{
+	IncludeScan	*sc;
+	int		 i;
+
+	sc = dog_calloc(1, sizeof(*sc));
+	if (sc == NULL)
+		return (NULL);
+	sc->owner = -1;
+	sc->tolerant = 1;
+	sc->visit = visit;
+	sc->udata = udata;
+	if (include_parse_flags(sc, flags, 1) != 0) {
+		include_scan_free(sc);
+		return (NULL);
+	}
+	include_add_sysdirs(sc, pawncc_path);
+	for (i = 0; i < sc->ndirs; i++)
+		if (!sc->dirs[i].alias)
+			include_index_root(sc, i);
+	sc->before = dog_calloc((size_t)sc->ndirs * (size_t)sc->ndirs + 1, 1);
+	if (sc->before == NULL) {
+		include_scan_free(sc);
+		return (NULL);
+	}
+	include_scan_file(sc, input_path, 0);
+	return (sc);
+}
+
+static void
+include_preload_visit(IncludeScan *sc, const char *path, const char *buf)
+{
+	if (dog_pawnc_vfs_add(path, buf, strlen(buf)) == 0)
+		++*(int *)sc->udata;
+}
+
+/*
+ * dog_include_preload
+ * Put the files of the #include graph of `input_path' -- and only
+ * those -- into the libpawnc include cache, from the buffers the scan
+ * reads anyway.  Returns the number of files cached.
+ */
+int
+dog_include_preload(const char *pawncc_path, const char *input_path,
+    const char *flags)
+{
+	IncludeScan	*sc;
+	int		 n = 0;
+
+	if (input_path == NULL)
+		return (0);
+	sc = include_scan_graph(pawncc_path, input_path, flags,
+	    include_preload_visit, &n);
+	if (sc == NULL)
+		return (-1);
+	include_scan_free(sc);
+#if defined(_DBG_PRINT)
+	pr_info(stdout, "libpawnc: include cache has %d file(s) of %s", n,
+	    input_path);
+#endif
+	return (n);
+}
+
+/*
+ * Compile-time analysis of the top-level includes.  For every #include
+ * in the input two variants are compiled next to a baseline: the input
+ * without that line ("without", its marginal cost) and the includes up
+ * to and including it ("prefix").  What a prefix takes over the one
+ * before it, an empty main() for the first, is what the include adds
+ * on top of those it builds on, so an include that cannot compile
+ * without a_samp still gets a real figure.  An include the build fails
+ * without is costed by that figure, and has no cost at all when its
+ * prefix fails too; such failures are marked in the report.  All of
+ * them run in parallel through the pawnc worker pool, so costs are the
+ * CPU time of each compile rather than its wall time, which would
+ * mostly measure the scheduler.  Variants are written to
+ * INCLUDE_ANALYZE_DIR with the input's directory as the first -i path,
+ * so its "quoted" includes still resolve.  The baseline also writes
+ * pawncc's -r cross-reference report, which together with a scan of
+ * what each include declares tells which includes are never
+ * referenced.
+ */
+
+#define INCLUDE_ANALYZE_DIR	".watchdogs/analyze"
+
+typedef struct {
+	char		 name[DOG_PATH_MAX];
+	char		 text[DOG_PATH_MAX];	/* the directive as written */
+	int		 line;
+	int		 funcs;
+	int		 publics;
+	int		 defines;
+	int		 referenced;
+	char		 src_without[DOG_PATH_MAX + 32];
+	char		 src_prefix[DOG_PATH_MAX + 32];
+	long		 size_without;
+	long		 size_added;	/* bytes over the prefix before it */
+	double		 added;		/* CPU seconds over that prefix */
+	int		 added_ok;	/* both prefixes compiled */
+	double		 cost;		/* CPU seconds it adds to the build */
+	int		 cost_ok;
+} IncludeTop;
+
+typedef struct {
+	IncludeTop	*tops;
+	int		 ntops;
+	IncludeKey	*decl[INCLUDE_BUCKETS];		/* symbol -> owner */
+	IncludeKey	*uses[INCLUDE_BUCKETS];		/* identifier -> owners */
+	IncludeKey	*refs[INCLUDE_BUCKETS];		/* referenced in -r */
+} IncludeAnalysis;
+
+static int
+include_ident_start(int c)
+{
+	return (isalpha(c) || c == '_' || c == '@');
+}
+
+static int
+include_ident_char(int c)
+{
+	return (isalnum(c) || c == '_' || c == '@');
+}
+
+/*
+ * Declaration at the start of a line: "#define NAME", "native Float:Foo(",
+ * "stock Foo(", ...  Returns INCLUDE_DECL_DEFINE or INCLUDE_DECL_FUNC
+ * with the name in `id', or 0.
+ */
+static int
+include_decl_parse(const char *p, char *id, size_t size, int *is_public)
+{
+	static const char *keys[] = {
+		"native", "forward", "stock", "public", "static", "const"
+	};
+	int		 is_func = 0;
+	size_t		 i, n;
+
+	*is_public = 0;
+	while (*p == ' ' || *p == '\t')
+		++p;
+	if (strncmp(p, "#define", 7) == 0 && (p[7] == ' ' || p[7] == '\t')) {
+		p += 7;
+		while (*p == ' ' || *p == '\t')
+			++p;
+		for (n = 0; include_ident_char((unsigned char)p[n]) &&
+		    n + 1 < size; n++)
+			id[n] = p[n];
+		id[n] = '\0';
+		if (n == 0 || !include_ident_start((unsigned char)id[0]))
+			return (0);
+		return (INCLUDE_DECL_DEFINE);
+	}
+
+	for (;;) {
+		for (i = 0; i < sizeof(keys) / sizeof(keys[0]); i++) {
+			n = strlen(keys[i]);
+			if (strncmp(p, keys[i], n) == 0 &&
+			    (p[n] == ' ' || p[n] == '\t'))
+				break;
+		}
+		if (i == sizeof(keys) / sizeof(keys[0]))
+			break;
+		if (i <= 3)
+			is_func = 1;
+		if (i == 3)
+			*is_public = 1;
+		p += strlen(keys[i]);
+		while (*p == ' ' || *p == '\t')
+			++p;
+	}
+	if (!is_func)
+		return (0);
+
+	for (n = 0; include_ident_char((unsigned char)p[n]) && n + 1 < size; n++)
+		id[n] = p[n];
+	id[n] = '\0';
+	p += n;
+	if (*p == ':' && p[1] != ':') {
+		/* tag, the name follows */
+		++p;
+		for (n = 0; include_ident_char((unsigned char)p[n]) &&
+		    n + 1 < size; n++)
+			id[n] = p[n];
+		id[n] = '\0';
+		p += n;
+	}
+	while (*p == ' ' || *p == '\t')
+		++p;
+	if (n == 0 || *p != '(' || !include_ident_start((unsigned char)id[0]))
+		return (0);
+	/* a public with a body, not just its forward */
+	if (*is_public && p[strcspn(p, ";\n")] == ';')
+		*is_public = 0;
+	return (INCLUDE_DECL_FUNC);
+}
+
+static void
+include_analyze_decl(IncludeAnalysis *an, int owner, const char *p)
+{
+	IncludeTop	*t = (owner >= 0) ? &an->tops[owner] : NULL;
+	char		 id[64];
+	int		 kind, is_public;
+
+	kind = include_decl_parse(p, id, sizeof(id), &is_public);
+	if (kind == 0)
+		return;
+	include_key_push(an->decl, id, owner);
+	if (t == NULL)
+		return;
+	if (kind == INCLUDE_DECL_DEFINE)
+		++t->defines;
+	else {
+		++t->funcs;
+		if (is_public)
+			++t->publics;
+	}
+}
+
+static void
+include_analyze_visit(IncludeScan *sc, const char *path, const char *buf)
+{
+	IncludeAnalysis	*an = sc->udata;
+	const char	*p = buf, *line = buf;
+	char		 id[64];
+	int		 owner = sc->owner, comment = 0;
+	size_t		 n;
+
+	(void)path;
+	if (owner >= an->ntops)
+		return;
+
+	while (*p != '\0') {
+		if (p == line && !comment)
+			include_analyze_decl(an, owner, p);
+		if (*p == '\n') {
+			line = ++p;
+			continue;
+		}
+		if (comment) {
+			if (p[0] == '*' && p[1] == '/') {
+				comment = 0;
+				p += 2;
+			} else
+				++p;
+			continue;
+		}
+		if (p[0] == '/' && p[1] == '*') {
+			comment = 1;
+			p += 2;
+			continue;
+		}
+		if (p[0] == '/' && p[1] == '/') {
+			while (*p != '\0' && *p != '\n')
+				++p;
+			continue;
+		}
+		if (*p == '"' || *p == '\'') {
+			char q = *p++;
+			while (*p != '\0' && *p != q && *p != '\n') {
+				if (*p == '\\' && p[1] != '\0')
+					++p;
+				++p;
+			}
+			if (*p == q)
+				++p;
+			continue;
+		}
+		if (include_ident_start((unsigned char)*p) &&
+		    (p == buf || !include_ident_char((unsigned char)p[-1]))) {
+			for (n = 0; include_ident_char((unsigned char)p[n]); n++)
+				if (n + 1 < sizeof(id))
+					id[n] = p[n];
+			id[n < sizeof(id) ? n : sizeof(id) - 1] = '\0';
+			include_key_push(an->uses, id, owner);
+			p += n;
+			continue;
+		}
+		++p;
+	}
+}
+
+/* Symbols with at least one <referrer> in a pawncc -r report */
+static int
+include_analyze_xml(IncludeAnalysis *an, const char *path)
+{
+	char		*buf, *p, *end, *next;
+	char		 id[64];
+	size_t		 n;
+	int		 count = 0;
+
+	buf = include_read_file(path, NULL);
+	if (buf == NULL)
+		return (-1);
+	for (p = strstr(buf, "<member name=\""); p != NULL; p = next) {
+		p += 14;
+		if (p[0] != '\0' && p[1] == ':')
+			p += 2;
+		for (n = 0; p[n] != '\0' && p[n] != '"' && p[n] != '(' &&
+		    n + 1 < sizeof(id); n++)
+			id[n] = p[n];
+		id[n] = '\0';
+
+		next = strstr(p, "<member name=\"");
+		end = strstr(p, "</member>");
+		if (end == NULL || (next != NULL && next < end))
+			continue;
+		*end = '\0';
+		if (strstr(p, "<referrer") != NULL && n > 0) {
+			include_key_find(an->refs, id, 1);
+			++count;
+		}
+		*end = '<';
+	}
+	dog_free(buf);
+	return (count);
+}
+
+static long
+include_file_size(const char *path)
+{
+	struct stat	 st;
+
+	if (stat(path, &st) != 0 || !S_ISREG(st.st_mode))
+		return (-1);
+	return ((long)st.st_size);
+}
+
+static char **
+include_job_argv(const char *pawncc_path, const char *src, const char *amx,
+    const char *flags, const char *extra)
+{
+	char		**argv, *copy, *tok, *save = NULL;
+	size_t		 n = 5, i = 0;
+	const char	*p;
+
+	for (p = flags; p != NULL && *p != '\0'; p++)
+		if (*p == ' ')
+			++n;
+	argv = dog_calloc(n + 1, sizeof(char *));
+	if (argv == NULL)
+		return (NULL);
+	argv[i++] = strdup(pawncc_path);
+	argv[i++] = strdup(src);
+	argv[i] = dog_malloc(strlen(amx) + 3);
+	if (argv[i] != NULL)
+		sprintf(argv[i], "-o%s", amx);
+	++i;
+	if (flags != NULL && (copy = strdup(flags)) != NULL) {
+		for (tok = strtok_r(copy, " ", &save); tok != NULL && i < n;
+		    tok = strtok_r(NULL, " ", &save))
+			argv[i++] = strdup(tok);
+		dog_free(copy);
+	}
+	if (extra != NULL && i < n)
+		argv[i++] = strdup(extra);
+	argv[i] = NULL;
+	return (argv);
+}
+
+static void
+include_job_free(PawncJob *job)
+{
+	size_t		 i;
+
+	if (job->argv == NULL)
+		return;
+	for (i = 0; job->argv[i] != NULL; i++)
+		dog_free(job->argv[i]);
+	dog_free(job->argv);
+	dog_free((char *)job->log_path);
+}
+
+static char *
+include_job_path(const char *fmt, int index)
+{
+	char		 path[DOG_PATH_MAX];
+
+	snprintf(path, sizeof(path), fmt, index);
+	return (strdup(path));
+}
+
+/* Write `input' with line `skip' blanked, or just `only' plus main() */
+static int
+include_write_variant(const char *dst, const char *input, int skip,
+    const char *only)
+{
+	FILE		*out;
+	char		*buf, *line, *end;
+	int		 lineno = 0;
+
+	out = fopen(dst, "wb");
+	if (out == NULL)
+		return (-1);
+	if (only != NULL) {
+		fprintf(out, "%s\nmain(){}\n", only);
+		fclose(out);
+		return (0);
+	}
+	buf = include_read_file(input, NULL);
+	if (buf == NULL) {
+		fclose(out);
+		remove(dst);
+		return (-1);
+	}
+	for (line = buf; line != NULL && *line != '\0'; line = end) {
+		end = strchr(line, '\n');
+		if (end != NULL)
+			*end++ = '\0';
+		if (++lineno == skip)
+			fputs("\n", out);
+		else
+			fprintf(out, "%s\n", line);
+	}
+	dog_free(buf);
+	fclose(out);
+	return (0);
+}
+
+/* by cost, most expensive first, those without one last */
+static int
+include_cost_cmp(const void *a, const void *b)
+{
+	const IncludeTop *x = a, *y = b;
+
+	if (x->cost_ok != y->cost_ok)
+		return (y->cost_ok - x->cost_ok);
+	if (x->cost < y->cost)
+		return (1);
+	if (x->cost > y->cost)
+		return (-1);
+	return (x->line - y->line);
+}
+
+/*
+ * dog_include_analyze
+ * Rank the top-level includes of `input_path' by compile time and AMX
+ * size and point out the ones nothing refers to.  `flags' holds every
+ * pawncc option after the output file.
+ */
+int
+dog_include_analyze(const char *pawncc_path, const char *input_path,
+    const char *flags)
+{
+	IncludeScan	*sc = NULL;
+	IncludeAnalysis	 an;
+	PawncJob	*jobs = NULL;
+	char		*buf = NULL, *line, *end, *slash, *vflags = NULL;
+	char		*prefix = NULL;
+	size_t		 plen = 0;
+	char		 name[DOG_PATH_MAX], dir[DOG_PATH_MAX];
+	char		 xml[DOG_PATH_MAX], amx[DOG_PATH_MAX], rflag[DOG_PATH_MAX + 4];
+	long		 base_size, prev_size;
+	double		 prev_cpu;
+	int		 comment = 0, quoted, optional, lineno = 0, njobs, i, r;
+	int		 nunused = 0, nrefs, ret = -1;
+
+	memset(&an, 0, sizeof(an));
+#ifndef DOG_LINUX
+	pr_error(stdout, "--analyze: parallel compiles are not "
+	    "supported on this platform");
+	return (-1);
+#endif
+
+	/* top-level includes, in order */
+	buf = include_read_file(input_path, NULL);
+	if (buf == NULL) {
+		pr_error(stdout, "--analyze: cannot read %s", input_path);
+		return (-1);
+	}
+	for (line = buf; line != NULL && *line != '\0'; line = end) {
+		IncludeTop	*grow, *t;
+
+		end = strchr(line, '\n');
+		if (end != NULL)
+			*end++ = '\0';
+		++lineno;
+		r = include_parse_line(line, &comment, name, sizeof(name),
+		    &quoted, &optional);
+		if (r == 0)
+			continue;
+		grow = dog_realloc(an.tops,
+		    (size_t)(an.ntops + 1) * sizeof(IncludeTop));
+		if (grow == NULL)
+			goto done;
+		an.tops = grow;
+		t = &an.tops[an.ntops++];
+		memset(t, 0, sizeof(*t));
+		snprintf(t->name, sizeof(t->name), "%s",
+		    r > 0 ? name : "(macro)");
+		snprintf(t->text, sizeof(t->text), "%s", line);
+		t->text[strcspn(t->text, "\r")] = '\0';
+		t->line = lineno;
+	}
+	dog_free(buf);
+	buf = NULL;
+	if (an.ntops == 0) {
+		pr_info(stdout, "--analyze: %s has no #include to measure",
+		    input_path);
+		ret = 0;
+		goto done;
+	}
+
+	/* what every include declares and who uses it */
+	sc = include_scan_graph(pawncc_path, input_path, flags,
+	    include_analyze_visit, &an);
+	if (sc == NULL)
+		goto done;
+
+	/* the input's directory goes first, where pawncc looks for "name" */
+	snprintf(dir, sizeof(dir), "%s", input_path);
+	slash = strrchr(dir, _PATH_CHR_SEP_POSIX);
+	if (slash == NULL)
+		slash = strrchr(dir, _PATH_CHR_SEP_WIN32);
+	if (slash != NULL)
+		*slash = '\0';
+	else
+		snprintf(dir, sizeof(dir), ".");
+	vflags = dog_malloc(strlen(dir) + (flags ? strlen(flags) : 0) + 8);
+	if (vflags == NULL)
+		goto done;
+	sprintf(vflags, "-i=%s/%s%s", dir, flags ? " " : "", flags ? flags : "");
+
+	MKDIR(".watchdogs");
+	MKDIR(INCLUDE_ANALYZE_DIR);
+	njobs = 2 + an.ntops * 2;
+	jobs = dog_calloc((size_t)njobs, sizeof(PawncJob));
+	if (jobs == NULL)
+		goto done;
+
+	snprintf(xml, sizeof(xml), INCLUDE_ANALYZE_DIR "/base.xml");
+	snprintf(amx, sizeof(amx), INCLUDE_ANALYZE_DIR "/base.amx");
+	snprintf(rflag, sizeof(rflag), "-r%s", xml);
+	remove(xml);
+	remove(amx);
+	jobs[0].argv = include_job_argv(pawncc_path, input_path, amx,
+	    flags, rflag);
+	jobs[0].log_path = strdup(INCLUDE_ANALYZE_DIR "/base.log");
+
+	/* the empty prefix, what the first include is measured against */
+	include_write_variant(INCLUDE_ANALYZE_DIR "/prefix.pwn", NULL, 0, "");
+	snprintf(amx, sizeof(amx), INCLUDE_ANALYZE_DIR "/prefix.amx");
+	remove(amx);
+	jobs[1].argv = include_job_argv(pawncc_path,
+	    INCLUDE_ANALYZE_DIR "/prefix.pwn", amx, vflags, NULL);
+	jobs[1].log_path = strdup(INCLUDE_ANALYZE_DIR "/prefix.log");
+
+	for (i = 0; i < an.ntops; i++) {
+		IncludeTop	*t = &an.tops[i];
+		char		*grow;
+
+		grow = dog_realloc(prefix, plen + strlen(t->text) + 2);
+		if (grow == NULL)
+			goto done;
+		prefix = grow;
+		plen += (size_t)sprintf(prefix + plen, "%s\n", t->text);
+
+		snprintf(t->src_without, sizeof(t->src_without),
+		    INCLUDE_ANALYZE_DIR "/without_%d.pwn", i);
+		snprintf(t->src_prefix, sizeof(t->src_prefix),
+		    INCLUDE_ANALYZE_DIR "/prefix_%d.pwn", i);
+		include_write_variant(t->src_without, input_path, t->line, NULL);
+		include_write_variant(t->src_prefix, NULL, 0, prefix);
+
+		snprintf(amx, sizeof(amx),
+		    INCLUDE_ANALYZE_DIR "/without_%d.amx", i);
+		remove(amx);
+		jobs[2 + i * 2].argv = include_job_argv(pawncc_path,
+		    t->src_without, amx, vflags, NULL);
+		jobs[2 + i * 2].log_path = include_job_path(
+		    INCLUDE_ANALYZE_DIR "/without_%d.log", i);
+
+		snprintf(amx, sizeof(amx),
+		    INCLUDE_ANALYZE_DIR "/prefix_%d.amx", i);
+		remove(amx);
+		jobs[3 + i * 2].argv = include_job_argv(pawncc_path,
+		    t->src_prefix, amx, vflags, NULL);
+		jobs[3 + i * 2].log_path = include_job_path(
+		    INCLUDE_ANALYZE_DIR "/prefix_%d.log", i);
+	}
+	for (i = 0; i < njobs; i++)
+		if (jobs[i].argv == NULL || jobs[i].log_path == NULL)
+			goto done;
+
+	dog_pawnc_load(pawncc_path);
+	pr_info(stdout, "--analyze: %d compiles of %d include(s)%s..",
+	    njobs, an.ntops,
+	    dog_pawnc_loaded() ? " through libpawnc" : "");
+	dog_pawnc_run_jobs(jobs, njobs, 0);
+
+	remove(INCLUDE_ANALYZE_DIR "/prefix.pwn");
+	for (i = 0; i < an.ntops; i++) {
+		remove(an.tops[i].src_without);
+		remove(an.tops[i].src_prefix);
+	}
+
+	base_size = include_file_size(INCLUDE_ANALYZE_DIR "/base.amx");
+	if (base_size < 0) {
+		pr_error(stdout, "--analyze: the baseline does not compile, "
+		    "see " INCLUDE_ANALYZE_DIR "/base.log");
+		goto done;
+	}
+
+	nrefs = include_analyze_xml(&an, xml);
+	prev_size = include_file_size(INCLUDE_ANALYZE_DIR "/prefix.amx");
+	prev_cpu = jobs[1].cpu;
+	for (i = 0; i < an.ntops; i++) {
+		IncludeTop	*t = &an.tops[i];
+		PawncJob	*without = &jobs[2 + i * 2];
+		PawncJob	*upto = &jobs[3 + i * 2];
+		IncludeKey	*k, *u;
+		long		 size;
+		int		 b, j;
+
+		snprintf(amx, sizeof(amx),
+		    INCLUDE_ANALYZE_DIR "/without_%d.amx", i);
+		t->size_without = include_file_size(amx);
+		snprintf(amx, sizeof(amx),
+		    INCLUDE_ANALYZE_DIR "/prefix_%d.amx", i);
+		size = include_file_size(amx);
+		t->added_ok = prev_size >= 0 && size >= 0;
+		if (t->added_ok) {
+			t->added = upto->cpu - prev_cpu;
+			t->size_added = size - prev_size;
+		}
+		prev_size = size;
+		prev_cpu = upto->cpu;
+		if (t->size_without >= 0) {
+			t->cost = jobs[0].cpu - without->cpu;
+			t->cost_ok = 1;
+		} else if (t->added_ok) {
+			t->cost = t->added;
+			t->cost_ok = 1;
+		}
+
+		/* referenced: used outside its own tree, or in the -r report */
+		t->referenced = (t->publics > 0);
+		for (b = 0; b < INCLUDE_BUCKETS && !t->referenced; b++) {
+			for (k = an.decl[b]; k != NULL; k = k->next) {
+				if (k->dirs[0] != i)
+					continue;
+				if (nrefs > 0 &&
+				    include_key_find(an.refs, k->name, 0) != NULL) {
+					t->referenced = 1;
+					break;
+				}
+				u = include_key_find(an.uses, k->name, 0);
+				for (j = 0; u != NULL && j < u->ndirs; j++)
+					if (u->dirs[j] != i)
+						break;
+				if (u != NULL && j < u->ndirs) {
+					t->referenced = 1;
+					break;
+				}
+			}
+		}
+	}
+
+	printf("\n include analysis : " DOG_COL_YELLOW "%s" DOG_COL_DEFAULT
+	    "  (%d include(s), %d compiles)\n", input_path, an.ntops, njobs);
+	printf(" baseline         : %.3f s CPU, %ld bytes\n",
+	    jobs[0].cpu, base_size);
+	printf("\n   %9s  %10s  %9s  %9s  %s\n",
+	    "cost(ms)", "size(B)", "added(ms)", "added(B)", "include");
+
+	{
+		IncludeTop	*sorted;
+
+		sorted = dog_malloc((size_t)an.ntops * sizeof(IncludeTop));
+		if (sorted == NULL)
+			goto done;
+		memcpy(sorted, an.tops, (size_t)an.ntops * sizeof(IncludeTop));
+		qsort(sorted, (size_t)an.ntops, sizeof(IncludeTop),
+		    include_cost_cmp);
+		for (i = 0; i < an.ntops; i++) {
+			IncludeTop	*t = &sorted[i];
+			int		 unused;
+
+			unused = !t->referenced && (t->funcs + t->defines) > 0;
+			if (unused)
+				++nunused;
+			if (t->size_without >= 0)
+				printf("   %9.1f  %+10ld  ", t->cost * 1000.0,
+				    base_size - t->size_without);
+			else if (t->cost_ok)
+				printf("   %9.1f  %10s  ", t->cost * 1000.0,
+				    "needed");
+			else
+				printf("   %9s  %10s  ", "-", "needed");
+			if (t->added_ok)
+				printf("%9.1f  %+9ld  ", t->added * 1000.0,
+				    t->size_added);
+			else
+				printf("%9s  %9s  ", "failed", "-");
+			printf("%s:%d <%s>%s\n", input_path, t->line, t->name,
+			    unused ? DOG_COL_YELLOW "  unreferenced"
+			    DOG_COL_DEFAULT : "");
+		}
+		dog_free(sorted);
+	}
+
+	if (nrefs < 0)
+		pr_warning(stdout, "--analyze: pawncc wrote no -r report, "
+		    "references are from a text scan only");
+	if (nunused > 0)
+		pr_info(stdout, "%d include(s) declare nothing the build "
+		    "refers to", nunused);
+	println(stdout, " logs and outputs: " INCLUDE_ANALYZE_DIR);
+	ret = 0;
+done:
+	dog_free(vflags);
+	dog_free(prefix);
+	if (jobs != NULL) {
+		for (i = 0; i < 2 + an.ntops * 2; i++)
+			include_job_free(&jobs[i]);
+		dog_free(jobs);
+	}
+	if (sc != NULL)
+		include_scan_free(sc);
+	include_key_free(an.decl);
+	include_key_free(an.uses);
+	include_key_free(an.refs);
+	dog_free(an.tops);
+	dog_free(buf);
+	return (ret);
+}
+
+typedef struct {
+	IncludeDeclFn	 fn;
+	void		*udata;
+} IncludeDeclWalk;
+
+/* hand every declaration in `buf' to `fn', skipping block comments */
+static void
+include_decl_each(const char *path, const char *buf, IncludeDeclFn fn,
+    void *udata)
+{
+	const char	*line, *end, *c;
+	char		 id[64];
+	int		 lineno = 0, comment = 0, kind, is_public;
+
+	for (line = buf; *line != '\0'; line = end) {
+		end = strchr(line, '\n');
+		end = (end != NULL) ? end + 1 : line + strlen(line);
+		++lineno;
+		if (comment) {
+			c = strstr(line, "*/");
+			if (c == NULL || c >= end)
+				continue;
+			comment = 0;
+			continue;
+		}
+		c = line;
+		while (*c == ' ' || *c == '\t')
+			++c;
+		if (c[0] == '/' && c[1] == '*') {
+			c = strstr(c + 2, "*/");
+			if (c == NULL || c >= end)
+				comment = 1;
+			continue;
+		}
+		kind = include_decl_parse(line, id, sizeof(id), &is_public);
+		if (kind != 0)
+			fn(udata, path, lineno, id, kind);
+	}
+}
+
+static void
+include_decl_visit(IncludeScan *sc, const char *path, const char *buf)
+{
+	IncludeDeclWalk	*w = sc->udata;
+
+	w->fn(w->udata, path, 0, NULL, 0);
+	include_decl_each(path, buf, w->fn, w->udata);
+}
+
+/*
+ * dog_include_declarations
+ * Report every file reachable from `input_path' through #include, with
+ * the functions, natives and #defines declared in each.
+ */
+int
+dog_include_declarations(const char *pawncc_path, const char *input_path,
+    const char *flags, IncludeDeclFn fn, void *udata)
+{
+	IncludeScan	*sc;
+	IncludeDeclWalk	 w;
+
+	w.fn = fn;
+	w.udata = udata;
+	sc = include_scan_graph(pawncc_path, input_path, flags,
+	    include_decl_visit, &w);
+	if (sc == NULL)
+		return (-1);
+	include_scan_free(sc);
+	return (0);
+}
+
+/*
+ * Symbol index for "undefined symbol" hints.  The headers under the
+ * compiler include directories and the configured -i paths are scanned
+ * for declarations once, and the result is kept in INCLUDE_SYMBOL_INDEX
+ * as a hash table that is used straight from the file.  The index
+ * carries the size and mtime of every directory and header it read and
+ * is rebuilt as soon as any of them changes.
+ */
+
+#define INCLUDE_SYM_MAGIC	"WDS1"
+
+typedef struct {
+	char		 magic[4];
+	uint32_t	 nbuckets;
+	uint32_t	 nsyms;
+	uint32_t	 nstamps;
+	uint32_t	 strsize;
+	uint32_t	 roots;		/* search roots, one string */
+} IncludeSymHeader;
+
+typedef struct {
+	uint32_t	 path;
+	uint32_t	 is_dir;
+	int64_t		 size;
+	int64_t		 mtime;
+} IncludeSymStamp;
+
+typedef struct {
+	uint32_t	 name;
+	uint32_t	 header;	/* as written in #include <...> */
+	uint32_t	 file;
+	uint32_t	 line;
+	uint32_t	 next;		/* 1-based, 0 ends the chain */
+} IncludeSymEntry;
+
+/* on disk: header, stamps, buckets, entries, strings */
+typedef struct {
+	IncludeSymHeader hdr;
+	IncludeSymStamp	*stamps;
+	uint32_t	*buckets;
+	IncludeSymEntry	*syms;
+	char		*strs;
+	char		*blob;		/* loaded file, owns the arrays */
+	size_t		 cap_stamps;
+	size_t		 cap_syms;
+	size_t		 cap_strs;
+	uint32_t	 cur_header;
+	uint32_t	 cur_file;
+	int		 failed;
+} IncludeSymIndex;
+
+static IncludeSymIndex *include_sym_cache;
+
+static uint32_t
+include_sym_str(IncludeSymIndex *ix, const char *s)
+{
+	size_t		 len = strlen(s) + 1, cap;
+	uint32_t	 off;
+	char		*p;
+
+	if (ix->hdr.strsize + len > ix->cap_strs) {
+		cap = ix->cap_strs ? ix->cap_strs * 2 : 65536;
+		while (cap < ix->hdr.strsize + len)
+			cap *= 2;
+		p = dog_realloc(ix->strs, cap);
+		if (p == NULL) {
+			ix->failed = 1;
+			return (0);
+		}
+		ix->strs = p;
+		ix->cap_strs = cap;
+	}
+	off = ix->hdr.strsize;
+	memcpy(ix->strs + off, s, len);
+	ix->hdr.strsize += (uint32_t)len;
+	return (off);
+}
+
+static void
+include_sym_stamp(IncludeSymIndex *ix, const char *path,
+    const struct stat *st, int is_dir)
+{
+	IncludeSymStamp	*s;
+	size_t		 cap;
+
+	if (ix->hdr.nstamps == ix->cap_stamps) {
+		cap = ix->cap_stamps ? ix->cap_stamps * 2 : 256;
+		s = dog_realloc(ix->stamps, cap * sizeof(*s));
+		if (s == NULL) {
+			ix->failed = 1;
+			return;
+		}
+		ix->stamps = s;
+		ix->cap_stamps = cap;
+	}
+	s = &ix->stamps[ix->hdr.nstamps++];
+	s->path = include_sym_str(ix, path);
+	s->is_dir = (uint32_t)is_dir;
+	s->size = is_dir ? 0 : (int64_t)st->st_size;
+	s->mtime = include_mtime(st);
+}
+
+static void
+include_sym_add(void *udata, const char *file, int line, const char *name,
+    int kind)
+{
+	IncludeSymIndex	*ix = udata;
+	IncludeSymEntry	*e;
+	size_t		 cap;
+
+	(void)file;
+	(void)kind;
+	if (name == NULL)
+		return;
+	if (ix->hdr.nsyms == ix->cap_syms) {
+		cap = ix->cap_syms ? ix->cap_syms * 2 : 4096;
+		e = dog_realloc(ix->syms, cap * sizeof(*e));
+		if (e == NULL) {
+			ix->failed = 1;
+			return;
+		}
+		ix->syms = e;
+		ix->cap_syms = cap;
+	}
+	e = &ix->syms[ix->hdr.nsyms++];
+	e->name = include_sym_str(ix, name);
+	e->header = ix->cur_header;
+	e->file = ix->cur_file;
+	e->line = (uint32_t)line;
+	e->next = 0;
+}
+
+static void
+include_sym_walk(IncludeSymIndex *ix, const char *path, const char *rel,
+    int depth)
+{
+	DIR		*dirp;
+	struct dirent	*dent;
+	struct stat	 st;
+	char		 full[DOG_MAX_PATH], sub[DOG_MAX_PATH];
+	const char	*dot;
+	char		*buf;
+	size_t		 i, nexts;
+
+	if (stat(path, &st) != 0 || (dirp = opendir(path)) == NULL)
+		return;
+	include_sym_stamp(ix, path, &st, 1);
+	nexts = sizeof(include_exts) / sizeof(include_exts[0]);
+	while ((dent = readdir(dirp)) != NULL && !ix->failed) {
+		if (dog_dot_or_dotdot(dent->d_name))
+			continue;
+		snprintf(full, sizeof(full), "%s" "%s" "%s",
+		    path, _PATH_STR_SEP_POSIX, dent->d_name);
+		if (rel[0] != '\0')
+			snprintf(sub, sizeof(sub), "%s/%s", rel, dent->d_name);
+		else
+			snprintf(sub, sizeof(sub), "%s", dent->d_name);
+		if (stat(full, &st) != 0)
+			continue;
+		if (S_ISDIR(st.st_mode)) {
+			if (depth < INCLUDE_MAX_DEPTH)
+				include_sym_walk(ix, full, sub, depth + 1);
+			continue;
+		}
+		dot = strrchr(sub, '.');
+		if (dot == NULL || strchr(dot, '/') != NULL)
+			continue;
+		for (i = 1; i < nexts; i++)
+			if (strcmp(dot, include_exts[i]) == 0)
+				break;
+		if (i == nexts)
+			continue;
+
+		include_sym_stamp(ix, full, &st, 0);
+		buf = include_read_file(full, NULL);
+		if (buf == NULL)
+			continue;
+		sub[dot - sub] = '\0';
+		ix->cur_header = include_sym_str(ix, sub);
+		ix->cur_file = include_sym_str(ix, full);
+		include_decl_each(full, buf, include_sym_add, ix);
+		dog_free(buf);
+	}
+	closedir(dirp);
+}
+
+static void
+include_sym_free(IncludeSymIndex *ix)
+{
+	if (ix == NULL)
+		return;
+	if (ix->blob == NULL) {
+		dog_free(ix->stamps);
+		dog_free(ix->buckets);
+		dog_free(ix->syms);
+		dog_free(ix->strs);
+	}
+	dog_free(ix->blob);
+	dog_free(ix);
+}
+
+/* roots in search order: compiler include directories, then -i paths */
+static char *
+include_sym_roots(const char *flags)
+{
+	IncludeScan	*sc;
+	struct stat	 st;
+	char		*roots;
+	size_t		 len = 1;
+	int		 i, j;
+
+	sc = dog_calloc(1, sizeof(*sc));
+	if (sc == NULL)
+		return (NULL);
+	if (stat("pawno/include", &st) == 0 && S_ISDIR(st.st_mode))
+		include_parse_flags(sc, "-ipawno/include", 1);
+	if (stat("qawno/include", &st) == 0 && S_ISDIR(st.st_mode))
+		include_parse_flags(sc, "-iqawno/include", 1);
+	include_parse_flags(sc, flags, 1);
+	for (i = 0; i < sc->ndirs; i++)
+		len += strlen(sc->dirs[i].path) + 1;
+	roots = dog_malloc(len);
+	if (roots != NULL) {
+		roots[0] = '\0';
+		for (i = 0; i < sc->ndirs; i++) {
+			for (j = 0; j < i; j++)
+				if (strcmp(sc->dirs[j].path,
+				    sc->dirs[i].path) == 0)
+					break;
+			if (j < i)
+				continue;
+			strcat(roots, sc->dirs[i].path);
+			strcat(roots, "\n");
+		}
+	}
+	include_scan_free(sc);
+	return (roots);
+}
+
+static int
+include_sym_write(IncludeSymIndex *ix)
+{
+	FILE		*fp;
+	int		 ok;
+
+	MKDIR(".watchdogs");
+	fp = fopen(INCLUDE_SYMBOL_INDEX ".tmp", "wb");
+	if (fp == NULL)
+		return (-1);
+	ok = fwrite(&ix->hdr, sizeof(ix->hdr), 1, fp) == 1;
+	if (ix->hdr.nstamps > 0)
+		ok = ok && fwrite(ix->stamps, sizeof(*ix->stamps),
+		    ix->hdr.nstamps, fp) == ix->hdr.nstamps;
+	ok = ok && fwrite(ix->buckets, sizeof(*ix->buckets),
+	    ix->hdr.nbuckets, fp) == ix->hdr.nbuckets;
+	if (ix->hdr.nsyms > 0)
+		ok = ok && fwrite(ix->syms, sizeof(*ix->syms),
+		    ix->hdr.nsyms, fp) == ix->hdr.nsyms;
+	ok = ok && fwrite(ix->strs, 1, ix->hdr.strsize, fp) ==
+	    ix->hdr.strsize;
+	if (fclose(fp) != 0 || !ok ||
+	    rename(INCLUDE_SYMBOL_INDEX ".tmp", INCLUDE_SYMBOL_INDEX) != 0) {
+		remove(INCLUDE_SYMBOL_INDEX ".tmp");
+		return (-1);
+	}
+	return (0);
+}
+
+static IncludeSymIndex *
+include_sym_build(const char *roots)
+{
+	IncludeSymIndex	*ix;
+	const char	*p, *nl;
+	char		 root[DOG_MAX_PATH];
+	uint32_t	 i, b;
+
+	ix = dog_calloc(1, sizeof(*ix));
+	if (ix == NULL)
+		return (NULL);
+	memcpy(ix->hdr.magic, INCLUDE_SYM_MAGIC, 4);
+	include_sym_str(ix, "");
+	ix->hdr.roots = include_sym_str(ix, roots);
+	for (p = roots; *p != '\0' && !ix->failed; p = nl + 1) {
+		nl = strchr(p, '\n');
+		snprintf(root, sizeof(root), "%.*s", (int)(nl - p), p);
+		include_sym_walk(ix, root, "", 1);
+	}
+
+	for (ix->hdr.nbuckets = 256; ix->hdr.nbuckets < ix->hdr.nsyms * 2;
+	    ix->hdr.nbuckets *= 2)
+		;
+	ix->buckets = dog_calloc(ix->hdr.nbuckets, sizeof(*ix->buckets));
+	if (ix->failed || ix->buckets == NULL) {
+		include_sym_free(ix);
+		return (NULL);
+	}
+	/* chained backwards so the first root's declaration comes first */
+	for (i = ix->hdr.nsyms; i-- > 0; ) {
+		b = crypto_string_hash(ix->strs + ix->syms[i].name) &
+		    (ix->hdr.nbuckets - 1);
+		ix->syms[i].next = ix->buckets[b];
+		ix->buckets[b] = i + 1;
+	}
+	if (include_sym_write(ix) != 0)
+		pr_warning(stdout, "could not write %s", INCLUDE_SYMBOL_INDEX);
+	return (ix);
+}
+
+/* was `ix' built for `roots', and is every file and directory as then */
+static int
+include_sym_fresh(const IncludeSymIndex *ix, const char *roots)
+{
+	const IncludeSymStamp	*s;
+	struct stat		 st;
+	uint32_t		 i;
+
+	if (strcmp(ix->strs + ix->hdr.roots, roots) != 0)
+		return (0);
+	for (i = 0; i < ix->hdr.nstamps; i++) {
+		s = &ix->stamps[i];
+		if (s->path >= ix->hdr.strsize ||
+		    stat(ix->strs + s->path, &st) != 0 ||
+		    include_mtime(&st) != s->mtime ||
+		    (!s->is_dir && (int64_t)st.st_size != s->size))
+			return (0);
+	}
+	return (1);
+}
+
+static IncludeSymIndex *
+include_sym_load(const char *roots)
+{
+	IncludeSymIndex	*ix;
+	IncludeSymHeader hdr;
+	size_t		 need;
+	long		 size;
+	char		*blob, *p;
+
+	blob = include_read_file(INCLUDE_SYMBOL_INDEX, &size);
+	if (blob == NULL)
+		return (NULL);
+	if ((size_t)size < sizeof(hdr))
+		goto stale;
+	memcpy(&hdr, blob, sizeof(hdr));
+	need = sizeof(hdr) + (size_t)hdr.nstamps * sizeof(IncludeSymStamp) +
+	    (size_t)hdr.nbuckets * sizeof(uint32_t) +
+	    (size_t)hdr.nsyms * sizeof(IncludeSymEntry) + hdr.strsize;
+	if (memcmp(hdr.magic, INCLUDE_SYM_MAGIC, 4) != 0 ||
+	    (size_t)size != need || hdr.strsize == 0 ||
+	    hdr.roots >= hdr.strsize || hdr.nbuckets == 0 ||
+	    (hdr.nbuckets & (hdr.nbuckets - 1)) != 0)
+		goto stale;
+
+	ix = dog_calloc(1, sizeof(*ix));
+	if (ix == NULL)
+		goto stale;
+	ix->hdr = hdr;
+	ix->blob = blob;
+	p = blob + sizeof(hdr);
+	ix->stamps = (IncludeSymStamp *)p;
+	p += (size_t)hdr.nstamps * sizeof(IncludeSymStamp);
+	ix->buckets = (uint32_t *)p;
+	p += (size_t)hdr.nbuckets * sizeof(uint32_t);
+	ix->syms = (IncludeSymEntry *)p;
+	p += (size_t)hdr.nsyms * sizeof(IncludeSymEntry);
+	ix->strs = p;
+	ix->strs[hdr.strsize - 1] = '\0';
+
+	if (!include_sym_fresh(ix, roots)) {
+		include_sym_free(ix);
+		return (NULL);
+	}
+	return (ix);
+stale:
+	dog_free(blob);
+	return (NULL);
+}
+
+/*
+ * dog_include_suggest
+ * Look `symbol' up in the symbol index of the installed headers, built
+ * or refreshed as needed.  The index kept from an earlier lookup is
+ * checked against the include roots every time, so headers installed
+ * since, as by replicate in the same shell, are found.  On a hit the name to #include goes to
+ * `header' and "file:line" of the declaration to `where'.  Returns 1 on
+ * a hit, 0 on a miss and -1 when no index is available.
+ */
+int
+dog_include_suggest(const char *flags, const char *symbol, char *header,
+    size_t hsize, char *where, size_t wsize)
+{
+	IncludeSymEntry	*e;
+	char		*roots;
+	uint32_t	 i, nsyms, strsize, steps = 0;
+
+	roots = include_sym_roots(flags);
+	if (roots == NULL)
+		return (-1);
+	if (include_sym_cache != NULL &&
+	    !include_sym_fresh(include_sym_cache, roots)) {
+		include_sym_free(include_sym_cache);
+		include_sym_cache = NULL;
+	}
+	if (include_sym_cache == NULL) {
+		include_sym_cache = include_sym_load(roots);
+		if (include_sym_cache == NULL)
+			include_sym_cache = include_sym_build(roots);
+	}
+	dog_free(roots);
+	if (include_sym_cache == NULL)
+		return (-1);
+
+	nsyms = include_sym_cache->hdr.nsyms;
+	strsize = include_sym_cache->hdr.strsize;
+	i = include_sym_cache->buckets[crypto_string_hash(symbol) &
+	    (include_sym_cache->hdr.nbuckets - 1)];
+	while (i != 0 && i <= nsyms && steps++ < nsyms) {
+		e = &include_sym_cache->syms[i - 1];
+		if (e->name < strsize && e->header < strsize &&
+		    e->file < strsize &&
+		    strcmp(include_sym_cache->strs + e->name, symbol) == 0) {
+			snprintf(header, hsize, "%s",
+			    include_sym_cache->strs + e->header);
+			snprintf(where, wsize, "%s:%u",
+			    include_sym_cache->strs + e->file, e->line);
+			return (1);
+		}
+		i = e->next;
+	}
+	return (0);
+}
@@ -0,0 +1,35 @@
+/*-
+ * Copyright (c) 2026 Watchdogs Team and contributors
+ * All rights reserved. under The 2-Clause BSD License
+ * See COPYING or https://opensource.org/license/bsd-2-clause
+ */
+
+#ifndef INCLUDE_H
+#define INCLUDE_H
+
+#include "utils.h"
+
+#define INCLUDE_SYMBOL_INDEX ".watchdogs/symbols.idx"
+
+#define INCLUDE_DECL_FUNC    1
+#define INCLUDE_DECL_DEFINE  2
+
+/*
+ * Called once per source file as it is entered (name == NULL, line 0)
+ * and once per declaration found in it.
+ */
+typedef void (*IncludeDeclFn)(void *udata, const char *file, int line,
+                              const char *name, int kind);
+
+char *dog_include_prune(const char *pawncc_path, const char *input_path,
+                        const char *includes, const char *pinned);
+int dog_include_declarations(const char *pawncc_path, const char *input_path,
+                             const char *flags, IncludeDeclFn fn, void *udata);
+int dog_include_preload(const char *pawncc_path, const char *input_path,
+                        const char *flags);
+int dog_include_analyze(const char *pawncc_path, const char *input_path,
+                        const char *flags);
+int dog_include_suggest(const char *flags, const char *symbol, char *header,
+                        size_t hsize, char *where, size_t wsize);
+
+#endif
@@ -0,0 +1,429 @@
+/*-
+ * Copyright (c) 2026 Watchdogs Team and contributors
+ * All rights reserved. under The 2-Clause BSD License
+ * See COPYING or https://opensource.org/license/bsd-2-clause
+ */
+
+#include  "utils.h"
+#include  "debug.h"
+#include  "crypto.h"
+#include  "pawnc.h"
+
+#ifdef DOG_LINUX
+#include  <dlfcn.h>
+#include  <sys/resource.h>
+#endif
+
+/*
+ * In-process pawncc.  The Linux pawncc executable is a thin wrapper
+ * around pc_compile() in libpawnc.so, so watchdogs can load the library
+ * once and fork a child per compile that inherits the already mapped
+ * and relocated image; what is saved is pawncc's exec and dynamic
+ * linking.  pc_compile() keeps its state in globals and is not
+ * reentrant, so a child runs one compile and exits -- nothing is kept
+ * warm between compiles but the parent's image and include cache.
+ * Without the library the children exec the argv instead.
+ */
+
+typedef int (*pc_compile_fn)(int argc, char **argv);
+
+static void		*pawnc_handle = NULL;
+static pc_compile_fn	 pawnc_entry = NULL;
+
+#ifdef DOG_LINUX
+static int
+pawnc_try_open(const char *path)
+{
+	void		*h;
+	pc_compile_fn	 fn;
+
+	h = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+	if (h == NULL)
+		return (-1);
+	*(void **)(&fn) = dlsym(h, "pc_compile");
+	if (fn == NULL) {
+		dlclose(h);
+		return (-1);
+	}
+	pawnc_handle = h;
+	pawnc_entry = fn;
+#if defined(_DBG_PRINT)
+	pr_info(stdout, "libpawnc: loaded %s", path);
+#endif
+	return (0);
+}
+#endif
+
+/*
+ * dog_pawnc_load
+ * Load libpawnc.so once per session.  The directory of `pawncc_path'
+ * is tried first, then the library paths compiler_configure_libpath()
+ * exports, then the default loader search.
+ */
+int
+dog_pawnc_load(const char *pawncc_path)
+{
+#ifdef DOG_LINUX
+	static const char *paths[] = {
+		LINUX_LIB_PATH, LINUX_LIB32_PATH,
+		TMUX_LIB_PATH, TMUX_LIB_LOC_PATH,
+		TMUX_LIB_ARM64_PATH, TMUX_LIB_ARM32_PATH,
+		TMUX_LIB_AMD64_PATH, TMUX_LIB_AMD32_PATH
+	};
+	char		 so[DOG_PATH_MAX * 2];
+	const char	*slash;
+	size_t		 i;
+
+	if (pawnc_entry != NULL)
+		return (0);
+
+	if (pawncc_path != NULL &&
+	    (slash = strrchr(pawncc_path, _PATH_CHR_SEP_POSIX)) != NULL) {
+		snprintf(so, sizeof(so), "%.*s/libpawnc.so",
+		    (int)(slash - pawncc_path), pawncc_path);
+		if (path_exists(so) && pawnc_try_open(so) == 0)
+			return (0);
+	}
+
+	for (i = 0; i < sizeof(paths) / sizeof(paths[0]); i++) {
+		snprintf(so, sizeof(so), "%s/libpawnc.so", paths[i]);
+		if (path_exists(so) && pawnc_try_open(so) == 0)
+			return (0);
+	}
+
+	return (pawnc_try_open("libpawnc.so"));
+#else
+	(void)pawncc_path;
+	return (-1);
+#endif
+}
+
+int
+dog_pawnc_loaded(void)
+{
+	return (pawnc_entry != NULL);
+}
+
+#ifdef DOG_LINUX
+static void
+pawnc_child(PawncJob *job)
+{
+	int		 fd, argc, ret;
+
+	fd = open(job->log_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd != -1) {
+		dup2(fd, STDOUT_FILENO);
+		dup2(fd, STDERR_FILENO);
+		close(fd);
+	}
+
+	if (pawnc_entry == NULL) {
+		execv(job->argv[0], job->argv);
+		fprintf(stderr, "execv failed: %s\n", strerror(errno));
+		_exit(127);
+	}
+
+	for (argc = 0; job->argv[argc] != NULL; argc++)
+		;
+	ret = pawnc_entry(argc, job->argv);
+	fflush(stdout);
+	fflush(stderr);
+	_exit(ret & 0xff);
+}
+#endif
+
+/*
+ * dog_pawnc_run_jobs
+ * Run `njobs' compiles, each in a child forked for it, with at most
+ * `workers' of them in flight (0 = one per online CPU).  Each job's
+ * status, wall time and CPU time are filled in; returns the number of
+ * jobs that exited non-zero, or -1 when workers cannot be created on
+ * this platform.
+ */
+int
+dog_pawnc_run_jobs(PawncJob *jobs, int njobs, int workers)
+{
+#ifdef DOG_LINUX
+	struct timespec	*started;
+	pid_t		*pids;
+	int		 next = 0, running = 0, failed = 0, i;
+
+	if (njobs <= 0)
+		return (0);
+	if (workers <= 0) {
+		long	 ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+		workers = (ncpu > 0) ? (int)ncpu : 1;
+	}
+
+	pids = dog_calloc((size_t)njobs, sizeof(*pids));
+	started = dog_calloc((size_t)njobs, sizeof(*started));
+	if (pids == NULL || started == NULL) {
+		dog_free(pids);
+		dog_free(started);
+		return (-1);
+	}
+
+	fflush(stdout);
+	fflush(stderr);
+
+	while (next < njobs || running > 0) {
+		int		 status;
+		pid_t		 pid;
+		struct timespec	 now;
+		struct rusage	 ru;
+
+		while (next < njobs && running < workers) {
+			jobs[next].status = -1;
+			clock_gettime(CLOCK_MONOTONIC, &started[next]);
+			pid = fork();
+			if (pid == 0)
+				pawnc_child(&jobs[next]);
+			if (pid < 0) {
+				pr_error(stdout, "libpawnc: fork failed: %s",
+				    strerror(errno));
+				++failed;
+			} else {
+				pids[next] = pid;
+				++running;
+			}
+			++next;
+		}
+		if (running == 0)
+			break;
+
+		pid = wait4(-1, &status, 0, &ru);
+		if (pid < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		for (i = 0; i < njobs; i++) {
+			if (pids[i] != pid)
+				continue;
+			pids[i] = 0;
+			--running;
+			jobs[i].seconds = (double)(now.tv_sec - started[i].tv_sec) +
+			    (double)(now.tv_nsec - started[i].tv_nsec) / 1e9;
+			jobs[i].cpu = (double)(ru.ru_utime.tv_sec +
+			    ru.ru_stime.tv_sec) + (double)(ru.ru_utime.tv_usec +
+			    ru.ru_stime.tv_usec) / 1e6;
+			if (WIFEXITED(status))
+				jobs[i].status = WEXITSTATUS(status);
+			else
+				jobs[i].status = 128 + WTERMSIG(status);
+			if (jobs[i].status != 0)
+				++failed;
+			break;
+		}
+	}
+
+	dog_free(pids);
+	dog_free(started);
+	return (failed);
+#else
+	(void)jobs;
+	(void)njobs;
+	(void)workers;
+	return (-1);
+#endif
+}
+
+/*
+ * dog_pawnc_compile
+ * Single compile through the loaded library.  Returns the compiler's
+ * exit status, or -1 when libpawnc.so is not loaded so the caller can
+ * fall back to spawning pawncc.
+ */
+int
+dog_pawnc_compile(char **argv, const char *log_path)
+{
+	PawncJob	 job;
+
+	if (pawnc_entry == NULL)
+		return (-1);
+
+	memset(&job, 0, sizeof(job));
+	job.argv = argv;
+	job.log_path = log_path;
+	if (dog_pawnc_run_jobs(&job, 1, 1) < 0)
+		return (-1);
+	return (job.status);
+}
+
+/*
+ * Include VFS.  libpawnc opens every source and include through
+ * pc_opensrc(); the executable exports its own definition, which the
+ * dynamic linker prefers over the library's, and serves file contents
+ * from a session cache as fmemopen() streams.  The library's own
+ * pc_readsrc/pc_getpossrc/pc_resetsrc/pc_closesrc keep working since
+ * the handle is still a FILE *.  Entries are checked against the
+ * file's mtime and size on every open, so edits are picked up.
+ */
+
+#define PAWNC_VFS_BUCKETS	4096
+#define PAWNC_VFS_MAX_BYTES	(256L * 1024 * 1024)
+
+typedef struct pawnc_vfs_entry {
+	struct pawnc_vfs_entry	*next;
+	char			*path;
+	char			*data;
+	size_t			 size;
+	time_t			 mtime;
+	long			 mtime_nsec;
+} PawncVfsEntry;
+
+static PawncVfsEntry	*pawnc_vfs[PAWNC_VFS_BUCKETS];
+static long		 pawnc_vfs_bytes = 0;
+
+#ifdef DOG_LINUX
+static long
+pawnc_st_nsec(const struct stat *st)
+{
+#if defined(__APPLE__)
+	return (st->st_mtimespec.tv_nsec);
+#else
+	return (st->st_mtim.tv_nsec);
+#endif
+}
+
+static PawncVfsEntry *
+pawnc_vfs_get(const char *path, const struct stat *st)
+{
+	PawncVfsEntry	*e;
+	uint32_t	 b;
+	FILE		*fp;
+	char		*data;
+
+	b = crypto_string_hash(path) % PAWNC_VFS_BUCKETS;
+	for (e = pawnc_vfs[b]; e != NULL; e = e->next)
+		if (strcmp(e->path, path) == 0)
+			break;
+
+	if (e != NULL && e->mtime == st->st_mtime &&
+	    e->mtime_nsec == pawnc_st_nsec(st) &&
+	    e->size == (size_t)st->st_size)
+		return (e);
+
+	if (st->st_size <= 0 ||
+	    pawnc_vfs_bytes + st->st_size > PAWNC_VFS_MAX_BYTES)
+		return (NULL);
+
+	fp = fopen(path, "rb");
+	if (fp == NULL)
+		return (NULL);
+	data = dog_malloc((size_t)st->st_size);
+	if (data == NULL ||
+	    fread(data, 1, (size_t)st->st_size, fp) != (size_t)st->st_size) {
+		dog_free(data);
+		fclose(fp);
+		return (NULL);
+	}
+	fclose(fp);
+
+	if (e == NULL) {
+		e = dog_calloc(1, sizeof(*e));
+		if (e == NULL) {
+			dog_free(data);
+			return (NULL);
+		}
+		e->path = strdup(path);
+		e->next = pawnc_vfs[b];
+		pawnc_vfs[b] = e;
+	} else {
+		pawnc_vfs_bytes -= (long)e->size;
+		dog_free(e->data);
+	}
+	e->data = data;
+	e->size = (size_t)st->st_size;
+	e->mtime = st->st_mtime;
+	e->mtime_nsec = pawnc_st_nsec(st);
+	pawnc_vfs_bytes += (long)e->size;
+	return (e);
+}
+
+void *
+pc_opensrc(char *filename)
+{
+	struct stat	 st;
+	PawncVfsEntry	*e;
+	FILE		*fp;
+
+	/* opening a directory succeeds on Linux but must fail here */
+	if (stat(filename, &st) != 0)
+		return (NULL);
+	if (S_ISDIR(st.st_mode)) {
+		errno = EISDIR;
+		return (NULL);
+	}
+
+	e = pawnc_vfs_get(filename, &st);
+	if (e != NULL) {
+		fp = fmemopen(e->data, e->size, "r");
+		if (fp != NULL)
+			return (fp);
+	}
+	return (fopen(filename, "r"));
+}
+
+#endif
+
+/*
+ * dog_pawnc_vfs_add
+ * Put `size' bytes of `path', as read by the caller, into the include
+ * cache of the parent so that forked compiles share them instead of
+ * each reading the file again.  Returns 0 when the file is cached.
+ */
+int
+dog_pawnc_vfs_add(const char *path, const char *data, size_t size)
+{
+#ifdef DOG_LINUX
+	PawncVfsEntry	*e;
+	struct stat	 st;
+	uint32_t	 b;
+	char		*copy;
+
+	if (stat(path, &st) != 0 || !S_ISREG(st.st_mode) ||
+	    (size_t)st.st_size != size || size == 0)
+		return (-1);
+
+	b = crypto_string_hash(path) % PAWNC_VFS_BUCKETS;
+	for (e = pawnc_vfs[b]; e != NULL; e = e->next)
+		if (strcmp(e->path, path) == 0)
+			break;
+	if (e != NULL && e->mtime == st.st_mtime &&
+	    e->mtime_nsec == pawnc_st_nsec(&st) && e->size == size)
+		return (0);
+	if (pawnc_vfs_bytes + (long)size > PAWNC_VFS_MAX_BYTES)
+		return (-1);
+
+	copy = dog_malloc(size);
+	if (copy == NULL)
+		return (-1);
+	memcpy(copy, data, size);
+	if (e == NULL) {
+		e = dog_calloc(1, sizeof(*e));
+		if (e == NULL || (e->path = strdup(path)) == NULL) {
+			dog_free(e);
+			dog_free(copy);
+			return (-1);
+		}
+		e->next = pawnc_vfs[b];
+		pawnc_vfs[b] = e;
+	} else {
+		pawnc_vfs_bytes -= (long)e->size;
+		dog_free(e->data);
+	}
+	e->data = copy;
+	e->size = size;
+	e->mtime = st.st_mtime;
+	e->mtime_nsec = pawnc_st_nsec(&st);
+	pawnc_vfs_bytes += (long)size;
+	return (0);
+#else
+	(void)path;
+	(void)data;
+	(void)size;
+	return (-1);
+#endif
+}
@@ -0,0 +1,30 @@
+/*-
+ * Copyright (c) 2026 Watchdogs Team and contributors
+ * All rights reserved. under The 2-Clause BSD License
+ * See COPYING or https://opensource.org/license/bsd-2-clause
+ */
+
+#ifndef PAWNC_H
+#define PAWNC_H
+
+#include "utils.h"
+
+typedef struct {
+    char      **argv;        /* pawncc style argv, argv[0] is the compiler */
+    const char *log_path;    /* stdout/stderr of the compile */
+    int         status;      /* exit status, -1 if it never ran */
+    double      seconds;     /* wall time of this job */
+    double      cpu;         /* user + system CPU time of this job */
+} PawncJob;
+
+int dog_pawnc_load(const char *pawncc_path);
+int dog_pawnc_loaded(void);
+int dog_pawnc_run_jobs(PawncJob *jobs, int njobs, int workers);
+int dog_pawnc_compile(char **argv, const char *log_path);
+
+int dog_pawnc_vfs_add(const char *path, const char *data, size_t size);
+
+/* libpawnc source hook, interposed over the library's own */
+void *pc_opensrc(char *filename);
+
+#endif
@@ -8,14 +8,15 @@
 #include  "curl.h"
 #include  "archive.h"
 #include  "crypto.h"
+#include  "cache.h"
 #include  "units.h"
 #include  "debug.h"
 #include  "replicate.h"
 
 bool             installing_package = 0;
+bool             package_lock_update = 0;
 static const char*opr = NULL;
 static char		 json_item[DOG_PATH_MAX];
-static char      command[DOG_MAX_PATH * 4];
 static int		 fdir_counts = 0;
 #ifdef DOG_WINDOWS
 static const char *separator = _PATH_STR_SEP_WIN32;
@@ -232,11 +233,29 @@ package_fetching_assets(char **package_assets, int counts, const char *pf_os)
 	return (try_generic_assets(package_assets, counts));
 }
 
+/* the platform release assets are picked for, asked for once */
+static const char *
+package_target_os(void)
+{
+	if (opr == NULL) {
+		pr_info(stdout,
+			"Installing for?\n   Windows (A/a/Enter) : GNU/Linux : (B/b)");
+		char *selecting_os = readline(" > ");
+		if (selecting_os[0] == '\0' || selecting_os[0] == 'A' || selecting_os[0] == 'a') {
+			opr = "windows";
+		} else {
+			opr = "linux";
+		}
+		dog_free(selecting_os);
+	}
+	return (opr);
+}
+
 static
 int
 package_url_checking(const char *url, const char *github_token)
 {
-	CURL *curl = curl_easy_init();
+	CURL *curl = dog_curl_acquire();
 	if (!curl)
 		return (0);
 
@@ -268,17 +287,11 @@ package_url_checking(const char *url, const char *github_token)
 	curl_easy_setopt(curl, CURLOPT_NOBODY, 1L);
 	curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
 	curl_easy_setopt(curl, CURLOPT_TIMEOUT, 30L);
-
-	printf("   Try Connecting... ");
-	fflush(stdout);
-
-	res = curl_easy_perform(curl);
-	curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &response_code);
-
 	curl_easy_setopt(curl, CURLOPT_ERRORBUFFER, dog_buffer_error);
 
 	curl_verify_cacert_pem(curl);
 
+	printf("   Try Connecting... ");
 	fflush(stdout);
 
 	res = curl_easy_perform(curl);
@@ -300,7 +313,7 @@ package_url_checking(const char *url, const char *github_token)
 		}
 	}
 
-	curl_easy_cleanup(curl);
+	dog_curl_release(curl);
 	curl_slist_free_all(headers);
 
 	return (response_code >= 200 && response_code < 300);
@@ -311,14 +324,8 @@ int
 package_http_get_content(const char *url, const char *github_token,
     char **out_html)
 {
-	CURL *curl;
-	CURLcode res;
 	struct curl_slist *headers = NULL;
-	struct memory_struct buffer = { 0 };
-
-	curl = curl_easy_init();
-	if (!curl)
-		return (0);
+	int ret;
 
 	if (github_token && strlen(github_token) > 0 &&
 	    !strfind(github_token, "DO_HERE", true)) {
@@ -329,31 +336,83 @@ package_http_get_content(const char *url, const char *github_token,
 	}
 
 	headers = curl_slist_append(headers, "User-Agent: watchdogs/1.0");
-	curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
 
-	curl_easy_setopt(curl, CURLOPT_URL, url);
+	ret = dog_http_get_cached(url, headers, out_html);
+	curl_slist_free_all(headers);
+
+	return (ret);
+}
+
+#define PACKAGE_GH_GRAPHQL	"https://api.github.com/graphql"
+
+/*
+ * POST `query' to the GitHub GraphQL API; `*out' is the response, to be
+ * freed by the caller.  WATCHDOGS_GITHUB_GRAPHQL overrides the endpoint,
+ * so a recorded response (file://...) can stand in for GitHub.
+ */
+static int
+package_gh_graphql(const char *query, char **out)
+{
+	struct memory_struct	 buffer = { 0 };
+	struct curl_slist	*headers = NULL;
+	const char		*endpoint;
+	char			 auth_header[512];
+	char			*body;
+	cJSON			*request;
+	CURL			*curl;
+	CURLcode		 res;
+	long			 code = 0;
+
+	*out = NULL;
+	request = cJSON_CreateObject();
+	if (request == NULL)
+		return (0);
+	cJSON_AddStringToObject(request, "query", query);
+	body = cJSON_PrintUnformatted(request);
+	cJSON_Delete(request);
+	if (body == NULL)
+		return (0);
+
+	curl = dog_curl_acquire();
+	if (curl == NULL) {
+		cJSON_free(body);
+		return (0);
+	}
+
+	endpoint = getenv("WATCHDOGS_GITHUB_GRAPHQL");
+	if (endpoint == NULL || *endpoint == '\0')
+		endpoint = PACKAGE_GH_GRAPHQL;
+
+	snprintf(auth_header, sizeof(auth_header), "Authorization: bearer %s",
+	    dogconfig.dog_toml_github_tokens);
+	headers = curl_slist_append(headers, auth_header);
+	headers = curl_slist_append(headers, "User-Agent: watchdogs/1.0");
+	headers = curl_slist_append(headers, "Content-Type: application/json");
 
 	memory_struct_init(&buffer);
+	curl_easy_setopt(curl, CURLOPT_URL, endpoint);
+	curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+	curl_easy_setopt(curl, CURLOPT_POSTFIELDS, body);
 	curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_memory_callback);
 	curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *)&buffer);
-
 	curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
 	curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, 15L);
 	curl_easy_setopt(curl, CURLOPT_TIMEOUT, 60L);
-
 	curl_verify_cacert_pem(curl);
 
 	res = curl_easy_perform(curl);
-	curl_easy_cleanup(curl);
+	curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &code);
+	dog_curl_release(curl);
 	curl_slist_free_all(headers);
+	cJSON_free(body);
 
-	if (res != CURLE_OK || buffer.size == 0) {
+	/* a file:// stand-in has no status code */
+	if (res != CURLE_OK || (code != DOG_CURL_RESPONSE_OK && code != 0) ||
+	    buffer.size == 0) {
 		memory_struct_free(&buffer);
 		return (0);
 	}
-
-	*out_html = buffer.memory;
-
+	*out = buffer.memory;
 	return (1);
 }
 
@@ -444,6 +503,63 @@ package_parse_repo(const char *input, struct _repositories *ctx)
 	return (0);
 }
 
+#define PACKAGE_MAX_ASSETS	10
+
+/*
+ * Releases answered by one GraphQL query for the whole dependency set
+ * (see package_gh_prefetch).  package_gh_latest_tag and
+ * package_gh_release_assets look here before asking the REST API.
+ * `found' is 1 for a release, 0 when GitHub has no such release and -1
+ * while the query has not answered.
+ */
+typedef struct {
+	char	 user[user_size];
+	char	 repo[repo_size];
+	char	 tag[tag_size];		/* as asked, "" for the latest */
+	char	 name[tag_size];	/* tag name of the release */
+	char	*asset[PACKAGE_MAX_ASSETS];
+	int	 nasset;
+	int	 found;
+} PackageGhRelease;
+
+static struct {
+	PackageGhRelease	*entry;
+	int			 count;
+} package_gh_batch;
+
+/* the answered release of user/repo at `tag', NULL for the latest one */
+static const PackageGhRelease *
+package_gh_cached(const char *user, const char *repo, const char *tag)
+{
+	const PackageGhRelease	*r;
+	int			 i;
+
+	for (i = 0; i < package_gh_batch.count; i++) {
+		r = &package_gh_batch.entry[i];
+		if (r->found < 0 || strcasecmp(r->user, user) != 0 ||
+		    strcasecmp(r->repo, repo) != 0)
+			continue;
+		if (tag == NULL ? r->tag[0] == '\0' :
+		    (strcmp(r->tag, tag) == 0 ||
+		    (r->found && strcmp(r->name, tag) == 0)))
+			return (r);
+	}
+	return (NULL);
+}
+
+static void
+package_gh_batch_free(void)
+{
+	int	 i, j;
+
+	for (i = 0; i < package_gh_batch.count; i++)
+		for (j = 0; j < package_gh_batch.entry[i].nasset; j++)
+			dog_free(package_gh_batch.entry[i].asset[j]);
+	dog_free(package_gh_batch.entry);
+	package_gh_batch.entry = NULL;
+	package_gh_batch.count = 0;
+}
+
 static int
 package_gh_release_assets(const char *user, const char *repo, char *_tag,
     char **out_urls, int max_urls)
@@ -451,8 +567,18 @@ package_gh_release_assets(const char *user, const char *repo, char *_tag,
 	char		 api_url[DOG_PATH_MAX * 2];
 	char		*json_data = NULL;
 	const char	*p;
+	const PackageGhRelease	*r;
 	int		 url_count = 0;
 
+	if ((r = package_gh_cached(user, repo, _tag)) != NULL) {
+		for (; url_count < r->nasset && url_count < max_urls;
+		    ++url_count)
+			if ((out_urls[url_count] =
+			    strdup(r->asset[url_count])) == NULL)
+				break;
+		return (url_count);
+	}
+
 	snprintf(api_url, sizeof(api_url),
 	    "%sapi.github.com/repos/%s/%s/releases/tags/%s",
 	    "https://", user, repo, _tag);
@@ -558,8 +684,16 @@ package_gh_latest_tag(const char *_user, const char *_repo, char *out_tag,
 	char		 api_url[DOG_PATH_MAX * 2];
 	char		*json_data = NULL;
 	const char	*p;
+	const PackageGhRelease	*r;
 	int		 ret = 0;
 
+	if ((r = package_gh_cached(_user, _repo, NULL)) != NULL) {
+		if (!r->found || strlen(r->name) >= put_size)
+			return (0);
+		snprintf(out_tag, put_size, "%s", r->name);
+		return (1);
+	}
+
 	snprintf(api_url, sizeof(api_url),
 	    "%sapi.github.com/repos/%s/%s/releases/latest",
 	    "https://", _user, _repo);
@@ -625,7 +759,7 @@ parsing_generic_repo(const struct _repositories *repo, char *put_url,
 
 static int
 package_handle_repo(const struct _repositories *kevlar_repos, char *put_url,
-    size_t put_size, const char *branch)
+    size_t put_size, const char *branch, char *put_tag, size_t put_tag_size)
 {
 	const char	*package_repo_branch[] = { branch, "main", "master" };
 	char		 tag_access[128];
@@ -633,6 +767,7 @@ package_handle_repo(const struct _repositories *kevlar_repos, char *put_url,
 	char		*package_best_asset;
 	int		 ret = 0, j, asset_counts, use_fallback_branch = 0;
 
+	put_tag[0] = '\0';
 	if (strcmp(kevlar_repos->host, "github") != 0)
 		return (parsing_generic_repo(kevlar_repos, put_url,
 		    put_size, branch));
@@ -681,6 +816,7 @@ package_handle_repo(const struct _repositories *kevlar_repos, char *put_url,
 		return (ret);
 	}
 
+	snprintf(put_tag, put_tag_size, "%s", tag_access);
 	pr_info(stdout, "Fetching any archive from %s..", tag_access);
 
 	if (tag_access[0]) {
@@ -690,20 +826,8 @@ package_handle_repo(const struct _repositories *kevlar_repos, char *put_url,
 
 		if (asset_counts > 0) {
 			
-			if (opr == NULL) {
-				pr_info(stdout,
-					"Installing for?\n   Windows (A/a/Enter) : GNU/Linux : (B/b)");
-				char *selecting_os = readline(" > ");
-				if (selecting_os[0] == '\0' || selecting_os[0] == 'A' || selecting_os[0] == 'a') {
-					opr = "windows";
-				} else {
-					opr = "linux";
-				}
-				dog_free(selecting_os);
-			}
-
 			package_best_asset = package_fetching_assets(
-			    package_assets, asset_counts, opr);
+			    package_assets, asset_counts, package_target_os());
 
 			if (package_best_asset) {
 				strncpy(put_url, package_best_asset,
@@ -772,6 +896,219 @@ package_handle_repo(const struct _repositories *kevlar_repos, char *put_url,
 	return (ret);
 }
 
+/*
+ * Package sources, tried in the order of `sources' in [dependencies]:
+ *
+ *   "github"                  resolve upstream, as without a list
+ *   "/srv/mirror"             a directory registry
+ *   "file:///srv/mirror"      the same, as an URL
+ *   "http://mirror.lan/pkgs"  an HTTP registry
+ *
+ * A registry keeps the archives of a release in <user>/<repo>/<tag>/;
+ * "latest" stands in for a spec without a tag or with ?newer.  Over
+ * HTTP that directory has an `index' listing one archive per line, by
+ * file name or full URL.  A registry hit asks no GitHub API at all.
+ */
+
+#define PACKAGE_MAX_SOURCES	16
+
+typedef struct {
+	char	*source[PACKAGE_MAX_SOURCES];
+	int	 count;
+} PackageSources;
+
+static void
+package_sources_load(PackageSources *sources)
+{
+	char		 errbuf[DOG_PATH_MAX];
+	toml_table_t	*root, *depends;
+	toml_array_t	*list;
+	toml_datum_t	 val;
+	FILE		*fp;
+	int		 i, n;
+
+	memset(sources, 0, sizeof(*sources));
+	fp = fopen("watchdogs.toml", "r");
+	if (fp != NULL) {
+		root = toml_parse_file(fp, errbuf, sizeof(errbuf));
+		fclose(fp);
+		depends = root ? toml_table_in(root, TOML_TABLE_DEPENDENCIES) :
+		    NULL;
+		list = depends ? toml_array_in(depends, "sources") : NULL;
+		n = list ? toml_array_nelem(list) : 0;
+		for (i = 0; i < n && sources->count < PACKAGE_MAX_SOURCES;
+		    i++) {
+			val = toml_string_at(list, i);
+			if (!val.ok)
+				continue;
+			if (val.u.s[0] != '\0')
+				sources->source[sources->count++] = val.u.s;
+			else
+				dog_free(val.u.s);
+		}
+		if (root != NULL)
+			toml_free(root);
+	}
+	if (sources->count == 0)
+		sources->source[sources->count++] = strdup("github");
+}
+
+static void
+package_sources_free(PackageSources *sources)
+{
+	int	 i;
+
+	for (i = 0; i < sources->count; i++)
+		dog_free(sources->source[i]);
+	sources->count = 0;
+}
+
+/* pick among the archives of a registry release; 1 when one was found */
+static int
+package_registry_pick(char **names, int count, const char *prefix,
+    char *put_url, size_t put_size)
+{
+	char	*best;
+
+	if (count == 0)
+		return (0);
+	best = package_fetching_assets(names, count,
+	    count > 1 ? package_target_os() : NULL);
+	if (best == NULL)
+		return (0);
+	if (strstr(best, "://") != NULL)
+		snprintf(put_url, put_size, "%s", best);
+	else
+		snprintf(put_url, put_size, "%s/%s", prefix, best);
+	dog_free(best);
+	return (1);
+}
+
+static int
+package_registry_dir(const char *root, const char *release, char *put_url,
+    size_t put_size)
+{
+	char		 dir[DOG_PATH_MAX * 2], prefix[DOG_PATH_MAX * 2 + 8];
+	char		*names[PACKAGE_MAX_ASSETS];
+	DIR		*dirp;
+	struct dirent	*dent;
+	int		 i, count = 0, ret;
+
+	if (root[0] == '/' || (root[0] != '\0' && root[1] == ':'))
+		snprintf(dir, sizeof(dir), "%s/%s", root, release);
+	else
+		snprintf(dir, sizeof(dir), "%s/%s/%s", dog_procure_pwd(), root,
+		    release);
+	dirp = opendir(dir);
+	if (dirp == NULL)
+		return (0);
+	while ((dent = readdir(dirp)) != NULL && count < PACKAGE_MAX_ASSETS)
+		if (dent->d_name[0] != '.' && is_archive_file(dent->d_name))
+			names[count++] = strdup(dent->d_name);
+	closedir(dirp);
+
+	snprintf(prefix, sizeof(prefix), "file://%s%s",
+	    dir[0] == '/' ? "" : "/", dir);
+	ret = package_registry_pick(names, count, prefix, put_url, put_size);
+	for (i = 0; i < count; i++)
+		dog_free(names[i]);
+	return (ret);
+}
+
+static int
+package_registry_http(const char *base, const char *release, char *put_url,
+    size_t put_size)
+{
+	char		 prefix[DOG_PATH_MAX * 2], index[DOG_PATH_MAX * 2 + 8];
+	char		*names[PACKAGE_MAX_ASSETS];
+	char		*body = NULL, *line, *next, *end;
+	int		 i, count = 0, ret;
+
+	snprintf(prefix, sizeof(prefix), "%s/%s", base, release);
+	snprintf(index, sizeof(index), "%s/index", prefix);
+	if (!package_http_get_content(index, NULL, &body))
+		return (0);
+
+	for (line = body; line != NULL && count < PACKAGE_MAX_ASSETS;
+	    line = next) {
+		next = strchr(line, '\n');
+		if (next != NULL)
+			*next++ = '\0';
+		while (*line == ' ' || *line == '\t')
+			++line;
+		end = line + strlen(line);
+		while (end > line && (end[-1] == '\r' || end[-1] == ' ' ||
+		    end[-1] == '\t'))
+			*--end = '\0';
+		if (*line != '\0' && *line != '#' && is_archive_file(line))
+			names[count++] = strdup(line);
+	}
+	dog_free(body);
+
+	ret = package_registry_pick(names, count, prefix, put_url, put_size);
+	for (i = 0; i < count; i++)
+		dog_free(names[i]);
+	return (ret);
+}
+
+/* the usual resolution through GitHub, GitLab, Gitea or SourceForge */
+static int
+package_resolve_upstream(const struct _repositories *repo, const char *branch,
+    char *put_url, size_t put_size, char *put_tag, size_t put_tag_size)
+{
+	if (!strcmp(repo->host, "github"))
+		return (package_handle_repo(repo, put_url, put_size, branch,
+		    put_tag, put_tag_size));
+
+	package_build_repo_url(repo, 0, put_url, put_size);
+	if (!package_url_checking(put_url, dogconfig.dog_toml_github_tokens))
+		return (0);
+	snprintf(put_tag, put_tag_size, "%s", repo->tag);
+	return (1);
+}
+
+static int
+package_resolve(const PackageSources *sources, const struct _repositories *repo,
+    const char *branch, char *put_url, size_t put_size, char *put_tag,
+    size_t put_tag_size)
+{
+	const char	*source, *tag;
+	char		 release[DOG_PATH_MAX];
+	int		 i, found;
+
+	tag = (repo->tag[0] && strcmp(repo->tag, "newer") != 0) ?
+	    repo->tag : "latest";
+	snprintf(release, sizeof(release), "%s/%s/%s", repo->user, repo->repo,
+	    tag);
+
+	for (i = 0; i < sources->count; i++) {
+		source = sources->source[i];
+		if (strcmp(source, "github") == 0) {
+			if (package_resolve_upstream(repo, branch, put_url,
+			    put_size, put_tag, put_tag_size))
+				return (1);
+			continue;
+		}
+		if (strncmp(source, "http://", 7) == 0 ||
+		    strncmp(source, "https://", 8) == 0)
+			found = package_registry_http(source, release,
+			    put_url, put_size);
+		else if (strncmp(source, "file://", 7) == 0)
+			found = package_registry_dir(source + 7, release,
+			    put_url, put_size);
+		else
+			found = package_registry_dir(source, release,
+			    put_url, put_size);
+		if (found) {
+			snprintf(put_tag, put_tag_size, "%s", tag);
+			pr_info(stdout, "Found %s/%s in %s", repo->user,
+			    repo->repo, source);
+			return (1);
+		}
+	}
+	return (0);
+}
+
 static
 int
 package_try_parsing(const char *raw_file_path, const char *raw_json_path)
@@ -988,164 +1325,174 @@ package_implementation_omp_conf(const char *config_name,
 
 #define M_ADD_PLUGIN(x, y) package_implementation_omp_conf(x, y)
 
-static
-void
-package_add_include(const char *modes, char *package_name,
-    char *package_following)
+/*
+ * #include directives are written into the gamemode in one go: the file
+ * is read once, every directive it lacks goes in, and the result
+ * replaces it through a temporary file.  They follow the line holding
+ * `following' if there is one, else the last #include, else they open
+ * the file, in the order given.
+ */
+
+/* the gamemode already includes `directive' (compared without <>) */
+static int
+package_include_present(const char *text, const char *directive)
 {
-	FILE	*m_file, *n_file;
-	char	*ct_modes, *pos, *insert_at, *line_start, *line_end;
-	char	*last_inc, *last_inc_end, *end;
-	char	 lgth_name[DOG_PATH_MAX];
-	long	 fle_size;
-	size_t	 bytes_read;
-	int	 len;
+	char		 name[DOG_PATH_MAX], line[256];
+	const char	*pos, *open, *close, *line_end;
+	size_t		 len;
+
+	snprintf(name, sizeof(name), "%s", directive);
+	open = strchr(directive, '<');
+	close = open != NULL ? strchr(open, '>') : NULL;
+	if (open != NULL && close != NULL) {
+		len = (size_t)(close - open - 1);
+		if (len >= sizeof(name))
+			len = sizeof(name) - 1;
+		memcpy(name, open + 1, len);
+		name[len] = '\0';
+	}
 
-	if (path_exists(modes) == 0)
-		return;
+	for (pos = text; (pos = strstr(pos, "#include")) != NULL;
+	    pos = line_end + 1) {
+		line_end = strchr(pos, '\n');
+		if (line_end == NULL)
+			line_end = pos + strlen(pos);
+		len = (size_t)(line_end - pos);
+		if (len >= sizeof(line))
+			len = sizeof(line) - 1;
+		memcpy(line, pos, len);
+		line[len] = '\0';
+		if (strstr(line, name))
+			return (1);
+		if (*line_end == '\0')
+			break;
+	}
+	return (0);
+}
+
+/*
+ * Add `directives' to `modes'.  Returns how many went in, or -1 when
+ * the file could not be read or replaced.
+ */
+static int
+package_include_apply(const char *modes, char *const *directives, int count,
+    const char *following)
+{
+	FILE		*m_file, *n_file;
+	char		*ct_modes, tmp[DOG_PATH_MAX + 8];
+	const char	*pos, *insert_at, *end;
+	long		 fle_size;
+	int		 i, j, added = 0, ok;
 
+	if (path_exists(modes) == 0)
+		return (-1);
 	m_file = fopen(modes, "rb");
 	if (!m_file)
-		return;
-
+		return (-1);
 	fseek(m_file, 0, SEEK_END);
 	fle_size = ftell(m_file);
 	fseek(m_file, 0, SEEK_SET);
-
-	ct_modes = dog_malloc(fle_size + 2);
-	if (!ct_modes) {
+	if (fle_size < 0 || (ct_modes = dog_malloc((size_t)fle_size + 1)) ==
+	    NULL) {
 		fclose(m_file);
-		return;
+		return (-1);
 	}
-
-	bytes_read = fread(ct_modes, 1, fle_size, m_file);
-	if (bytes_read != fle_size) {
+	if (fread(ct_modes, 1, (size_t)fle_size, m_file) !=
+	    (size_t)fle_size) {
 		pr_error(stdout, "Failed to read the entire file!");
 		minimal_debugging();
 		dog_free(ct_modes);
 		fclose(m_file);
-		return;
+		return (-1);
 	}
-
 	ct_modes[fle_size] = '\0';
 	fclose(m_file);
 
-	strncpy(lgth_name, package_name, sizeof(lgth_name) - 1);
-
-	if (strchr(lgth_name, '<') && strchr(lgth_name, '>')) {
-		char	*open = strchr(lgth_name, '<');
-		char	*close = strchr(lgth_name, '>');
-		if (open && close) {
-			memmove(lgth_name, open + 1, close - open - 1);
-			lgth_name[close - open - 1] = '\0';
-		}
-	}
-
-	pos = ct_modes;
-	while ((pos = strstr(pos, "#include"))) {
-		line_end = strchr(pos, '\n');
-		if (!line_end)
-			line_end = ct_modes + fle_size;
-
-		len = line_end - pos;
-		if (len >= 256)
-			len = 255;
-		char	 line[256];
-		strncpy(line, pos, len);
-		line[len] = '\0';
-
-		if (strstr(line, lgth_name)) {
-			dog_free(ct_modes);
-			return;
-		}
-		pos = line_end + 1;
-	}
-
+	/* the end of the anchor line, else of the last #include line */
 	insert_at = NULL;
-	pos = ct_modes;
-
-	while ((pos = strstr(pos, package_following))) {
-		line_start = pos;
-		while (line_start > ct_modes && *(line_start - 1) != '\n')
-			line_start--;
-
-		line_end = strchr(pos, '\n');
-		if (!line_end)
-			line_end = ct_modes + fle_size;
-
-		len = line_end - line_start;
-		if (len >= 256)
-			len = 255;
-		char	 line[256];
-		strncpy(line, line_start, len);
-		line[len] = '\0';
-
-		if (strstr(line, package_following)) {
-			insert_at = line_end;
-			break;
+	if (following != NULL && (pos = strstr(ct_modes, following)) != NULL) {
+		insert_at = strchr(pos, '\n');
+		if (insert_at == NULL)
+			insert_at = ct_modes + fle_size;
+	}
+	if (insert_at == NULL) {
+		for (pos = ct_modes; (pos = strstr(pos, "#include")) != NULL;
+		    pos = insert_at) {
+			insert_at = strchr(pos, '\n');
+			if (insert_at == NULL)
+				insert_at = ct_modes + fle_size;
 		}
-		pos = line_end + 1;
 	}
 
-	n_file = fopen(modes, "w");
+	snprintf(tmp, sizeof(tmp), "%s.tmp", modes);
+	n_file = fopen(tmp, "wb");
 	if (!n_file) {
 		dog_free(ct_modes);
-		return;
+		return (-1);
 	}
-
-	if (insert_at) {
-		fwrite(ct_modes, 1, insert_at - ct_modes, n_file);
-
+	if (insert_at != NULL) {
+		fwrite(ct_modes, 1, (size_t)(insert_at - ct_modes), n_file);
 		if (insert_at > ct_modes && *(insert_at - 1) != '\n')
-			fprintf(n_file, "\n");
-
-		fprintf(n_file, "%s\n", package_name);
-
-		if (*insert_at) {
-			end = ct_modes + fle_size;
-			while (end > insert_at && (*(end - 1) == '\n' ||
-			    *(end - 1) == '\r' || *(end - 1) == ' ' ||
-			    *(end - 1) == '\t'))
-				end--;
-
-			if (end > insert_at)
-				fwrite(insert_at, 1, end - insert_at, n_file);
-			fprintf(n_file, "\n");
-		}
-	} else {
-		last_inc_end = NULL;
-		pos = ct_modes;
-
-		while ((pos = strstr(pos, "#include"))) {
-			last_inc_end = strchr(pos, '\n');
-			if (!last_inc_end)
-				last_inc_end = ct_modes + fle_size;
-			pos = last_inc_end + 1;
+			fputc('\n', n_file);
+	}
+	for (i = 0; i < count; i++) {
+		for (j = 0; j < i; j++)
+			if (strcmp(directives[j], directives[i]) == 0)
+				break;
+		if (j < i || package_include_present(ct_modes, directives[i]))
+			continue;
+		fprintf(n_file, "%s\n", directives[i]);
+		++added;
+	}
+	if (insert_at == NULL) {
+		fwrite(ct_modes, 1, (size_t)fle_size, n_file);
+	} else if (*insert_at != '\0') {
+		end = ct_modes + fle_size;
+		while (end > insert_at && (*(end - 1) == '\n' ||
+		    *(end - 1) == '\r' || *(end - 1) == ' ' ||
+		    *(end - 1) == '\t'))
+			end--;
+		if (end > insert_at + 1) {
+			fwrite(insert_at + 1, 1, (size_t)(end - insert_at - 1),
+			    n_file);
+			fputc('\n', n_file);
 		}
+	}
+	ok = ferror(n_file) == 0;
+	if (fclose(n_file) != 0)
+		ok = 0;
+	dog_free(ct_modes);
 
-		if (last_inc_end) {
-			fwrite(ct_modes, 1, last_inc_end - ct_modes, n_file);
-			fprintf(n_file, "\n%s\n", package_name);
-
-			end = ct_modes + fle_size;
-			while (end > last_inc_end && (*(end - 1) == '\n' ||
-			    *(end - 1) == '\r'))
-				end--;
-
-			if (end > last_inc_end)
-				fwrite(last_inc_end, 1, end - last_inc_end,
-				    n_file);
-		} else {
-			fprintf(n_file, "%s\n", package_name);
-			fwrite(ct_modes, 1, fle_size, n_file);
-		}
+	if (!ok || added == 0) {
+		remove(tmp);
+		return (ok ? 0 : -1);
+	}
+#ifdef DOG_WINDOWS
+	remove(modes);
+#endif
+	if (rename(tmp, modes) != 0) {
+		remove(tmp);
+		return (-1);
 	}
+	return (added);
+}
 
-	fclose(n_file);
-	dog_free(ct_modes);
+void
+package_add_include(const char *modes, char *package_name,
+    char *package_following)
+{
+	package_include_apply(modes, &package_name, 1, package_following);
 }
 
-#define DENCY_ADD_INCLUDES(x, y, z) package_add_include(x, y, z)
+/*
+ * Includes installed by this run, waiting for package_include_flush.
+ * The gamemode is asked for once and kept for later runs.
+ */
+static struct {
+	char	  target[DOG_PATH_MAX];
+	char	**directive;
+	int	  count;
+} package_includes;
 
 static void
 package_include_prints(const char *package_include)
@@ -1155,77 +1502,106 @@ package_include_prints(const char *package_include)
 	char		 dog_buffer_error[DOG_PATH_MAX],
 			 dependencies[DOG_PATH_MAX], _directive[DOG_MAX_PATH];
 	const char	*package_n, *direct_bnames;
-	char		*userinput;
-	static bool	 k = false;
-	static const char *expect_add;
+	char		*userinput, **grown;
 
 	package_n = fetch_filename(package_include);
 	snprintf(dependencies, sizeof(dependencies), "%s", package_n);
 	direct_bnames = fetch_basename(dependencies);
+	snprintf(_directive, sizeof(_directive), "#include <%s>", direct_bnames);
 
-	this_proc_file = fopen("watchdogs.toml", "r");
-	if (this_proc_file) {
-		dog_toml_server_config = toml_parse_file(this_proc_file,
-		    dog_buffer_error, sizeof(dog_buffer_error));
-		fclose(this_proc_file);
-
-		if (!dog_toml_server_config) {
-			pr_error(stdout,
-			    "failed to parse the watchdogs.toml..: %s",
-			    dog_buffer_error);
-			minimal_debugging();
-			return;
-		}
+	if (package_includes.target[0] == '\0') {
+		this_proc_file = fopen("watchdogs.toml", "r");
+		if (this_proc_file) {
+			dog_toml_server_config = toml_parse_file(this_proc_file,
+			    dog_buffer_error, sizeof(dog_buffer_error));
+			fclose(this_proc_file);
+
+			if (!dog_toml_server_config) {
+				pr_error(stdout,
+				    "failed to parse the watchdogs.toml..: %s",
+				    dog_buffer_error);
+				minimal_debugging();
+				return;
+			}
 
-		toml_table_t *dog_compiler = toml_table_in(dog_toml_server_config,
-		    TOML_TABLE_COMPILER);
-		if (dog_compiler) {
-			toml_datum_t toml_proj_i = toml_string_in(dog_compiler,
-			    "input");
-			if (toml_proj_i.ok) {
-				dogconfig.dog_toml_proj_input =
-				    strdup(toml_proj_i.u.s);
-				dog_free(toml_proj_i.u.s);
+			toml_table_t *dog_compiler = toml_table_in(
+			    dog_toml_server_config, TOML_TABLE_COMPILER);
+			if (dog_compiler) {
+				toml_datum_t toml_proj_i = toml_string_in(
+				    dog_compiler, "input");
+				if (toml_proj_i.ok) {
+					dog_free(dogconfig.dog_toml_proj_input);
+					dogconfig.dog_toml_proj_input =
+					    strdup(toml_proj_i.u.s);
+					dog_free(toml_proj_i.u.s);
+				}
 			}
+			toml_free(dog_toml_server_config);
 		}
-		toml_free(dog_toml_server_config);
-	}
-
-	snprintf(_directive, sizeof(_directive), "#include <%s>", direct_bnames);
 
-	if (k == false) {
 		printf(DOG_COL_BCYAN
 		    "Where do you want to install %s? (enter for: %s)"
 		    DOG_COL_DEFAULT, _directive,
 		    dogconfig.dog_toml_proj_input);
 		fflush(stdout);
 		userinput = readline(" ");
-		if (userinput[0] == '\0')
-			userinput = strdup(dogconfig.dog_toml_proj_input);
-		expect_add = strdup(userinput);
+		if (userinput == NULL || userinput[0] == '\0') {
+			dog_free(userinput);
+			userinput = strdup(dogconfig.dog_toml_proj_input ?
+			    dogconfig.dog_toml_proj_input : "");
+		}
+		/* a gamemode path as is, a bare name under gamemodes/ */
+		if (path_exists(userinput) == 1 ||
+		    strend(userinput, ".pwn", true))
+			snprintf(package_includes.target,
+			    sizeof(package_includes.target), "%s", userinput);
+		else
+			snprintf(package_includes.target,
+			    sizeof(package_includes.target),
+			    "gamemodes/%s.pwn", userinput);
 		dog_free(userinput);
-		k = true;
-	}
 
-	char	size_userinput[DOG_PATH_MAX] = {0};
-	snprintf(size_userinput, sizeof(size_userinput), "gamemodes/%s.pwn",
-	    expect_add);
-
-	if (path_exists(expect_add) == 0) {
-		FILE	*creat = fopen(size_userinput, "w+");
-		if (creat)
-			fclose(creat);
+		if (path_exists(package_includes.target) == 0) {
+			FILE	*creat = fopen(package_includes.target, "w+");
+			if (creat)
+				fclose(creat);
+		}
 	}
 
-	expect_add = strdup(size_userinput);
+	grown = dog_realloc(package_includes.directive,
+	    (size_t)(package_includes.count + 1) * sizeof(char *));
+	if (grown == NULL)
+		return;
+	package_includes.directive = grown;
+	package_includes.directive[package_includes.count] =
+	    strdup(_directive);
+	if (package_includes.directive[package_includes.count] != NULL)
+		++package_includes.count;
+}
 
-	if (fetch_server_env() == 1) {
-		DENCY_ADD_INCLUDES(expect_add, _directive, "#include <a_samp>");
-	} else if (fetch_server_env() == 2) {
-		DENCY_ADD_INCLUDES(expect_add, _directive, "#include <open.mp>");
-	} else {
-		DENCY_ADD_INCLUDES(expect_add, _directive, "#include <a_samp>");
-	}
+/* write the includes collected by this run into the gamemode */
+static void
+package_include_flush(void)
+{
+	int	 i, added;
+
+	if (package_includes.count == 0)
+		return;
+	added = package_include_apply(package_includes.target,
+	    package_includes.directive, package_includes.count,
+	    fetch_server_env() == 2 ? "#include <open.mp>" :
+	    "#include <a_samp>");
+	if (added < 0)
+		pr_error(stdout, "cannot add the includes to %s",
+		    package_includes.target);
+	else if (added > 0)
+		pr_info(stdout, "added %d #include directive(s) to %s",
+		    added, package_includes.target);
+	for (i = 0; i < package_includes.count; i++)
+		dog_free(package_includes.directive[i]);
+	dog_free(package_includes.directive);
+	package_includes.directive = NULL;
+	package_includes.count = 0;
 }
 
 static
@@ -1233,11 +1609,13 @@ void
 dump_file_type(const char *dump_path, char *dump_pattern,
     char *dump_exclude, char *dump_loc, char *dump_place, int dump_root)
 {
-    const char  *package_names, *basename,
-    			*match_root_keywords;
-    char         dest_path[DOG_PATH_MAX * 2];
+    const char  *package_names, *match_root_keywords;
+    char        *basename;
+    char       (*dest_path)[DOG_PATH_MAX * 2];
     char        *basename_lwr;
-    int          i, found, rate_has_prefix;
+    int         *rate_has_prefix;
+    DogFileMove *moves;
+    int          i, found, count;
 
     dog_sef_path_revert();
 
@@ -1247,124 +1625,116 @@ dump_file_type(const char *dump_path, char *dump_pattern,
     println(stdout, "fdir_counts (%d): %d", fdir_counts, found);
 #endif
 
-    if (found) {
-        for (i = 0; i < dogconfig.dog_sef_count; ++i) {
-            package_names = fetch_filename(
-                dogconfig.dog_sef_found_list[i]);
-            basename = fetch_basename(
-                dogconfig.dog_sef_found_list[i]);
-
-            basename_lwr = strdup(basename);
-            for (int j = 0; basename_lwr[j]; j++)
-                basename_lwr[j] = tolower(basename_lwr[j]);
-
-            rate_has_prefix = 0;
-
-            match_root_keywords = dogconfig.dog_toml_root_patterns;
-            while (*match_root_keywords) {
-                while (*match_root_keywords == ' ')
-                    match_root_keywords++;
-
-                const char *end = match_root_keywords;
-                while (*end && *end != ' ')
-                    end++;
-
-                if (end > match_root_keywords) {
-                    size_t keyword_len = end - match_root_keywords;
-                    if (strncmp(basename_lwr,
-                        match_root_keywords,
-                        keyword_len) == 0)
-                    {
-                        ++rate_has_prefix;
-                        break;
-                    }
-                }
-
-                match_root_keywords = (*end) ? end + 1 : end;
-            }
-            dog_free(basename_lwr);
-
-            dest_path[0] = '\0';
+    if (!found)
+        return;
 
-            if (dump_place[0] != '\0') {
-                snprintf(dest_path, sizeof(dest_path), "%s%s%s%s%s",
-                         dump_loc, separator, dump_place, separator,
-                         package_names);
-
-                char dir_part[DOG_PATH_MAX];
-                snprintf(dir_part, sizeof(dir_part), "%s%s%s",
-                         dump_loc, separator, dump_place);
-                if (dir_exists(dir_part) == 0) {
-                    dog_mkdir_recursive(dir_part);
-                }
-            } else if (rate_has_prefix) {
-                snprintf(dest_path, sizeof(dest_path), "%s%s%s",
-                         dump_loc, separator, package_names);
-            } else {
-                snprintf(dest_path, sizeof(dest_path), "%s%s%s%s",
-                         dump_loc, separator, separator, package_names);
-
-                char plugin_dir[DOG_PATH_MAX * 2];
-                snprintf(plugin_dir, sizeof(plugin_dir), "%s%s",
-                         dump_loc, separator);
-                if (dir_exists(plugin_dir) == 0) {
-                    dog_mkdir_recursive(plugin_dir);
+    count = dump_root == 1 ? 1 : (int)dogconfig.dog_sef_count;
+    dest_path = dog_calloc((size_t)count, sizeof(*dest_path));
+    rate_has_prefix = dog_calloc((size_t)count, sizeof(int));
+    moves = dog_calloc((size_t)count, sizeof(DogFileMove));
+    if (!dest_path || !rate_has_prefix || !moves)
+        goto done;
+
+    /* work out every destination, then move them all at once */
+    for (i = 0; i < count; ++i) {
+        package_names = fetch_filename(
+            dogconfig.dog_sef_found_list[i]);
+
+        basename_lwr = fetch_basename(
+            dogconfig.dog_sef_found_list[i]);
+        for (int j = 0; basename_lwr && basename_lwr[j]; j++)
+            basename_lwr[j] = tolower(basename_lwr[j]);
+
+        match_root_keywords = basename_lwr &&
+            dogconfig.dog_toml_root_patterns ?
+            dogconfig.dog_toml_root_patterns : "";
+        while (*match_root_keywords) {
+            while (*match_root_keywords == ' ')
+                match_root_keywords++;
+
+            const char *end = match_root_keywords;
+            while (*end && *end != ' ')
+                end++;
+
+            if (end > match_root_keywords) {
+                size_t keyword_len = end - match_root_keywords;
+                if (strncmp(basename_lwr,
+                    match_root_keywords,
+                    keyword_len) == 0)
+                {
+                    ++rate_has_prefix[i];
+                    break;
                 }
             }
 
-            int move_success = 0;
-		#ifdef DOG_WINDOWS
-            if (MoveFileExA(dogconfig.dog_sef_found_list[i], dest_path,
-                           MOVEFILE_REPLACE_EXISTING | MOVEFILE_COPY_ALLOWED)) {
-                move_success = 1;
-            } else {
-                snprintf(command, sizeof(command), "\"%s\" \"%s\" >nul 2>&1 && del \"%s\"",
-                         dogconfig.dog_sef_found_list[i], dest_path,
-                         dogconfig.dog_sef_found_list[i]);
-                char *argv[] = { "copy", "/Y", command, NULL };
-                move_success = dog_exec_command(argv);
+            match_root_keywords = (*end) ? end + 1 : end;
+        }
+        dog_free(basename_lwr);
+
+        if (dump_place[0] != '\0') {
+            snprintf(dest_path[i], sizeof(dest_path[i]), "%s%s%s%s%s",
+                     dump_loc, separator, dump_place, separator,
+                     package_names);
+
+            char dir_part[DOG_PATH_MAX];
+            snprintf(dir_part, sizeof(dir_part), "%s%s%s",
+                     dump_loc, separator, dump_place);
+            if (dir_exists(dir_part) == 0) {
+                dog_mkdir_recursive(dir_part);
             }
-		#else
-            if (rename(dogconfig.dog_sef_found_list[i], dest_path) == 0) {
-                move_success = 1;
-            } else {
-                pid_t pid = fork();
-                if (pid == 0) {
-                    execlp("mv", "mv", "-f",
-                           dogconfig.dog_sef_found_list[i],
-                           dest_path,
-                           NULL);
-                    _exit(127);
-                }
-                waitpid(pid, NULL, 0);
-                move_success = 1;
+        } else if (rate_has_prefix[i]) {
+            snprintf(dest_path[i], sizeof(dest_path[i]), "%s%s%s",
+                     dump_loc, separator, package_names);
+        } else {
+            snprintf(dest_path[i], sizeof(dest_path[i]), "%s%s%s%s",
+                     dump_loc, separator, separator, package_names);
+
+            char plugin_dir[DOG_PATH_MAX * 2];
+            snprintf(plugin_dir, sizeof(plugin_dir), "%s%s",
+                     dump_loc, separator);
+            if (dir_exists(plugin_dir) == 0) {
+                dog_mkdir_recursive(plugin_dir);
             }
-		#endif
-            if (move_success) {
-                if (dump_place[0] != '\0') {
-                    pr_color(stdout, DOG_COL_CYAN,
-                        " [M] Plugins %s -> %s%s%s\n",
-                        basename, dump_loc, separator, dump_place);
-                } else if (rate_has_prefix) {
-                    pr_color(stdout, DOG_COL_CYAN,
-                        " [M] Plugins %s -> %s\n",
-                        basename, dump_loc);
-                } else {
-                    pr_color(stdout, DOG_COL_CYAN,
-                        " [M] Plugins %s -> %s%s?\n",
-                        basename, dump_loc, separator);
-                }
+        }
+
+        moves[i].src = dogconfig.dog_sef_found_list[i];
+        moves[i].dest = dest_path[i];
+    }
+
+    dog_file_move_batch(moves, count);
+
+    for (i = 0; i < count; ++i) {
+        package_names = fetch_filename(
+            dogconfig.dog_sef_found_list[i]);
+        basename = fetch_basename(
+            dogconfig.dog_sef_found_list[i]);
+        if (!basename)
+            continue;
+
+        if (moves[i].ret == 0) {
+            dog_store_place(dest_path[i]);
+            if (dump_place[0] != '\0') {
+                pr_color(stdout, DOG_COL_CYAN,
+                    " [M] Plugins %s -> %s%s%s\n",
+                    basename, dump_loc, separator, dump_place);
+            } else if (rate_has_prefix[i]) {
+                pr_color(stdout, DOG_COL_CYAN,
+                    " [M] Plugins %s -> %s\n",
+                    basename, dump_loc);
             } else {
-                pr_error(stdout, "Failed to move: %s", basename);
+                pr_color(stdout, DOG_COL_CYAN,
+                    " [M] Plugins %s -> %s%s?\n",
+                    basename, dump_loc, separator);
             }
+        } else {
+            pr_error(stdout, "Failed to move: %s", basename);
+        }
 
-            snprintf(json_item, sizeof(json_item), "%s",
-                package_names);
-            package_try_parsing(json_item, json_item);
-
-            if (dump_root == 1)
-                goto done;
+        snprintf(json_item, sizeof(json_item), "%s",
+            package_names);
+        package_try_parsing(json_item, json_item);
 
+        if (dump_root != 1) {
             if (fetch_server_env() == 1 &&
                 strfind(dogconfig.dog_toml_server_config,
                 	".cfg", true))
@@ -1376,9 +1746,13 @@ dump_file_type(const char *dump_path, char *dump_pattern,
                 M_ADD_PLUGIN(dogconfig.dog_toml_server_config,
                     basename);
         }
+        dog_free(basename);
     }
 
 done:
+    dog_free(moves);
+    dog_free(rate_has_prefix);
+    dog_free(dest_path);
     return;
 }
 
@@ -1391,19 +1765,76 @@ package_cjson_additem(cJSON *p1, int p2, cJSON *p3)
 		    cJSON_CreateString(cJSON_GetArrayItem(p1, p2)->valuestring));
 }
 
-static
-void package_move_files(const char *package_dir, const char *package_loc)
-{
+/* files of a package waiting to be moved in one batch */
+typedef struct {
+	char		(*src)[DOG_PATH_MAX * 3];
+	char		(*dest)[DOG_PATH_MAX * 3];
+	DogFileMove	 *move;
+	int		  count, cap;
+} PackageMoves;
+
+static void
+package_moves_add(PackageMoves *m, const char *dir, const char *name,
+    const char *dest_dir)
+{
+	void	*p;
+	int	 i;
+
+	if (m->count == m->cap) {
+		int	 cap = m->cap ? m->cap * 2 : 32;
+
+		if ((p = dog_realloc(m->src, (size_t)cap *
+		    sizeof(*m->src))) == NULL)
+			return;
+		m->src = p;
+		if ((p = dog_realloc(m->dest, (size_t)cap *
+		    sizeof(*m->dest))) == NULL)
+			return;
+		m->dest = p;
+		if ((p = dog_realloc(m->move, (size_t)cap *
+		    sizeof(*m->move))) == NULL)
+			return;
+		m->move = p;
+		m->cap = cap;
+		/* the arrays may have moved */
+		for (i = 0; i < m->count; i++) {
+			m->move[i].src = m->src[i];
+			m->move[i].dest = m->dest[i];
+		}
+	}
+	snprintf(m->src[m->count], sizeof(m->src[0]), "%s%s%s", dir,
+	    separator, name);
+	snprintf(m->dest[m->count], sizeof(m->dest[0]), "%s%s%s", dest_dir,
+	    separator, name);
+	m->move[m->count].src = m->src[m->count];
+	m->move[m->count].dest = m->dest[m->count];
+	m->move[m->count].ret = -1;
+	++m->count;
+}
+
+static void
+package_moves_free(PackageMoves *m)
+{
+	dog_free(m->src);
+	dog_free(m->dest);
+	dog_free(m->move);
+	memset(m, 0, sizeof(*m));
+}
+
+static
+void package_move_files(const char *package_dir, const char *package_loc)
+{
     char    the_path[DOG_PATH_MAX * 2],
 			includes[DOG_PATH_MAX],
 		    plugins[DOG_PATH_MAX * 2], components[DOG_PATH_MAX * 2],
 		    subdir_path[DOG_PATH_MAX * 2],
-			include_dest[1024], dest_file[1024 * 3];
+			include_dest[1024];
     struct            stat dir_st;
     struct  dirent   *dir_item;
     struct  dirent   *subdir_item;
     DIR              *open_dir;
     DIR              *subdir;
+    PackageMoves      incs = { 0 };
     
 	#ifdef DOG_WINDOWS
 	    snprintf(plugins, sizeof(plugins), "%s\\plugins", package_dir);
@@ -1435,6 +1866,10 @@ void package_move_files(const char *package_dir, const char *package_loc)
         return;
     }
 
+    /*
+     * .inc files at the top of the package or one directory down are
+     * gathered first and moved in one batch.
+     */
     while ((dir_item = readdir(open_dir)) != NULL) {
         if (dog_dot_or_dotdot(dir_item->d_name)) {
             continue;
@@ -1480,34 +1915,8 @@ void package_move_files(const char *package_dir, const char *package_loc)
                     continue;
                 }
 
-                char src_file[DOG_PATH_MAX * 3];
-                snprintf(src_file, sizeof(src_file), "%s%s%s",
-                         subdir_path, separator, subdir_item->d_name);
-                
-                snprintf(dest_file, sizeof(dest_file), "%s%s%s",
-                         include_dest, separator, subdir_item->d_name);
-                
-                if (rename(src_file, dest_file) != 0) {
-#	ifdef DOG_WINDOWS
-		            snprintf(command, sizeof(command),
-		                    "\"%s\" \"%s\"",
-		                    src_file, dest_file);
-		            char *moving[] = { "move", "/Y", command, ">nul", "2>&1", NULL };
-	#else
-		            snprintf(command, sizeof(command),
-		                    "\"%s\" \"%s\"",
-		                    src_file, dest_file);
-		            char *moving[] = { "mv", "-f", command, ">/dev/null", "2>&1", NULL };
-	#endif
-            		dog_exec_command(moving);
-                }
-                
-                package_try_parsing(dest_file, dest_file);
-                package_include_prints(subdir_item->d_name);
-                
-                pr_color(stdout, DOG_COL_YELLOW,
-                        " [M] Include %s -> %s\n",
-                        subdir_item->d_name, dest_file);
+                package_moves_add(&incs, subdir_path, subdir_item->d_name,
+                    include_dest);
             }
             
             closedir(subdir);
@@ -1520,34 +1929,29 @@ void package_move_files(const char *package_dir, const char *package_loc)
             continue;
         }
 
-        snprintf(dest_file, sizeof(dest_file), "%s%s%s",
-                 include_dest, separator, dir_item->d_name);
-        
-        if (rename(the_path, dest_file) != 0) {
-	#ifdef DOG_WINDOWS
-            snprintf(command, sizeof(command),
-                    "\"%s\" \"%s\"",
-                    the_path, dest_file);
-            char *moving[] = { "move", "/Y", command, ">nul", "2>&1" };
+        package_moves_add(&incs, package_dir, dir_item->d_name,
+            include_dest);
+    }
+    closedir(open_dir);
 
-	#else
-            snprintf(command, sizeof(command),
-                    "\"%s\" \"%s\"",
-                    the_path, dest_file);
-            char *moving[] = { "mv", "-f", command, ">/dev/null", "2>&1" };
-	#endif
-            dog_exec_command(moving);
+    dog_file_move_batch(incs.move, incs.count);
+    for (int i = 0; i < incs.count; i++) {
+        const char *name = fetch_filename(incs.dest[i]);
+
+        if (incs.move[i].ret != 0) {
+            pr_error(stdout, "Failed to move: %s", incs.src[i]);
+            continue;
         }
-        
-        package_try_parsing(dest_file, dest_file);
-        package_include_prints(dir_item->d_name);
-        
+        dog_store_place(incs.dest[i]);
+
+        package_try_parsing(incs.dest[i], incs.dest[i]);
+        package_include_prints(name);
+
         pr_color(stdout, DOG_COL_YELLOW,
                 " [M] Include %s -> %s\n",
-                dir_item->d_name, dest_file);
+                name, incs.dest[i]);
     }
-
-    closedir(open_dir);
+    package_moves_free(&incs);
 
     if (dir_exists(plugins)) {
         char plugin_dest[DOG_PATH_MAX];
@@ -1571,34 +1975,12 @@ void package_move_files(const char *package_dir, const char *package_loc)
     return;
 }
 
+/* create the include, plugin and component directories of a location */
 static
 void
-dog_apply_depends(const char *depends_name, const char *depends_location)
+package_prepare_location(const char *depends_location)
 {
-	char	s_dependencies[DOG_PATH_MAX],
-		package_dir[DOG_PATH_MAX];
 	char	size_depends_location[DOG_PATH_MAX * 2];
-	char	*extension;
-
-	snprintf(s_dependencies,
-		sizeof(s_dependencies), "%s", depends_name);
-
-#if defined(_DBG_PRINT)
-	println(stdout, "s_dependencies: %s", s_dependencies);
-#endif
-
-	if ((extension = strstr(s_dependencies, ".tar.gz")) != NULL)
-		*extension = '\0';
-	else if ((extension = strstr(s_dependencies, ".tar")) != NULL)
-		*extension = '\0';
-	else if ((extension = strstr(s_dependencies, ".zip")) != NULL)
-		*extension = '\0';
-
-	snprintf(package_dir, sizeof(package_dir), "%s", s_dependencies);
-
-#if defined(_DBG_PRINT)
-	println(stdout, "dency dir: %s", package_dir);
-#endif
 
 	if (fetch_server_env() == 1) {
 		snprintf(size_depends_location, sizeof(size_depends_location),
@@ -1626,27 +2008,1114 @@ dog_apply_depends(const char *depends_name, const char *depends_location)
 		if (dir_exists(size_depends_location) == 0)
 			dog_mkdir_recursive(size_depends_location);
 	}
+}
+
+static
+void
+dog_apply_depends(const char *depends_name, const char *depends_location)
+{
+	char	s_dependencies[DOG_PATH_MAX],
+		package_dir[DOG_PATH_MAX];
+	char	*extension;
+
+	snprintf(s_dependencies,
+		sizeof(s_dependencies), "%s", depends_name);
+
+#if defined(_DBG_PRINT)
+	println(stdout, "s_dependencies: %s", s_dependencies);
+#endif
 
+	if ((extension = strstr(s_dependencies, ".tar.gz")) != NULL)
+		*extension = '\0';
+	else if ((extension = strstr(s_dependencies, ".tar")) != NULL)
+		*extension = '\0';
+	else if ((extension = strstr(s_dependencies, ".zip")) != NULL)
+		*extension = '\0';
+
+	snprintf(package_dir, sizeof(package_dir), "%s", s_dependencies);
+
+#if defined(_DBG_PRINT)
+	println(stdout, "dency dir: %s", package_dir);
+#endif
+
+	package_prepare_location(depends_location);
 	package_move_files(package_dir, depends_location);
 }
 
-void
-dog_install_depends(const char *packages, const char *branch, const char *where)
+static void
+package_list_directory(void)
 {
-	char			 buffer[1024], package_url[1024],
-				 package_name[DOG_PATH_MAX];
-	char			*procure_buffer, *fetch_pwd, *init_location,
-				*locations;
-	const char		*dependencies[MAX_DEPENDS];
-	struct _repositories	 repo;
-	int			 package_counts = 0, i;
-	static int   k = false;
 #ifdef DOG_WINDOWS
 	WIN32_FIND_DATAA ffd;
 	HANDLE           hFind;
 	char             search[] = "*";
 #endif
-	memset(dependencies, 0, sizeof(dependencies));
+
+	printf("\n"
+		   ".."
+		   "LIST OF DIRECTORY: "
+		   "%s", dog_procure_pwd());
+	fflush(stdout);
+	print("\n");
+
+	#ifdef DOG_LINUX
+	int tree_ret = -1;
+	{
+		char *tree[] = { "tree", ">", "/dev/null 2>&1", NULL };
+		tree_ret = dog_exec_command(tree);
+	}
+	if (!tree_ret) {
+		char *tree[] = { "tree", NULL };
+		dog_exec_command(tree);
+	}
+	else {
+		DIR *d = opendir(".");
+		if (d) {
+			struct dirent *de;
+			struct stat st;
+			char path[DOG_PATH_MAX];
+
+			while ((de = readdir(d)) != NULL) {
+				if (de->d_name[0] == '.')
+					continue;
+
+				snprintf(path, sizeof(path), "%s", de->d_name);
+				if (lstat(path, &st) == 0 && S_ISDIR(st.st_mode)) {
+					printf("%s\n", de->d_name);
+				}
+			}
+			closedir(d);
+		}
+	}
+	#else
+	hFind = FindFirstFileA(search, &ffd);
+	if (hFind != INVALID_HANDLE_VALUE) {
+		do {
+			if ((ffd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) &&
+				strcmp(ffd.cFileName, ".") != 0 &&
+				strcmp(ffd.cFileName, "..") != 0) {
+				printf("%s\n", ffd.cFileName);
+			}
+		} while (FindNextFileA(hFind, &ffd));
+		FindClose(hFind);
+	}
+	#endif
+
+	print("\n");
+	fflush(stdout);
+}
+
+/*
+ * watchdogs.lock pins what each dependency spec resolved to: the tag,
+ * the archive URL, and the size and SHA-256 of the archive.  A pinned
+ * spec is installed from its URL without asking any API, and the
+ * archive must match before it is unpacked.
+ */
+
+#define PACKAGE_LOCK_FILE	"watchdogs.lock"
+
+typedef struct {
+	char		 spec[256];
+	char		 tag[tag_size];
+	char		 url[1024];
+	char		 sha256[SHA256_DIGEST_LENGTH * 2 + 1];
+	long long	 size;
+	int		 installed;	/* this run, archive checked */
+} PackageLock;
+
+typedef struct {
+	PackageLock	*entry;
+	int		 count;
+} PackageLocks;
+
+static void
+package_lock_string(toml_table_t *table, const char *key, char *dest,
+    size_t size)
+{
+	toml_datum_t	 val;
+
+	val = toml_string_in(table, key);
+	if (!val.ok)
+		return;
+	snprintf(dest, size, "%s", val.u.s);
+	dog_free(val.u.s);
+}
+
+static void
+package_lock_load(PackageLocks *locks)
+{
+	char		 errbuf[DOG_PATH_MAX];
+	toml_table_t	*root, *table;
+	toml_array_t	*packages;
+	toml_datum_t	 size;
+	PackageLock	*lock;
+	FILE		*fp;
+	int		 i, n;
+
+	memset(locks, 0, sizeof(*locks));
+	fp = fopen(PACKAGE_LOCK_FILE, "r");
+	if (fp == NULL)
+		return;
+	root = toml_parse_file(fp, errbuf, sizeof(errbuf));
+	fclose(fp);
+	if (root == NULL) {
+		pr_warning(stdout, "ignoring %s: %s", PACKAGE_LOCK_FILE,
+		    errbuf);
+		return;
+	}
+
+	packages = toml_array_in(root, "package");
+	n = packages ? toml_array_nelem(packages) : 0;
+	if (n > 0)
+		locks->entry = dog_calloc((size_t)n, sizeof(PackageLock));
+	for (i = 0; i < n && locks->entry != NULL; i++) {
+		table = toml_table_at(packages, i);
+		if (table == NULL)
+			continue;
+		lock = &locks->entry[locks->count];
+		package_lock_string(table, "spec", lock->spec,
+		    sizeof(lock->spec));
+		package_lock_string(table, "tag", lock->tag,
+		    sizeof(lock->tag));
+		package_lock_string(table, "url", lock->url,
+		    sizeof(lock->url));
+		package_lock_string(table, "sha256", lock->sha256,
+		    sizeof(lock->sha256));
+		size = toml_int_in(table, "size");
+		if (size.ok)
+			lock->size = (long long)size.u.i;
+		if (lock->spec[0] != '\0' && lock->url[0] != '\0')
+			++locks->count;
+	}
+	toml_free(root);
+}
+
+static PackageLock *
+package_lock_find(const PackageLocks *locks, const char *spec)
+{
+	int	 i;
+
+	for (i = 0; i < locks->count; i++)
+		if (strcmp(locks->entry[i].spec, spec) == 0)
+			return (&locks->entry[i]);
+	return (NULL);
+}
+
+/*
+ * Check the downloaded archive.  An entry that already has a checksum
+ * must match it; otherwise the checksum is recorded.  `sha256' is the
+ * digest the download took through the streaming SHA-256 as the bytes
+ * came in.
+ */
+static int
+package_lock_verify(PackageLock *lock, const char *path, const char *sha256)
+{
+	uint64_t	 size = 0;
+	struct stat	 st;
+	char		*hex = NULL;
+
+	if (sha256 != NULL && strlen(sha256) == SHA256_DIGEST_LENGTH * 2 &&
+	    stat(path, &st) == 0) {
+		hex = strdup(sha256);
+		size = (uint64_t)st.st_size;
+	}
+	if (hex == NULL) {
+		pr_error(stdout, "cannot checksum %s", path);
+		return (-1);
+	}
+	if (lock->sha256[0] != '\0' && (strcmp(lock->sha256, hex) != 0 ||
+	    (lock->size > 0 && (uint64_t)lock->size != size))) {
+		pr_error(stdout,
+		    "%s does not match " PACKAGE_LOCK_FILE " for %s\n"
+		    "   locked: %s (%lld bytes)\n"
+		    "   got:    %s (%llu bytes)",
+		    path, lock->spec, lock->sha256, lock->size, hex,
+		    (unsigned long long)size);
+		dog_free(hex);
+		return (-1);
+	}
+	snprintf(lock->sha256, sizeof(lock->sha256), "%s", hex);
+	lock->size = (long long)size;
+	dog_free(hex);
+	return (0);
+}
+
+static void
+package_lock_quote(FILE *fp, const char *key, const char *value)
+{
+	fprintf(fp, "%s = \"", key);
+	for (; *value != '\0'; value++) {
+		if (*value == '"' || *value == '\\')
+			fputc('\\', fp);
+		fputc(*value, fp);
+	}
+	fputs("\"\n", fp);
+}
+
+/* the entry this run installed for `spec', if any */
+static const PackageLock *
+package_lock_installed(const PackageLock *run, int nrun, const char *spec)
+{
+	int	 i;
+
+	for (i = 0; i < nrun; i++)
+		if (run[i].installed && strcmp(run[i].spec, spec) == 0)
+			return (&run[i]);
+	return (NULL);
+}
+
+/*
+ * Fold this run's installs into the pinned entries and rewrite the
+ * lock through a temporary file, so a reader never sees half of it.
+ */
+static void
+package_lock_save(const PackageLocks *locks, const PackageLock *run,
+    int nrun)
+{
+	const char	*tmp = PACKAGE_LOCK_FILE ".tmp";
+	const PackageLock *lock, *fresh;
+	FILE		*fp;
+	int		 i;
+
+	for (i = 0; i < nrun; i++)
+		if (run[i].installed)
+			break;
+	if (i == nrun)
+		return;
+
+	fp = fopen(tmp, "w");
+	if (fp == NULL) {
+		pr_error(stdout, "cannot write %s", tmp);
+		return;
+	}
+	fprintf(fp,
+	    "# written by `watchdogs replicate'; do not edit.\n"
+	    "# `replicate --update' resolves the packages again.\n");
+
+	for (i = 0; i < locks->count + nrun; i++) {
+		if (i < locks->count) {
+			lock = &locks->entry[i];
+			fresh = package_lock_installed(run, nrun, lock->spec);
+			if (fresh != NULL)
+				lock = fresh;
+		} else {
+			lock = &run[i - locks->count];
+			if (package_lock_installed(run, nrun,
+			    lock->spec) != lock ||
+			    package_lock_find(locks, lock->spec) != NULL)
+				continue;
+		}
+		fprintf(fp, "\n[[package]]\n");
+		package_lock_quote(fp, "spec", lock->spec);
+		package_lock_quote(fp, "tag", lock->tag);
+		package_lock_quote(fp, "url", lock->url);
+		fprintf(fp, "size = %lld\n", lock->size);
+		package_lock_quote(fp, "sha256", lock->sha256);
+	}
+
+	if (fclose(fp) != 0) {
+		pr_error(stdout, "cannot write %s", tmp);
+		remove(tmp);
+		return;
+	}
+#ifdef DOG_WINDOWS
+	remove(PACKAGE_LOCK_FILE);
+#endif
+	if (rename(tmp, PACKAGE_LOCK_FILE) != 0) {
+		pr_error(stdout, "cannot replace %s", PACKAGE_LOCK_FILE);
+		remove(tmp);
+	}
+}
+
+/*
+ * Packages asked for are installed with everything their pawn.json
+ * manifests depend on.  Each fetched archive is unpacked and its
+ * manifest read at once, so the dependencies join the download queue
+ * while the rest is still in flight; a package is only moved into
+ * place once every package it needs has been, and a dependency cycle
+ * is broken at the end.  A repository is installed once per run: a
+ * second request for it with another tag is reported and the first
+ * one kept.
+ */
+
+#define PACKAGE_NEEDS_MAX	32
+
+#define PACKAGE_NODE_QUEUED	0
+#define PACKAGE_NODE_FETCHED	1	/* unpacked, waiting for its needs */
+#define PACKAGE_NODE_PLACED	2
+#define PACKAGE_NODE_FAILED	3
+
+typedef struct {
+	char	 key[256];	/* repository, without host and tag */
+	int	 parent;	/* the package that needs it, -1 if asked for */
+	int	 state;
+	int	 needs[PACKAGE_NEEDS_MAX];
+	int	 nneeds;
+	char	 dir[DOG_PATH_MAX];
+} PackageNode;
+
+typedef struct {
+	const char	*where;
+	char		*location;	/* asked for on the first install */
+	PackageLock	*run;		/* MAX_DEPENDS entries */
+	PackageNode	*node;		/* the same ones in the graph */
+	int		 count;
+} PackageInstall;
+
+/* where packages go: `where' if given, else asked for once */
+static const char *
+package_install_location(PackageInstall *inst, const char *package_name)
+{
+	char	*locations;
+
+	if (inst->where != NULL && inst->where[0] != '\0') {
+		if (dir_exists(inst->where) == 0)
+			dog_mkdir_recursive(inst->where);
+		return (inst->where);
+	}
+	if (inst->location != NULL)
+		return (inst->location);
+
+	package_list_directory();
+
+	printf(DOG_COL_BCYAN
+	    "Where do you want to install %s? "
+	    "(enter for: %s)" DOG_COL_DEFAULT,
+	    package_name, dog_procure_pwd());
+	fflush(stdout);
+
+	locations = readline(" ");
+	if (locations[0] == '\0' || locations[0] == '.') {
+		inst->location = strdup(dog_procure_pwd());
+	} else {
+		if (dir_exists(locations) == 0)
+			dog_mkdir_recursive(locations);
+		inst->location = strdup(locations);
+	}
+	dog_free(locations);
+	return (inst->location);
+}
+
+/* "https://github.com/User/Repo.git?v1" and "user/repo" are one key */
+static void
+package_graph_key(const char *spec, char *key, size_t size)
+{
+	const char	*p;
+	size_t		 n = 0;
+
+	if ((p = strstr(spec, "://")) != NULL)
+		spec = p + 3;
+	if (strncasecmp(spec, "www.", 4) == 0)
+		spec += 4;
+	if (strncasecmp(spec, "github.com/", 11) == 0)
+		spec += 11;
+	for (; *spec != '\0' && *spec != '?' && n + 1 < size; spec++)
+		key[n++] = (char)tolower((unsigned char)*spec);
+	key[n] = '\0';
+	if (n > 4 && strcmp(key + n - 4, ".git") == 0)
+		key[n - 4] = '\0';
+	while (n > 0 && key[n - 1] == '/')
+		key[--n] = '\0';
+}
+
+static const char *
+package_spec_tag(const char *spec)
+{
+	const char	*tag = strrchr(spec, '?');
+
+	return (tag != NULL ? tag + 1 : "");
+}
+
+/*
+ * Add `spec' to the packages of this run, needed by `parent' (-1 when
+ * it was asked for).  Returns its index, the one already there for the
+ * same repository, or -1 when there is no room left.
+ */
+static int
+package_graph_add(PackageInstall *inst, const char *spec, int parent)
+{
+	PackageNode	*node;
+	char		 key[256];
+	const char	*want, *have;
+	int		 i, j;
+
+	package_graph_key(spec, key, sizeof(key));
+	for (i = 0; i < inst->count; i++)
+		if (strcmp(inst->node[i].key, key) == 0)
+			break;
+	if (i < inst->count) {
+		want = package_spec_tag(spec);
+		have = package_spec_tag(inst->run[i].spec);
+		if (*want != '\0' && strcasecmp(want, have) != 0)
+			pr_warning(stdout, "version conflict for %s: %s wants "
+			    "\"%s\" but \"%s\" was asked for first, keeping "
+			    "it", key, parent >= 0 ? inst->run[parent].spec :
+			    "the command line", want,
+			    *have != '\0' ? have : "latest");
+	} else {
+		if (inst->count == MAX_DEPENDS) {
+			pr_warning(stdout, "too many packages, skipping %s",
+			    spec);
+			return (-1);
+		}
+		i = inst->count++;
+		node = &inst->node[i];
+		memset(node, 0, sizeof(*node));
+		memset(&inst->run[i], 0, sizeof(inst->run[i]));
+		snprintf(node->key, sizeof(node->key), "%s", key);
+		snprintf(inst->run[i].spec, sizeof(inst->run[i].spec), "%s",
+		    spec);
+		node->parent = parent;
+	}
+
+	if (parent >= 0 && parent != i) {
+		node = &inst->node[parent];
+		for (j = 0; j < node->nneeds; j++)
+			if (node->needs[j] == i)
+				break;
+		if (j == node->nneeds && node->nneeds < PACKAGE_NEEDS_MAX)
+			node->needs[node->nneeds++] = i;
+	}
+	return (i);
+}
+
+/*
+ * A manifest dependency ("user/repo", "user/repo:tag", a GitHub URL,
+ * with "@branch" or "#commit" left for the newest release) as a spec
+ * of our own.  The compiler's standard library comes with the server
+ * and is skipped.  It is told by repository name alone: it moved from
+ * sampctl/ and Southclaws/ to pawn-lang/ over the years, and old
+ * manifests still name every one of them.
+ */
+static int
+package_manifest_spec(const char *dep, char *spec, size_t size)
+{
+	static const char *const bundled[] = {
+		"samp-stdlib", "pawn-stdlib", "omp-stdlib", NULL
+	};
+	char		 name[256], key[256];
+	const char	*tag = NULL, *repo;
+	char		*p;
+	int		 i;
+
+	if (strncmp(dep, "http://", 7) == 0)
+		dep += 7;
+	else if (strncmp(dep, "https://", 8) == 0)
+		dep += 8;
+	else if (strstr(dep, "://") != NULL)
+		return (0);
+	snprintf(name, sizeof(name), "%s", dep);
+	if ((p = strpbrk(name, "@#")) != NULL)
+		*p = '\0';
+	if ((p = strrchr(name, ':')) != NULL) {
+		*p = '\0';
+		tag = p + 1;
+	}
+	if (strchr(name, '/') == NULL)
+		return (0);
+
+	package_graph_key(name, key, sizeof(key));
+	repo = strrchr(key, '/');
+	repo = repo != NULL ? repo + 1 : key;
+	for (i = 0; bundled[i] != NULL; i++)
+		if (strcmp(repo, bundled[i]) == 0)
+			return (0);
+	if (strchr(name, '.') == NULL || strchr(name, '.') > strchr(name, '/'))
+		snprintf(spec, size, "github.com/%s%s%s", name,
+		    tag ? "?" : "", tag ? tag : "");
+	else
+		snprintf(spec, size, "%s%s%s", name, tag ? "?" : "",
+		    tag ? tag : "");
+	return (1);
+}
+
+/* queue what the manifest at `path' of package `parent' depends on */
+static void
+package_manifest_read(PackageInstall *inst, const char *path, int parent)
+{
+	static const char *const keys[] = { "dependencies", "deps", NULL };
+	cJSON		*root, *deps, *item;
+	char		*buffer, spec[256];
+	long		 size;
+	FILE		*fp;
+	int		 i;
+
+	fp = fopen(path, "rb");
+	if (fp == NULL)
+		return;
+	fseek(fp, 0, SEEK_END);
+	size = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	if (size <= 0 || size > 1024 * 1024 ||
+	    (buffer = dog_malloc((size_t)size + 1)) == NULL) {
+		fclose(fp);
+		return;
+	}
+	buffer[fread(buffer, 1, (size_t)size, fp)] = '\0';
+	fclose(fp);
+	root = cJSON_Parse(buffer);
+	dog_free(buffer);
+	if (root == NULL) {
+		pr_warning(stdout, "cannot parse the manifest of %s",
+		    inst->run[parent].spec);
+		return;
+	}
+
+	for (i = 0; keys[i] != NULL; i++) {
+		deps = cJSON_GetObjectItem(root, keys[i]);
+		if (!cJSON_IsArray(deps))
+			continue;
+		cJSON_ArrayForEach(item, deps) {
+			if (!cJSON_IsString(item) ||
+			    !package_manifest_spec(item->valuestring, spec,
+			    sizeof(spec)))
+				continue;
+			pr_info(stdout, "%s needs %s", inst->run[parent].spec,
+			    item->valuestring);
+			package_graph_add(inst, spec, parent);
+		}
+	}
+	cJSON_Delete(root);
+}
+
+/* pawn.json at the top of an unpacked package or one directory down */
+static int
+package_manifest_find(const char *dir, char *path, size_t size)
+{
+	struct dirent	*dent;
+	DIR		*dirp;
+	int		 found = 0;
+
+	snprintf(path, size, "%s%spawn.json", dir, separator);
+	if (path_exists(path) == 1)
+		return (1);
+	dirp = opendir(dir);
+	if (dirp == NULL)
+		return (0);
+	while (!found && (dent = readdir(dirp)) != NULL) {
+		if (dog_dot_or_dotdot(dent->d_name))
+			continue;
+		snprintf(path, size, "%s%s%s%spawn.json", dir, separator,
+		    dent->d_name, separator);
+		found = path_exists(path) == 1;
+	}
+	closedir(dirp);
+	return (found);
+}
+
+/* unpacked, and all it needs is in place or has failed */
+static int
+package_install_waiting(const PackageInstall *inst, int i)
+{
+	const PackageNode	*node = &inst->node[i];
+	int			 j;
+
+	if (node->state != PACKAGE_NODE_FETCHED)
+		return (-1);
+	for (j = 0; j < node->nneeds; j++)
+		if (inst->node[node->needs[j]].state < PACKAGE_NODE_PLACED)
+			return (1);
+	return (0);
+}
+
+static void
+package_install_place(PackageInstall *inst, int i)
+{
+	PackageNode	*node = &inst->node[i];
+	const char	*location;
+
+	location = package_install_location(inst, node->dir);
+	if (location != NULL)
+		dog_apply_depends(node->dir, location);
+	node->state = PACKAGE_NODE_PLACED;
+}
+
+/*
+ * Move every unpacked package whose needs are all in place (or have
+ * failed) into the server tree.  At the end (`last') a package still
+ * waiting is on a cycle, which is broken at the first one.
+ */
+static void
+package_install_ready(PackageInstall *inst, int last)
+{
+	int	 i, moved;
+
+	for (;;) {
+		moved = 0;
+		for (i = 0; i < inst->count; i++)
+			if (package_install_waiting(inst, i) == 0) {
+				package_install_place(inst, i);
+				moved = 1;
+			}
+		if (moved)
+			continue;
+		if (!last)
+			break;
+		for (i = 0; i < inst->count; i++)
+			if (package_install_waiting(inst, i) == 1)
+				break;
+		if (i == inst->count)
+			break;
+		pr_warning(stdout, "dependency cycle through %s, "
+		    "installing it first", inst->run[i].spec);
+		package_install_place(inst, i);
+	}
+}
+
+/*
+ * Streaming install: entries go from the HTTP body to their place in
+ * the server tree as they are decoded, by the same rules as
+ * package_move_files -- .inc files at the top of the archive or one
+ * directory down go to the include directory, plugins/ to plugins --
+ * with components/ added for open.mp.
+ *
+ * The body is hashed as it streams, and its SHA-256 and size go into
+ * watchdogs.lock like a download's; a spec pinned there is always
+ * downloaded, so that it is checked before anything is unpacked.  No
+ * archive reaches the disk, so the archive cache is neither asked nor
+ * filled, and the files are placed as they arrive -- before the
+ * dependencies their pawn.json names, unlike a downloaded package.
+ */
+
+#define PACKAGE_ROUTE_INCLUDE	1
+#define PACKAGE_ROUTE_PLUGIN	2
+#define PACKAGE_ROUTE_COMPONENT	3
+#define PACKAGE_ROUTE_MANIFEST	4
+
+#define PACKAGE_STREAM_MANIFEST	".watchdogs/stream_manifest.json"
+
+typedef struct {
+	char		 includes[DOG_PATH_MAX * 2];
+	char		 plugins[DOG_PATH_MAX * 2];
+	char		 components[DOG_PATH_MAX * 2];
+	int		 kind;		/* route of the entry being extracted */
+	int		 placed;
+	PackageInstall	*inst;
+	int		 package;	/* index in inst */
+	int		 manifest;	/* pawn.json read already */
+} PackageRoute;
+
+/* which route, if any, an archive entry takes */
+static int
+package_route_kind(const char *entry)
+{
+	const char	*slash, *base, *ext;
+	size_t		 toplen;
+#ifdef DOG_WINDOWS
+	const char	*library = ".dll";
+#else
+	const char	*library = ".so";
+#endif
+
+	while (entry[0] == '.' && entry[1] == '/')
+		entry += 2;
+	base = strrchr(entry, '/');
+	base = (base != NULL) ? base + 1 : entry;
+	ext = strrchr(base, '.');
+	if (*base == '\0' || ext == NULL)
+		return (0);
+	slash = strchr(entry, '/');
+	toplen = (slash != NULL) ? (size_t)(slash - entry) : strlen(entry);
+
+	if (strcmp(base, "pawn.json") == 0 &&
+	    (slash == NULL || strchr(slash + 1, '/') == NULL))
+		return (PACKAGE_ROUTE_MANIFEST);
+
+	if (slash != NULL && strcmp(ext, library) == 0) {
+		if (toplen == 7 && strncmp(entry, "plugins", 7) == 0)
+			return (PACKAGE_ROUTE_PLUGIN);
+		if (toplen == 10 && strncmp(entry, "components", 10) == 0 &&
+		    fetch_server_env() == 2)
+			return (PACKAGE_ROUTE_COMPONENT);
+		return (0);
+	}
+
+	if (strcmp(ext, ".inc") != 0)
+		return (0);
+	if (slash != NULL) {
+		if (strchr(slash + 1, '/') != NULL)
+			return (0);
+		if ((toplen == 5 && (strncmp(entry, "pawno", 5) == 0 ||
+		    strncmp(entry, "qawno", 5) == 0)) ||
+		    (toplen == 7 && (strncmp(entry, "include", 7) == 0 ||
+		    strncmp(entry, "plugins", 7) == 0)) ||
+		    (toplen == 10 && strncmp(entry, "components", 10) == 0))
+			return (0);
+	}
+	return (PACKAGE_ROUTE_INCLUDE);
+}
+
+static int
+package_route_entry(void *udata, const char *entry, char *dest, size_t size)
+{
+	PackageRoute	*route = udata;
+	const char	*base;
+
+	route->kind = package_route_kind(entry);
+	if (route->kind == PACKAGE_ROUTE_MANIFEST && route->manifest)
+		route->kind = 0;
+	base = strrchr(entry, '/');
+	base = (base != NULL) ? base + 1 : entry;
+
+	switch (route->kind) {
+	case PACKAGE_ROUTE_MANIFEST:
+		snprintf(dest, size, "%s", PACKAGE_STREAM_MANIFEST);
+		break;
+	case PACKAGE_ROUTE_PLUGIN:
+		snprintf(dest, size, "%s%s%s", route->plugins, separator,
+		    base);
+		break;
+	case PACKAGE_ROUTE_COMPONENT:
+		snprintf(dest, size, "%s%s%s", route->components, separator,
+		    base);
+		break;
+	case PACKAGE_ROUTE_INCLUDE:
+		snprintf(dest, size, "%s%s%s", route->includes, separator,
+		    base);
+		break;
+	}
+	return (route->kind);
+}
+
+static void
+package_route_placed(void *udata, const char *entry __UNUSED__,
+    const char *dest)
+{
+	PackageRoute	*route = udata;
+	const char	*name;
+	char		*basename;
+
+	if (route->kind == PACKAGE_ROUTE_MANIFEST) {
+		route->manifest = 1;
+		package_manifest_read(route->inst, dest, route->package);
+		remove(dest);
+		return;
+	}
+	++route->placed;
+	dog_store_place(dest);
+	name = fetch_filename(dest);
+	if (route->kind == PACKAGE_ROUTE_INCLUDE) {
+		package_try_parsing(dest, dest);
+		package_include_prints(name);
+		pr_color(stdout, DOG_COL_YELLOW,
+		    " [M] Include %s -> %s\n", name, dest);
+		return;
+	}
+
+	basename = fetch_basename(dest);
+	pr_color(stdout, DOG_COL_CYAN, " [M] Plugins %s -> %s\n",
+	    basename ? basename : name,
+	    route->kind == PACKAGE_ROUTE_PLUGIN ? route->plugins :
+	    route->components);
+	snprintf(json_item, sizeof(json_item), "%s", name);
+	package_try_parsing(json_item, json_item);
+	if (basename != NULL && route->kind == PACKAGE_ROUTE_PLUGIN) {
+		if (fetch_server_env() == 1 &&
+		    strfind(dogconfig.dog_toml_server_config, ".cfg", true))
+			S_ADD_PLUGIN(dogconfig.dog_toml_server_config,
+			    "plugins", basename);
+		else if (fetch_server_env() == 2 &&
+		    strfind(dogconfig.dog_toml_server_config, ".json", true))
+			M_ADD_PLUGIN(dogconfig.dog_toml_server_config,
+			    basename);
+	}
+	dog_free(basename);
+}
+
+static int
+package_stream_install(PackageInstall *inst, int package, const char *url,
+    const char *package_name, const char *location)
+{
+	PackageRoute	 route;
+	PackageLock	*lock;
+	DogStream	*stream;
+	char		 sha256[SHA256_DIGEST_LENGTH * 2 + 1];
+	long long	 size = 0;
+	int		 ret;
+
+	memset(&route, 0, sizeof(route));
+	route.inst = inst;
+	route.package = package;
+	package_prepare_location(location);
+	snprintf(route.includes, sizeof(route.includes), "%s%s%s",
+	    location, separator,
+	    fetch_server_env() == 1 ? "pawno/include" : "qawno/include");
+	snprintf(route.plugins, sizeof(route.plugins), "%s%splugins",
+	    location, separator);
+	snprintf(route.components, sizeof(route.components),
+	    "%s%scomponents", location, separator);
+
+	pr_color(stdout, DOG_COL_GREEN, "* Streaming %s\n", package_name);
+	stream = dog_stream_open(url);
+	if (stream == NULL)
+		return (-1);
+	ret = dog_extract_stream(stream, package_route_entry,
+	    package_route_placed, &route);
+	if (dog_stream_close(stream, sha256, &size) != 0)
+		ret = -1;
+	if (ret == 0) {
+		lock = &inst->run[package];
+		snprintf(lock->sha256, sizeof(lock->sha256), "%s", sha256);
+		lock->size = size;
+	}
+	if (ret == 0)
+		pr_color(stdout, DOG_COL_GREEN,
+		    " %% successful: %d files from %s\n", route.placed,
+		    package_name);
+	print("\n");
+	return (ret);
+}
+
+/*
+ * Unpacking a downloaded archive writes only the files that
+ * package_move_files and package_manifest_find look at, picked by the
+ * rules of the streaming route; docs, examples and the like are never
+ * written.  `udata' is the package directory: an archive that wraps
+ * its contents in a directory of that name is unpacked into it as is
+ * (see arch_extraction_path), so the rules apply below that prefix.
+ * The files stay there until the package is placed, so that
+ * dependencies still go first.
+ */
+static int
+package_stage_entry(void *udata, const char *entry,
+    char *dest __UNUSED__, size_t size __UNUSED__)
+{
+	const char	*dir = udata;
+	size_t		 len = strlen(dir);
+
+	if (len > 0 && strncmp(entry, dir, len) == 0 && entry[len] == '/')
+		entry += len + 1;
+	return (package_route_kind(entry) ? ARCHIVE_ENTRY_KEEP : 0);
+}
+
+/*
+ * A package archive has finished downloading: unpack what will be used
+ * of it, queue what its manifest needs and move it into place once that
+ * is done, while the other downloads carry on.
+ */
+static void
+package_install_fetched(void *ctx, void *udata, const char *package_name,
+    const char *sha256, int ok)
+{
+	PackageInstall	*inst = ctx;
+	PackageLock	*lock = udata;
+	PackageNode	*node = &inst->node[lock - inst->run];
+	char		 size_filename[DOG_PATH_MAX], manifest[DOG_PATH_MAX * 2];
+	char		*extension;
+	int		 staged;
+
+	node->state = PACKAGE_NODE_FAILED;
+	if (ok && package_lock_verify(lock, package_name, sha256) != 0)
+		remove(package_name);
+	else if (ok) {
+		lock->installed = 1;
+
+		snprintf(size_filename, sizeof(size_filename), "%s",
+		    package_name);
+		if ((extension = strstr(size_filename, ".tar.gz")) != NULL)
+			*extension = '\0';
+		else if ((extension = strstr(size_filename, ".tar")) != NULL)
+			*extension = '\0';
+		else if ((extension = strstr(size_filename, ".zip")) != NULL)
+			*extension = '\0';
+
+		pr_color(stdout, DOG_COL_CYAN,
+		    " Try Extracting %s archive file...\n", package_name);
+		staged = dog_extract_filtered(package_name, size_filename,
+		    package_stage_entry, NULL, size_filename);
+		if (path_exists(package_name) == 1)
+			destroy_arch_dir(package_name);
+		if (staged < 0) {
+			lock->installed = 0;
+			destroy_arch_dir(size_filename);
+			package_install_ready(inst, 0);
+			return;
+		}
+
+		if (package_manifest_find(size_filename, manifest,
+		    sizeof(manifest)))
+			package_manifest_read(inst, manifest,
+			    (int)(lock - inst->run));
+		snprintf(node->dir, sizeof(node->dir), "%s", size_filename);
+		node->state = PACKAGE_NODE_FETCHED;
+	}
+	package_install_ready(inst, 0);
+}
+
+/* fill `r' from the repository object of its alias in a GraphQL answer */
+static void
+package_gh_answer(PackageGhRelease *r, const cJSON *repository)
+{
+	const cJSON	*release, *name, *nodes, *node, *url;
+
+	if (!cJSON_IsObject(repository))
+		return;		/* left to the REST API and its errors */
+	release = cJSON_GetObjectItem(repository,
+	    r->tag[0] ? "release" : "latestRelease");
+	r->found = 0;
+	if (!cJSON_IsObject(release))
+		return;
+	name = cJSON_GetObjectItem(release, "tagName");
+	if (!cJSON_IsString(name))
+		return;
+	snprintf(r->name, sizeof(r->name), "%s", name->valuestring);
+	r->found = 1;
+
+	nodes = cJSON_GetObjectItem(cJSON_GetObjectItem(release,
+	    "releaseAssets"), "nodes");
+	cJSON_ArrayForEach(node, nodes) {
+		if (r->nasset == PACKAGE_MAX_ASSETS)
+			break;
+		url = cJSON_GetObjectItem(node, "downloadUrl");
+		if (cJSON_IsString(url) &&
+		    (r->asset[r->nasset] = strdup(url->valuestring)) != NULL)
+			++r->nasset;
+	}
+}
+
+/*
+ * Ask GitHub once, through GraphQL, for the releases of the packages
+ * from `from' on, instead of a latest-tag and an assets request each.
+ * Needs a token; without one, or when the query fails, the REST API is
+ * asked as before.
+ */
+static void
+package_gh_prefetch(const PackageInstall *inst, const PackageSources *sources,
+    const PackageLocks *locks, int from)
+{
+	static const char	 fragment[] =
+	    "fragment R on Release{tagName "
+	    "releaseAssets(first:10){nodes{downloadUrl}}}query{";
+	struct _repositories	 repo;
+	PackageGhRelease	*r, *grow;
+	const char		*token = dogconfig.dog_toml_github_tokens;
+	char			 spec[256], alias[16];
+	char			*query, *json = NULL;
+	cJSON			*root, *data;
+	size_t			 len, size;
+	int			 i, first, answered = 0;
+
+	if (token == NULL || *token == '\0' || strfind(token, "DO_HERE", true))
+		return;
+	for (i = 0; i < sources->count; i++)
+		if (strcmp(sources->source[i], "github") == 0)
+			break;
+	if (i == sources->count || from >= inst->count)
+		return;
+
+	size = sizeof(fragment) + (size_t)(inst->count - from) * 512;
+	query = dog_malloc(size);
+	if (query == NULL)
+		return;
+	len = (size_t)snprintf(query, size, "%s", fragment);
+
+	first = package_gh_batch.count;
+	for (i = from; i < inst->count; i++) {
+		snprintf(spec, sizeof(spec), "%s", inst->run[i].spec);
+		/* without its host package_parse_repo would ask for one */
+		if (strstr(spec, "github.com") == NULL ||
+		    !package_parse_repo(spec, &repo) || repo.tag[0] == '\0')
+			continue;
+		if (!package_lock_update && package_lock_find(locks, spec))
+			continue;
+		if (strpbrk(repo.user, "\"\\") || strpbrk(repo.repo, "\"\\") ||
+		    strpbrk(repo.tag, "\"\\"))
+			continue;
+		if (strcmp(repo.tag, "newer") == 0)
+			repo.tag[0] = '\0';
+		for (grow = package_gh_batch.entry;
+		    grow < package_gh_batch.entry + package_gh_batch.count;
+		    grow++)
+			if (!strcasecmp(grow->user, repo.user) &&
+			    !strcasecmp(grow->repo, repo.repo) &&
+			    !strcmp(grow->tag, repo.tag))
+				break;
+		if (grow < package_gh_batch.entry + package_gh_batch.count)
+			continue;
+
+		grow = dog_realloc(package_gh_batch.entry,
+		    ((size_t)package_gh_batch.count + 1) * sizeof(*grow));
+		if (grow == NULL)
+			break;
+		package_gh_batch.entry = grow;
+		r = &grow[package_gh_batch.count];
+		memset(r, 0, sizeof(*r));
+		r->found = -1;
+		snprintf(r->user, sizeof(r->user), "%s", repo.user);
+		snprintf(r->repo, sizeof(r->repo), "%s", repo.repo);
+		snprintf(r->tag, sizeof(r->tag), "%s", repo.tag);
+		if (r->tag[0])
+			len += (size_t)snprintf(query + len, size - len,
+			    "r%d:repository(owner:\"%s\",name:\"%s\")"
+			    "{release(tagName:\"%s\"){...R}}",
+			    package_gh_batch.count, r->user, r->repo, r->tag);
+		else
+			len += (size_t)snprintf(query + len, size - len,
+			    "r%d:repository(owner:\"%s\",name:\"%s\")"
+			    "{latestRelease{...R}}",
+			    package_gh_batch.count, r->user, r->repo);
+		++package_gh_batch.count;
+	}
+	snprintf(query + len, size - len, "}");
+
+	if (package_gh_batch.count == first) {
+		dog_free(query);
+		return;
+	}
+
+	root = NULL;
+	if (package_gh_graphql(query, &json))
+		root = cJSON_Parse(json);
+	data = root ? cJSON_GetObjectItem(root, "data") : NULL;
+	for (i = first; i < package_gh_batch.count; i++) {
+		r = &package_gh_batch.entry[i];
+		snprintf(alias, sizeof(alias), "r%d", i);
+		if (cJSON_IsObject(data))
+			package_gh_answer(r, cJSON_GetObjectItem(data, alias));
+		if (r->found >= 0)
+			++answered;
+	}
+	if (answered > 0)
+		pr_info(stdout, "Resolved %d of %d GitHub releases in one query",
+		    answered, package_gh_batch.count - first);
+	else
+		pr_warning(stdout, "GitHub GraphQL query failed, "
+		    "asking for each release instead");
+
+	cJSON_Delete(root);
+	dog_free(json);
+	dog_free(query);
+}
+
+/*
+ * Packages are resolved one after another, but each download is queued
+ * as soon as its URL is known and the queue is kept moving between
+ * resolutions; unpacking starts as each download completes, and the
+ * dependencies its manifest names are resolved the same way.  Specs
+ * pinned in watchdogs.lock skip resolving unless --update was given;
+ * the others are looked up in the configured sources.
+ */
+void
+dog_install_depends(const char *packages, const char *branch, const char *where)
+{
+	char			 buffer[1024], package_url[1024],
+				 package_name[DOG_PATH_MAX];
+	char			*procure_buffer;
+	char			 fetched[MAX_DEPENDS][DOG_PATH_MAX],
+				 spec[256];
+	struct _repositories	 repo;
+	PackageInstall		 inst;
+	PackageLocks		 locks;
+	PackageSources		 sources;
+	PackageLock		*lock;
+	const PackageLock	*pinned;
+	DogFetch		*fetch = NULL;
+	int			 nfetched = 0, batched = 0, i, j;
+
+	memset(&inst, 0, sizeof(inst));
+	memset(&locks, 0, sizeof(locks));
+	memset(&sources, 0, sizeof(sources));
+	inst.where = where;
 
 	installing_package = true;
 
@@ -1662,47 +3131,74 @@ dog_install_depends(const char *packages, const char *branch, const char *where)
 		goto done;
 	}
 
+	inst.run = dog_calloc(MAX_DEPENDS, sizeof(PackageLock));
+	inst.node = dog_calloc(MAX_DEPENDS, sizeof(PackageNode));
+	fetch = dog_fetch_new(dogconfig.dog_toml_max_parallel);
+	if (inst.run == NULL || inst.node == NULL || fetch == NULL) {
+		pr_color(stdout, DOG_COL_RED, "");
+		printf("failed to initialize downloads!\t\t[X]\n");
+		goto done;
+	}
+
 	snprintf(buffer, sizeof(buffer), "%s", packages);
 
 	procure_buffer = strtok(buffer, " ");
-	while (procure_buffer && package_counts < MAX_DEPENDS) {
-		dependencies[package_counts++] = procure_buffer;
+	while (procure_buffer && inst.count < MAX_DEPENDS) {
+		package_graph_add(&inst, procure_buffer, -1);
 		procure_buffer = strtok(NULL, " ");
 	}
 
-	if (!package_counts) {
+	if (!inst.count) {
 		pr_color(stdout, DOG_COL_RED, "");
 		printf("no valid dependencies to install!\t\t[X]\n");
 		goto done;
 	}
 
-	for (i = 0; i < package_counts; i++) {
-		if (!package_parse_repo(dependencies[i], &repo)) {
+	package_lock_load(&locks);
+	package_sources_load(&sources);
+
+	/* the manifests of finished downloads keep adding packages */
+	for (i = 0;; i++) {
+		while (i == inst.count && dog_fetch_poll(fetch, 1000,
+		    package_install_fetched, &inst) > 0)
+			;
+		if (i == inst.count)
+			break;
+
+		/* each new wave of packages is resolved in one query */
+		if (i >= batched) {
+			package_gh_prefetch(&inst, &sources, &locks, i);
+			batched = inst.count;
+		}
+
+		lock = &inst.run[i];
+		inst.node[i].state = PACKAGE_NODE_FAILED;
+		snprintf(spec, sizeof(spec), "%s", lock->spec);
+		if (!package_parse_repo(spec, &repo)) {
 			pr_color(stdout, DOG_COL_RED, "");
-			printf("invalid repo format: %s\t\t[X]\n",
-			    dependencies[i]);
+			printf("invalid repo format: %s\t\t[X]\n", spec);
+			package_install_ready(&inst, 0);
 			continue;
 		}
 
-		if (!strcmp(repo.host, "github")) {
-			if (!package_handle_repo(&repo, package_url,
-			    sizeof(package_url), branch)) {
-				pr_color(stdout, DOG_COL_RED, "");
-				printf("repo not found: %s\t\t[X]\n",
-				    dependencies[i]);
-				continue;
-			}
-		} else {
-			package_build_repo_url(&repo, 0,
-			    package_url, sizeof(package_url));
-			if (!package_url_checking(package_url,
-			    dogconfig.dog_toml_github_tokens)) {
-				pr_color(stdout, DOG_COL_RED, "");
-				printf("repo not found: %s\t\t[X]\n",
-				    dependencies[i]);
-				continue;
-			}
+		pinned = package_lock_update ? NULL :
+		    package_lock_find(&locks, spec);
+
+		if (pinned != NULL) {
+			*lock = *pinned;
+			snprintf(package_url, sizeof(package_url), "%s",
+			    pinned->url);
+			pr_info(stdout, "Locked %s at %s", spec,
+			    pinned->tag[0] ? pinned->tag : pinned->url);
+		} else if (!package_resolve(&sources, &repo, branch,
+		    package_url, sizeof(package_url), lock->tag,
+		    sizeof(lock->tag))) {
+			pr_color(stdout, DOG_COL_RED, "");
+			printf("repo not found: %s\t\t[X]\n", spec);
+			package_install_ready(&inst, 0);
+			continue;
 		}
+		snprintf(lock->url, sizeof(lock->url), "%s", package_url);
 
 		if (strrchr(package_url, _PATH_CHR_SEP_POSIX) &&
 		    *(strrchr(package_url, _PATH_CHR_SEP_POSIX) + 1)) {
@@ -1724,100 +3220,70 @@ dog_install_depends(const char *packages, const char *branch, const char *where)
 			pr_color(stdout, DOG_COL_RED, "");
 			printf("invalid repo name: %s\t\t[X]\n",
 			    package_url);
+			package_install_ready(&inst, 0);
 			continue;
 		}
 
-		installing_package = true;
-
-		dog_download_file(package_url, package_name);
-		if (where == NULL || where[0] == '\0') {
-			if (!k) {
-				printf("\n"
-					   ".."
-					   "LIST OF DIRECTORY: "
-					   "%s", dog_procure_pwd());
-				fflush(stdout);
-				print("\n");
-
-				#ifdef DOG_LINUX
-				int tree_ret = -1;
-				{
-					char *tree[] = { "tree", ">", "/dev/null 2>&1", NULL };
-					tree_ret = dog_exec_command(tree);
-				}
-				if (!tree_ret) {
-					char *tree[] = { "tree", NULL };
-					dog_exec_command(tree);
-				}
-				else {
-					DIR *d = opendir(".");
-					if (d) {
-						struct dirent *de;
-						struct stat st;
-						char path[DOG_PATH_MAX];
-
-						while ((de = readdir(d)) != NULL) {
-							if (de->d_name[0] == '.')
-								continue;
-
-							snprintf(path, sizeof(path), "%s", de->d_name);
-							if (lstat(path, &st) == 0 && S_ISDIR(st.st_mode)) {
-								printf("%s\n", de->d_name);
-							}
-						}
-						closedir(d);
-					}
-				}
-				#else
-				hFind = FindFirstFileA(search, &ffd);
-				if (hFind != INVALID_HANDLE_VALUE) {
-					do {
-						if ((ffd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) &&
-							strcmp(ffd.cFileName, ".") != 0 &&
-							strcmp(ffd.cFileName, "..") != 0) {
-							printf("%s\n", ffd.cFileName);
-						}
-					} while (FindNextFileA(hFind, &ffd));
-					FindClose(hFind);
-				}
-				#endif
-
-				print("\n");
-				fflush(stdout);
-
-				printf(DOG_COL_BCYAN
-				    "Where do you want to install %s? "
-				    "(enter for: %s)" DOG_COL_DEFAULT,
-				    package_name, dog_procure_pwd());
-				fflush(stdout);
-
-				locations = readline(" ");
-				if (locations[0] == '\0' || locations[0] == '.') {
-					fetch_pwd = dog_procure_pwd();
-					init_location = strdup(fetch_pwd);
-					dog_apply_depends(package_name,
-					    fetch_pwd);
-					dog_free(locations);
-				} else {
-					if (dir_exists(locations) == 0)
-						dog_mkdir_recursive(locations);
-					init_location = strdup(locations);
-					dog_apply_depends(package_name,
-					    locations);
-					dog_free(locations);
-				}
-
-				k = true;
-			} else {
-				dog_apply_depends(package_name, init_location);
+		/* tag archives ("v1.0.zip") of two repos must not collide */
+		for (j = 0; j < nfetched; j++)
+			if (strcmp(fetched[j], package_name) == 0)
+				break;
+		if (j < nfetched) {
+			char	 unique[sizeof(package_name)];
+			int	 n;
+
+			n = snprintf(unique, sizeof(unique), "%s-%s",
+			    repo.repo, package_name);
+			if (n > 0 && (size_t)n < sizeof(unique))
+				memcpy(package_name, unique, (size_t)n + 1);
+		}
+		snprintf(fetched[nfetched++], DOG_PATH_MAX, "%s",
+		    package_name);
+
+		/* a locked checksum has to be checked before unpacking */
+		if (dogconfig.dog_toml_stream_extract &&
+		    is_archive_file(package_name) && lock->sha256[0] == '\0') {
+			const char	*location;
+
+			location = package_install_location(&inst,
+			    package_name);
+			if (location != NULL && package_stream_install(&inst,
+			    i, package_url, package_name, location) == 0) {
+				lock->installed = 1;
+				inst.node[i].state = PACKAGE_NODE_PLACED;
+				package_install_ready(&inst, 0);
+				continue;
 			}
-		} else {
-			if (dir_exists(where) == 0)
-				dog_mkdir_recursive(where);
-			dog_apply_depends(package_name, where);
+			pr_color(stdout, DOG_COL_YELLOW,
+			    " ~ streaming %s failed, downloading it instead\n",
+			    package_name);
+		}
+
+		if (dog_fetch_add(fetch, package_url, package_name,
+		    lock) != 0) {
+			pr_color(stdout, DOG_COL_RED, "");
+			printf("failed to queue %s\t\t[X]\n",
+			    package_name);
+			package_install_ready(&inst, 0);
+			continue;
 		}
+		inst.node[i].state = PACKAGE_NODE_QUEUED;
+		dog_fetch_poll(fetch, 0, package_install_fetched, &inst);
 	}
 
+	package_install_ready(&inst, 1);
+	package_include_flush();
+	package_lock_save(&locks, inst.run, inst.count);
+
 done:
+	dog_fetch_free(fetch);
+	dog_free(inst.run);
+	dog_free(inst.node);
+	dog_free(locks.entry);
+	package_sources_free(&sources);
+	package_gh_batch_free();
+	dog_free(inst.location);
+	package_lock_update = false;
+	installing_package = false;
 	return;
 }
@@ -23,7 +23,9 @@ struct _repositories {
 };
 
 extern bool installing_package;
+extern bool package_lock_update;
 
 void dog_install_depends(const char *packages, const char *branch, const char *where);
+void package_add_include(const char *modes, char *package_name, char *package_following);
 
 #endif
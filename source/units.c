@@ -16,6 +16,9 @@
 #include  "endpoint.h"
 #include  "compiler.h"
 #include  "replicate.h"
+#include  "amx.h"
+#include  "xref.h"
+#include  "cache.h"
 #include  "debug.h"
 #include  "units.h"
 
@@ -30,6 +33,8 @@ bool          unit_selection_stat = 0;
 static struct timespec cmd_start = { 0 };
 static struct timespec cmd_end = { 0 };
 static double command_dur;
+/* exit status of a command given on the command line (amx diff) */
+static int unit_exit_status = 0;
 
 static void
 cleanup_local_resources(char **ptr_prompt, char **ptr_command, 
@@ -376,6 +381,10 @@ _reexecute_command:
             } else if (strcmp(procure_args, "--save") == 0) {
                 procure_args = strtok(NULL, " ");
                 if (procure_args) raw_save = procure_args;
+            } else if (strcmp(procure_args, "--stream") == 0) {
+                dogconfig.dog_toml_stream_extract = 1;
+            } else if (strcmp(procure_args, "--update") == 0) {
+                package_lock_update = true;
             }
             procure_args = strtok(NULL, " ");
         }
@@ -598,82 +607,121 @@ _reexecute_command:
             goto cleanup;
         }
 
-        char *pawndisasm_ptr = NULL;
-        int   ret_pawndisasm = 0;
-        if (strcmp(dogconfig.dog_toml_os_type, OS_SIGNAL_WINDOWS) == 0) {
-            pawndisasm_ptr = "pawndisasm.exe";
-        } else if (strcmp(dogconfig.dog_toml_os_type, OS_SIGNAL_LINUX) == 0) {
-            pawndisasm_ptr = "pawndisasm";
-        }
+        char *args2 = strdup(args);
+        char *dot_amx = strstr(args2, ".amx");
+        if (dot_amx)
+            {
+                *dot_amx = '\0';
+            }
+        char s_args[DOG_PATH_MAX];
+        snprintf(s_args, sizeof(s_args), "%s.asm", args2);
+        dog_free(args2);
 
-        dog_sef_path_revert();
+        if (dog_amx_disasm(args, NULL, s_args, NULL) == 0)
+            println(stdout, "%s", s_args);
+        ret_code = -1;
+        goto cleanup;
 
-        if (dir_exists("pawno") != 0 && dir_exists("qawno") != 0) {
-            ret_pawndisasm = dog_find_path("pawno", pawndisasm_ptr,
-                NULL);
-            if (ret_pawndisasm) {
-                ;
-            } else {
-                ret_pawndisasm = dog_find_path("qawno",
-                    pawndisasm_ptr, NULL);
-                if (ret_pawndisasm < 1) {
-                    ret_pawndisasm = dog_find_path(".",
-                        pawndisasm_ptr, NULL);
-                }
-            }
-        } else if (dir_exists("pawno") != 0) {
-            ret_pawndisasm = dog_find_path("pawno", pawndisasm_ptr,
-                NULL);
-            if (ret_pawndisasm) {
-                ;
-            } else {
-                ret_pawndisasm = dog_find_path(".",
-                    pawndisasm_ptr, NULL);
+} else if (strncmp(ptr_command, "amx", strlen("amx")) == 0 &&
+               !isalpha((unsigned char)ptr_command[strlen("amx")])) {
+        dog_console_title("Watchdogs | @ amx");
+
+        char *args = ptr_command + strlen("amx");
+        while (*args == ' ') args++;
+
+        char *amx_sub = strtok(args, " ");
+        char *amx_file = strtok(NULL, " ");
+        char *amx_opt = strtok(NULL, " ");
+
+        if (amx_sub == NULL || amx_file == NULL) {
+            println(stdout, "Usage: amx info <file.amx> [publics|natives|pubvars|tags|overlays|header]");
+            println(stdout, "       amx disasm <file.amx> [-f <name,...>] [-o <out.asm>] [--split <dir>]");
+            println(stdout, "       amx diff <old.amx> <new.amx>");
+            ret_code = -1;
+            goto cleanup;
+        }
+
+        if (strcmp(amx_sub, "info") == 0) {
+            dog_amx_info(amx_file, amx_opt);
+        } else if (strcmp(amx_sub, "disasm") == 0) {
+            char *amx_funcs = NULL, *amx_out = NULL, *amx_split = NULL;
+            while (amx_opt != NULL) {
+                char *amx_val = strtok(NULL, " ");
+                if (strcmp(amx_opt, "-f") == 0)
+                    amx_funcs = amx_val;
+                else if (strcmp(amx_opt, "-o") == 0)
+                    amx_out = amx_val;
+                else if (strcmp(amx_opt, "--split") == 0)
+                    amx_split = amx_val;
+                else
+                    pr_warning(stdout, "amx: unknown option '%s'", amx_opt);
+                amx_opt = (amx_val != NULL) ? strtok(NULL, " ") : NULL;
             }
-        } else if (dir_exists("qawno") != 0) {
-            ret_pawndisasm = dog_find_path("qawno", pawndisasm_ptr,
-                NULL);
-            if (ret_pawndisasm) {
-                ;
+            dog_amx_disasm(amx_file, amx_funcs, amx_out, amx_split);
+        } else if (strcmp(amx_sub, "diff") == 0) {
+            /* like diff(1): 0 identical, 1 different, 2 trouble */
+            if (amx_opt == NULL) {
+                println(stdout, "Usage: amx diff <old.amx> <new.amx>");
+                unit_exit_status = 2;
             } else {
-                ret_pawndisasm = dog_find_path(".",
-                    pawndisasm_ptr, NULL);
+                int amx_diffs = dog_amx_diff(amx_file, amx_opt);
+                unit_exit_status = amx_diffs < 0 ? 2 : amx_diffs > 0;
             }
         } else {
-            ret_pawndisasm = dog_find_path(".", pawndisasm_ptr,
-                NULL);
+            println(stdout, "Usage: amx info <file.amx> [publics|natives|pubvars|tags|overlays|header]");
+            println(stdout, "       amx disasm <file.amx> [-f <name,...>] [-o <out.asm>] [--split <dir>]");
+            println(stdout, "       amx diff <old.amx> <new.amx>");
         }
-        if (ret_pawndisasm) {
+        ret_code = -1;
+        goto cleanup;
 
-            if (condition_check(dogconfig.dog_sef_found_list[0]) == 1) {
-                ret_code = -1;
-                goto cleanup;
-            }
+} else if (strncmp(ptr_command, "xref", strlen("xref")) == 0 &&
+               !isalpha((unsigned char)ptr_command[strlen("xref")])) {
+        dog_console_title("Watchdogs | @ xref");
 
-            char *args2 = strdup(args);
-            char *dot_amx = strstr(args2, ".amx");
-            if (dot_amx)
-                {
-                    *dot_amx = '\0';
-                }
-            char s_args[DOG_PATH_MAX];
-            snprintf(s_args, sizeof(s_args), "%s.asm", args2);
-            dog_free(args2);
-            char s_argv[DOG_PATH_MAX * 3];
-            #ifdef DOG_LINUX
-                char *executor = "sh -c";
-            #else
-                char *executor = "cmd.exe /C";
-            #endif
-            snprintf(s_argv, sizeof(s_argv),
-                "%s '%s %s %s'", executor, dogconfig.dog_sef_found_list[0], args, s_args);
-            char *argv[] = { s_argv, NULL };
-            int ret = dog_exec_command(argv);
-            if (!ret) println(stdout, "%s", s_args);
-            dog_console_title(s_argv);
+        char *args = ptr_command + strlen("xref");
+        while (*args == ' ') args++;
+
+        char *xref_sub = strtok(args, " ");
+        char *xref_arg = strtok(NULL, " ");
+
+        if (xref_sub == NULL) {
+            println(stdout, "Usage: xref who-calls|calls|where <symbol>");
+            println(stdout, "       xref unused [path-prefix]");
+            ret_code = -1;
+            goto cleanup;
+        }
+
+        dog_xref_query(xref_sub, xref_arg);
+        ret_code = -1;
+        goto cleanup;
+
+} else if (strncmp(ptr_command, "cache", strlen("cache")) == 0 &&
+               !isalpha((unsigned char)ptr_command[strlen("cache")])) {
+        dog_console_title("Watchdogs | @ cache");
+
+        char *args = ptr_command + strlen("cache");
+        while (*args == ' ') args++;
+
+        char *cache_sub = strtok(args, " ");
+        char *cache_arg = strtok(NULL, " ");
+
+        if (cache_sub != NULL && strcmp(cache_sub, "stats") == 0) {
+            dog_cache_stats();
+            dog_store_stats();
+        } else if (cache_sub != NULL && strcmp(cache_sub, "prune") == 0) {
+            long long limit = cache_arg ? strtoll(cache_arg, NULL, 10) * 1024 * 1024 : -1;
+            int removed = dog_cache_prune(limit);
+            if (removed < 0)
+                pr_info(stdout, "archive cache is off (archive_cache_max = 0)");
+            else
+                pr_info(stdout, "removed %d archive(s)", removed);
+            removed = dog_store_prune();
+            if (removed >= 0)
+                pr_info(stdout, "removed %d idle stored file(s)", removed);
         } else {
-            printf("\033[1;31merror:\033[0m pawndisasm/pawncc (our compiler) not found\n"
-                "  \033[2mhelp:\033[0m install it before continuing\n");
+            println(stdout, "Usage: cache stats");
+            println(stdout, "       cache prune [MB]");
         }
         ret_code = -1;
         goto cleanup;
@@ -1491,7 +1539,7 @@ main(int argc, char *argv[])
         dog_free(unit_size_prompt);
         unit_size_prompt = NULL;
 
-        return (0);
+        return (unit_exit_status);
     } else {
         unit_ret_main(NULL);
     }
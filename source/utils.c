@@ -11,14 +11,26 @@
 #include  "compiler.h"
 #include  "utils.h"
 
+#ifndef DOG_WINDOWS
+#include  <pthread.h>
+#include  <sys/ioctl.h>
+#endif
+#if defined(DOG_LINUX)
+#include  <sys/sendfile.h>
+#include  <sys/syscall.h>
+#if !defined(DOG_ANDROID)
+#include  <linux/fs.h>
+#endif
+#endif
+
 static char
 	command[DOG_MAX_PATH] = {0};
 
 const char	*unit_command_list[] = {
 	"help", "exit", "sha1", "sha256", "crc32", "djb2", "pbkdf2", "config",
 	"replicate", "gamemode", "pawncc", "debug",
-	"compile", "decompile", "running", "compiles", "stop", "restart",
-	"tracker", "compress", "send"
+	"compile", "decompile", "amx", "xref", "running", "compiles", "stop", "restart",
+	"tracker", "compress", "send", "cache"
 };
 
 const size_t	 unit_command_len = sizeof(unit_command_list) /
@@ -41,7 +53,13 @@ WatchdogConfig	 dogconfig = {
 	.dog_toml_packages      = NULL,
 	.dog_toml_proj_input    = NULL,
 	.dog_toml_proj_output   = NULL,
-	.dog_toml_webhooks      = NULL
+	.dog_toml_webhooks      = NULL,
+	.dog_toml_max_parallel  = 0,
+	.dog_toml_stream_extract = 0,
+	.dog_toml_http_cache_ttl = 600,
+	.dog_toml_archive_cache_max = 2048,
+	.dog_toml_download_segments = 4,
+	.dog_toml_link_store = 0
 };
 
 const char	*toml_char_field[] = {
@@ -776,6 +794,10 @@ void unit_show_help(const char *cmd)
 	"Usage: \"compile\" | [<args>] " DOG_COL_YELLOW "\n  ; Turn your code into something runnable!" DOG_COL_DEFAULT "\n"
 	"  decompile @ de-compile your project | "
 	"Usage: \"decompile\" | [<args>] " DOG_COL_YELLOW "\n  ; De-compile .amx into readable .asm." DOG_COL_DEFAULT "\n"
+	"  amx @ inspect a compiled .amx | "
+	"Usage: \"amx info|disasm|diff <file.amx>\" " DOG_COL_YELLOW "\n  ; Header, sizes, symbols, disassembly & build diffs without pawndisasm." DOG_COL_DEFAULT "\n"
+	"  xref @ query the symbol database | "
+	"Usage: \"xref who-calls|calls|where <symbol>\" | \"xref unused\" " DOG_COL_YELLOW "\n  ; Callers, callees & locations from \"compile --xref\"." DOG_COL_DEFAULT "\n"
 	"  running @ running your project | "
 	"Usage: \"running\" | [<args>] " DOG_COL_YELLOW "\n  ; Fire up your project and see it in action." DOG_COL_DEFAULT "\n"
 	"  compiles @ compile and running your project | "
@@ -789,7 +811,9 @@ void unit_show_help(const char *cmd)
 	"  compress @ create a compressed archive | "
 	"Usage: \"compress <input> <output>\" " DOG_COL_YELLOW "\n  ; Generates a compressed file (e.g., .zip/.tar.gz) from the specified source." DOG_COL_DEFAULT "\n"
 	"  send @ send file to Discord channel via webhook | "
-	"Usage: \"send <files>\" " DOG_COL_YELLOW "\n  ; Uploads a file directly to a Discord channel using a webhook." DOG_COL_DEFAULT "\n";
+	"Usage: \"send <files>\" " DOG_COL_YELLOW "\n  ; Uploads a file directly to a Discord channel using a webhook." DOG_COL_DEFAULT "\n"
+	"  cache @ shared archive cache | "
+	"Usage: \"cache stats\" | \"cache prune [MB]\" " DOG_COL_YELLOW "\n  ; Downloaded packages & compilers, reused across servers." DOG_COL_DEFAULT "\n";
 	fwrite(help_text, 1, strlen(help_text), stdout);
 	return;
 	}
@@ -811,13 +835,16 @@ void unit_show_help(const char *cmd)
 		{"debug", "debug: debugging & logging server debug. | Usage: \"debug\"\n\tKeep an eye on your server logs.\n"},
 		{"compile", "compile: compile your project. | Usage: \"compile\" | [<args>]\n\tTurn your code into something runnable!\n"},
 		{"decompile", "decompile: decompile your project. | Usage: \"decompile\" | [<args>]\n\tDecompile .amx -> .asm\n"},
+		{"amx", "amx: inspect a compiled .amx. | Usage: \"amx info <file.amx> [section]\" | \"amx disasm <file.amx> [-f <name,...>] [-o <out.asm>] [--split <dir>]\" | \"amx diff <old.amx> <new.amx>\"\n\tHeader, sizes, publics, natives, pubvars, tags & overlays.\n\tBuilt-in disassembler with per-function output.\n\tPer-function diff between two builds; exits 1 when they differ, 2 when either cannot be read.\n"},
+		{"xref", "xref: query the symbol database of \"compile --xref\". | Usage: \"xref who-calls <symbol>\" | \"xref calls <symbol>\" | \"xref where <symbol>\" | \"xref unused [path-prefix]\"\n\tCallers, callees and file:line from pawncc's -r report.\n"},
 		{"running", "running: running your project. | Usage: \"running\" | [<args>]\n\tFire up your project and see it in action.\n"},
 		{"compiles", "compiles: compile and running your project. | Usage: \"compiles\" | [<args>]\n\tTwo-in-one: compile then run immediately!\n"},
 		{"stop", "stop: stopped server task. | Usage: \"stop\"\n\tHalt everything! Stop your server tasks.\n"},
 		{"restart", "restart: re-start server task. | Usage: \"restart\"\n\tFresh start! Restart your server.\n"},
 		{"tracker", "tracker: account tracking. | Usage: \"tracker\" | [<args>]\n\tTrack accounts across platforms.\n"},
 		{"compress", "compress: create a compressed archive from a file or folder. | Usage: \"compress <input> <output>\"\n\tGenerates a compressed file (e.g., .zip/.tar.gz) from the specified source.\n"},
-		{"send", "send: send file to Discord channel via webhook. | Usage: \"send <files>\"\n\tUploads a file directly to a Discord channel using a webhook.\n"}
+		{"send", "send: send file to Discord channel via webhook. | Usage: \"send <files>\"\n\tUploads a file directly to a Discord channel using a webhook.\n"},
+		{"cache", "cache: shared archive cache. | Usage: \"cache stats\" | \"cache prune [MB]\"\n\tArchives downloaded by replicate, pawncc and the server installer.\n\tprune evicts the least recently used down to the limit (or MB)\n\tand drops link_store files unused for 30 days.\n"}
 	};
 
 	for (size_t i = 0; i < sizeof(cmd_help) / sizeof(cmd_help[0]); i++) {
@@ -841,7 +868,11 @@ void compiler_show_tip(void) {
     DOG_COL_BCYAN " o [--compact/-m]              * Use compact encoding\n"
     DOG_COL_BCYAN " o [--compat/-c]               * Active cross path separator\n"
     DOG_COL_BCYAN " o [--fast/-f]                 * Enable faster compilation mode\n"
-    DOG_COL_BCYAN " o [--clean/-n]                * Enable safe mode or clean mode\n";
+    DOG_COL_BCYAN " o [--clean/-n]                * Enable safe mode or clean mode\n"
+    DOG_COL_BCYAN " o [--inproc/-l]               * Compile via libpawnc.so, one fork per compile\n"
+    DOG_COL_BCYAN " o [--prune-includes/-u]       * Pass only the include paths used\n"
+    DOG_COL_BCYAN " o [--analyze/-z]              * Rank top-level includes by compile cost\n"
+    DOG_COL_BCYAN " o [--xref/-x]                 * Update the symbol cross-reference db\n";
     fwrite(tip_options, 1, strlen(tip_options), stdout);
     print_restore_color();
     return;
@@ -1936,6 +1967,13 @@ dog_sef_wmv(const char *c_src, const char *c_dest)
     if (!validate_src_dest(c_src, c_dest))
         return (1);
 
+    if (dog_file_move(c_src, c_dest) == 0) {
+        __set_default_access(c_dest);
+        pr_info(stdout, "moved: '%s' -> '%s'", c_src, c_dest);
+        return (0);
+    }
+
+    /* most likely a system directory: go through sudo/run0 */
     int super_mode = detect_super_mode();
 
     int ret = _run_file_operation("mv", c_src, c_dest, super_mode);
@@ -1961,6 +1999,12 @@ dog_sef_wcopy(const char *c_src, const char *c_dest)
     if (!validate_src_dest(c_src, c_dest))
         return (1);
 
+    if (dog_file_copy(c_src, c_dest) == 0) {
+        __set_default_access(c_dest);
+        pr_info(stdout, "copied: '%s' -> '%s'", c_src, c_dest);
+        return (0);
+    }
+
     int super_mode = detect_super_mode();
 
     int ret = _run_file_operation("cp", c_src, c_dest, super_mode);
@@ -1980,6 +2024,219 @@ dog_sef_wcopy(const char *c_src, const char *c_dest)
     return (1);
 }
 
+/*
+ * File moves and copies without a shell.  A move is a rename where
+ * source and destination share a file system; otherwise, as for a
+ * copy, the data goes into "<dest>.tmp" by the cheapest means the
+ * kernel offers -- a reflink, copy_file_range, sendfile, and plain
+ * reads and writes as the last resort -- with the mode and times of
+ * the source, and the temporary file is renamed into place.
+ */
+
+#ifndef DOG_WINDOWS
+
+#define DOG_FILE_WORKERS	4
+#define DOG_FILE_BATCH_MIN	8	/* fewer moves are not worth threads */
+
+static int
+file_copy_data(int in, int out, off_t size)
+{
+	char	 buf[65536];
+	off_t	 done = 0, off;
+	ssize_t	 n;
+
+#if defined(FICLONE)
+	if (size > 0 && ioctl(out, FICLONE, in) == 0)
+		return (0);
+#endif
+#if defined(SYS_copy_file_range)
+	while (done < size) {
+		n = (ssize_t)syscall(SYS_copy_file_range, in, NULL, out, NULL,
+		    (size_t)(size - done), 0);
+		if (n <= 0)
+			break;
+		done += n;
+	}
+#endif
+#if defined(DOG_LINUX)
+	while (done < size) {
+		off = done;
+		n = sendfile(out, in, &off, (size_t)(size - done));
+		if (n <= 0)
+			break;
+		done += n;
+	}
+#endif
+	if (lseek(in, done, SEEK_SET) < 0 || lseek(out, done, SEEK_SET) < 0)
+		return (-1);
+	while ((n = read(in, buf, sizeof(buf))) > 0) {
+		off = 0;
+		while (off < n) {
+			ssize_t	 w = write(out, buf + off, (size_t)(n - off));
+
+			if (w < 0 && errno == EINTR)
+				continue;
+			if (w <= 0)
+				return (-1);
+			off += w;
+		}
+	}
+	return (n < 0 ? -1 : 0);
+}
+
+#endif
+
+/*
+ * dog_file_copy
+ * Copy `src' over `dest', keeping its mode and times.  Returns 0, or
+ * -1 with errno set.
+ */
+int
+dog_file_copy(const char *src, const char *dest)
+{
+#ifdef DOG_WINDOWS
+	return (CopyFileA(src, dest, FALSE) ? 0 : -1);
+#else
+	char		 tmp[DOG_PATH_MAX + 8];
+	struct stat	 st;
+	struct timespec	 times[2];
+	int		 in, out, ret, saved;
+
+	if (snprintf(tmp, sizeof(tmp), "%s.tmp", dest) >= (int)sizeof(tmp)) {
+		errno = ENAMETOOLONG;
+		return (-1);
+	}
+	in = open(src, O_RDONLY);
+	if (in < 0)
+		return (-1);
+	if (fstat(in, &st) != 0 || !S_ISREG(st.st_mode)) {
+		close(in);
+		errno = EINVAL;
+		return (-1);
+	}
+	out = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, st.st_mode & 07777);
+	if (out < 0) {
+		saved = errno;
+		close(in);
+		errno = saved;
+		return (-1);
+	}
+
+	ret = file_copy_data(in, out, st.st_size);
+	if (ret == 0) {
+		fchmod(out, st.st_mode & 07777);
+		times[0] = st.st_atim;
+		times[1] = st.st_mtim;
+		futimens(out, times);
+	}
+	saved = errno;
+	close(in);
+	if (close(out) != 0 && ret == 0) {
+		ret = -1;
+		saved = errno;
+	}
+	if (ret == 0 && rename(tmp, dest) != 0) {
+		ret = -1;
+		saved = errno;
+	}
+	if (ret != 0) {
+		unlink(tmp);
+		errno = saved;
+	}
+	return (ret);
+#endif
+}
+
+/*
+ * dog_file_move
+ * Move `src' to `dest', replacing it.  Returns 0, or -1 with errno set.
+ */
+int
+dog_file_move(const char *src, const char *dest)
+{
+#ifdef DOG_WINDOWS
+	return (MoveFileExA(src, dest, MOVEFILE_REPLACE_EXISTING |
+	    MOVEFILE_COPY_ALLOWED) ? 0 : -1);
+#else
+	if (rename(src, dest) == 0)
+		return (0);
+	if (errno != EXDEV)
+		return (-1);
+	if (dog_file_copy(src, dest) != 0)
+		return (-1);
+	return (unlink(src) == 0 || errno == ENOENT ? 0 : -1);
+#endif
+}
+
+#ifndef DOG_WINDOWS
+
+typedef struct {
+	DogFileMove	*moves;
+	int		 count;
+	int		 next;
+	pthread_mutex_t	 lock;
+} FileMoveBatch;
+
+static void *
+file_move_worker(void *arg)
+{
+	FileMoveBatch	*batch = arg;
+	int		 i;
+
+	for (;;) {
+		pthread_mutex_lock(&batch->lock);
+		i = batch->next++;
+		pthread_mutex_unlock(&batch->lock);
+		if (i >= batch->count)
+			break;
+		batch->moves[i].ret = dog_file_move(batch->moves[i].src,
+		    batch->moves[i].dest);
+	}
+	return (NULL);
+}
+
+#endif
+
+/*
+ * dog_file_move_batch
+ * Run `count' moves, spread over a few threads when there are enough
+ * of them.  Each one's outcome is left in its `ret'; returns how many
+ * failed.
+ */
+int
+dog_file_move_batch(DogFileMove *moves, int count)
+{
+	int	 i, failed = 0;
+#ifndef DOG_WINDOWS
+	FileMoveBatch	 batch;
+	pthread_t	 workers[DOG_FILE_WORKERS];
+	int		 n = 0;
+
+	if (count >= DOG_FILE_BATCH_MIN) {
+		batch.moves = moves;
+		batch.count = count;
+		batch.next = 0;
+		pthread_mutex_init(&batch.lock, NULL);
+		for (n = 0; n < DOG_FILE_WORKERS; n++)
+			if (pthread_create(&workers[n], NULL,
+			    file_move_worker, &batch) != 0)
+				break;
+		/* whatever no thread could take is done here */
+		file_move_worker(&batch);
+		for (i = 0; i < n; i++)
+			pthread_join(workers[i], NULL);
+		pthread_mutex_destroy(&batch.lock);
+	} else
+#endif
+	for (i = 0; i < count; i++)
+		moves[i].ret = dog_file_move(moves[i].src, moves[i].dest);
+
+	for (i = 0; i < count; i++)
+		if (moves[i].ret != 0)
+			++failed;
+	return (failed);
+}
+
 static void
 dog_check_compiler_options(int *compatibility, int *optimized_lt)
 {
@@ -2272,6 +2529,13 @@ dog_generate_toml_content(FILE *file, const char *dog_os_type,
     fprintf(file, "# @dependencies settings\n");
 	fprintf(file, "[dependencies]\n");
 	fprintf(file, "   github_tokens = \"DO_HERE\" # github tokens\n");
+	fprintf(file, "   max_parallel = 4 # concurrent downloads\n");
+	fprintf(file, "   stream_extract = false # extract while downloading, bypasses the archive cache\n");
+	fprintf(file, "   http_cache_ttl = 600 # seconds API responses are reused, -1 off\n");
+	fprintf(file, "   archive_cache_max = 2048 # MB of shared archive cache, 0 off\n");
+	fprintf(file, "   download_segments = 4 # ranges fetched at once for large files\n");
+	fprintf(file, "   link_store = false # share installed files across servers by reflinks (btrfs, XFS; not ext4)\n");
+	fprintf(file, "   sources = [\"github\"] # or a mirror dir, file:// or http:// registry, in order\n");
 	fprintf(file,
 	    "   root_patterns = [\"lib\", \"log\", \"root\", " \
 	    "\"amx\", \"static\", \"dynamic\", \"cfg\", \"config\", " \
@@ -2298,6 +2562,8 @@ dog_configure_toml(void)
 	toml_array_t	*dog_toml_root_patterns;
 	toml_datum_t	 toml_gh_tokens, input_val, output_val;
 	toml_datum_t	 bin_val, conf_val, logs_val, webhooks_val;
+	toml_datum_t	 max_parallel, stream_extract, http_cache_ttl,
+			 archive_cache_max, download_segments, link_store;
 	size_t		 arr_sz;
 	char		*expect = NULL;
 	char        *buffer = NULL;
@@ -2396,6 +2662,33 @@ dog_configure_toml(void)
 			dog_free(toml_gh_tokens.u.s);
 		}
 
+		max_parallel = toml_int_in(dog_toml_depends, "max_parallel");
+		if (max_parallel.ok)
+			dogconfig.dog_toml_max_parallel =
+			    (int)max_parallel.u.i;
+		stream_extract = toml_bool_in(dog_toml_depends,
+		    "stream_extract");
+		if (stream_extract.ok)
+			dogconfig.dog_toml_stream_extract = stream_extract.u.b;
+		http_cache_ttl = toml_int_in(dog_toml_depends,
+		    "http_cache_ttl");
+		if (http_cache_ttl.ok)
+			dogconfig.dog_toml_http_cache_ttl =
+			    (int)http_cache_ttl.u.i;
+		archive_cache_max = toml_int_in(dog_toml_depends,
+		    "archive_cache_max");
+		if (archive_cache_max.ok)
+			dogconfig.dog_toml_archive_cache_max =
+			    (int)archive_cache_max.u.i;
+		download_segments = toml_int_in(dog_toml_depends,
+		    "download_segments");
+		if (download_segments.ok)
+			dogconfig.dog_toml_download_segments =
+			    (int)download_segments.u.i;
+		link_store = toml_bool_in(dog_toml_depends, "link_store");
+		if (link_store.ok)
+			dogconfig.dog_toml_link_store = link_store.u.b;
+
 		dog_toml_root_patterns = toml_array_in(dog_toml_depends,
 		    "root_patterns");
 		if (dog_toml_root_patterns) {
@@ -188,6 +188,12 @@ typedef struct {
     char * dog_toml_proj_output  ;
     char * dog_toml_github_tokens;
     char * dog_toml_webhooks     ;
+    int    dog_toml_max_parallel ;
+    int    dog_toml_stream_extract;
+    int    dog_toml_http_cache_ttl;
+    int    dog_toml_archive_cache_max;
+    int    dog_toml_download_segments;
+    int    dog_toml_link_store;
 } WatchdogConfig;
 
 extern WatchdogConfig dogconfig;
@@ -362,6 +368,16 @@ int dog_find_path(const char *sef_path, const char *sef_name, const char *ignore
 int dog_sef_wcopy(const char *c_src, const char *c_dest);
 int dog_sef_wmv(const char *c_src, const char *c_dest);
 
+typedef struct {
+    const char *src;
+    const char *dest;
+    int         ret;	/* 0 once moved */
+} DogFileMove;
+
+int dog_file_copy(const char *src, const char *dest);
+int dog_file_move(const char *src, const char *dest);
+int dog_file_move_batch(DogFileMove *moves, int count);
+
 int dog_configure_toml(void);
 
 # endif /* UTILS_H */
@@ -0,0 +1,756 @@
+/*-
+ * Copyright (c) 2026 Watchdogs Team and contributors
+ * All rights reserved. under The 2-Clause BSD License
+ * See COPYING or https://opensource.org/license/bsd-2-clause
+ */
+
+#include  "utils.h"
+#include  "debug.h"
+#include  "crypto.h"
+#include  "include.h"
+#include  "xref.h"
+
+/*
+ * Symbol cross-reference database.  pawncc's -r report lists every
+ * function, native, variable, constant and tag of a build together with
+ * the functions that refer to it; the #define names and the file:line
+ * of each declaration come from a walk over the include graph.  Both
+ * are folded into XREF_DB, a flat file of name-sorted symbol records,
+ * caller edges and a string table, so a query is one read and a binary
+ * search.  The database is always written out whole; what is saved is
+ * the input side: the report is re-read only when it changed and the
+ * sources walked only when one of the files recorded last time changed,
+ * the rest is carried over from the previous database.  Every offset
+ * and index in a database is checked against its header when it is
+ * read, a file that does not add up is treated as missing.
+ */
+
+#define XREF_MAGIC	"WDX1"
+#define XREF_BUCKETS	8192
+#define XREF_NONE	0xFFFFFFFFu
+
+enum {
+	XREF_F_NATIVE	= 1 << 0,
+	XREF_F_PUBLIC	= 1 << 1,
+	XREF_F_STOCK	= 1 << 2,
+	XREF_F_REPORT	= 1 << 3	/* listed by pawncc -r */
+};
+
+typedef struct {
+	char		 magic[4];
+	uint32_t	 nsyms;
+	uint32_t	 nedges;
+	uint32_t	 nfiles;
+	uint32_t	 strsize;
+	uint32_t	 reserved;
+	int64_t		 report_size;
+	int64_t		 report_mtime;
+} XrefHeader;
+
+typedef struct {
+	uint32_t	 path;		/* string offset */
+	uint32_t	 reserved;
+	int64_t		 size;
+	int64_t		 mtime;
+} XrefFileRec;
+
+typedef struct {
+	uint32_t	 name;		/* string offset */
+	uint32_t	 file;		/* XREF_NONE when unknown */
+	uint32_t	 line;
+	uint16_t	 kind;		/* 'M' 'F' 'C' 'T' from -r, 'D' #define */
+	uint16_t	 flags;
+	uint32_t	 edge;		/* first caller in the edge array */
+	uint32_t	 nedges;
+} XrefSymRec;
+
+/* database as read from disk */
+typedef struct {
+	char		*buf;
+	XrefHeader	*hdr;
+	XrefFileRec	*files;
+	XrefSymRec	*syms;
+	uint32_t	*edges;
+	const char	*str;
+} XrefDb;
+
+/* symbol while the database is being built */
+typedef struct {
+	char		*name;
+	int		 next;		/* hash chain */
+	int		 kind;
+	int		 flags;
+	int		 file;
+	int		 line;
+	int		*callers;
+	int		 ncallers;
+	uint32_t	 order;		/* index once sorted */
+} XrefSym;
+
+typedef struct {
+	XrefSym		*syms;
+	int		 nsyms;
+	int		 cap;
+	int		 buckets[XREF_BUCKETS];
+	char		**files;
+	int64_t		*file_size;
+	int64_t		*file_mtime;
+	int		 nfiles;
+	int		 cur_file;
+} XrefBuild;
+
+/* modification time in nanoseconds where the platform has them */
+static int64_t
+xref_mtime(const struct stat *st)
+{
+#ifdef DOG_LINUX
+	return ((int64_t)st->st_mtim.tv_sec * 1000000000 + st->st_mtim.tv_nsec);
+#else
+	return ((int64_t)st->st_mtime * 1000000000);
+#endif
+}
+
+static void
+xref_db_free(XrefDb *db)
+{
+	dog_free(db->buf);
+	memset(db, 0, sizeof(*db));
+}
+
+/* every string offset, file, symbol and edge index within bounds */
+static int
+xref_db_valid(const XrefDb *db)
+{
+	const XrefHeader *h = db->hdr;
+	uint32_t	 i;
+
+	if (h->strsize == 0)
+		return (h->nsyms == 0 && h->nfiles == 0);
+	if (db->str[h->strsize - 1] != '\0')
+		return (0);
+	for (i = 0; i < h->nfiles; i++)
+		if (db->files[i].path >= h->strsize)
+			return (0);
+	for (i = 0; i < h->nsyms; i++) {
+		const XrefSymRec *r = &db->syms[i];
+
+		if (r->name >= h->strsize ||
+		    (r->file != XREF_NONE && r->file >= h->nfiles) ||
+		    (uint64_t)r->edge + r->nedges > h->nedges)
+			return (0);
+	}
+	for (i = 0; i < h->nedges; i++)
+		if (db->edges[i] >= h->nsyms)
+			return (0);
+	return (1);
+}
+
+static int
+xref_db_load(XrefDb *db)
+{
+	FILE		*fp;
+	long		 size;
+	size_t		 need;
+
+	memset(db, 0, sizeof(*db));
+	fp = fopen(XREF_DB, "rb");
+	if (fp == NULL)
+		return (-1);
+	fseek(fp, 0, SEEK_END);
+	size = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	if (size < (long)sizeof(XrefHeader)) {
+		fclose(fp);
+		return (-1);
+	}
+	db->buf = dog_malloc((size_t)size);
+	if (db->buf == NULL ||
+	    fread(db->buf, 1, (size_t)size, fp) != (size_t)size) {
+		fclose(fp);
+		dog_free(db->buf);
+		db->buf = NULL;
+		return (-1);
+	}
+	fclose(fp);
+
+	db->hdr = (XrefHeader *)db->buf;
+	need = sizeof(XrefHeader) +
+	    (size_t)db->hdr->nfiles * sizeof(XrefFileRec) +
+	    (size_t)db->hdr->nsyms * sizeof(XrefSymRec) +
+	    (size_t)db->hdr->nedges * sizeof(uint32_t) + db->hdr->strsize;
+	if (memcmp(db->hdr->magic, XREF_MAGIC, 4) != 0 ||
+	    need != (size_t)size) {
+		dog_free(db->buf);
+		db->buf = NULL;
+		return (-1);
+	}
+	db->files = (XrefFileRec *)(db->hdr + 1);
+	db->syms = (XrefSymRec *)(db->files + db->hdr->nfiles);
+	db->edges = (uint32_t *)(db->syms + db->hdr->nsyms);
+	db->str = (const char *)(db->edges + db->hdr->nedges);
+	if (!xref_db_valid(db)) {
+		pr_warning(stdout, "xref: %s is damaged, ignoring it", XREF_DB);
+		xref_db_free(db);
+		return (-1);
+	}
+	return (0);
+}
+
+static long
+xref_db_find(const XrefDb *db, const char *name)
+{
+	long		 lo = 0, hi = (long)db->hdr->nsyms - 1, mid;
+	int		 c;
+
+	while (lo <= hi) {
+		mid = (lo + hi) / 2;
+		c = strcmp(db->str + db->syms[mid].name, name);
+		if (c == 0)
+			return (mid);
+		if (c < 0)
+			lo = mid + 1;
+		else
+			hi = mid - 1;
+	}
+	return (-1);
+}
+
+static int
+xref_sym(XrefBuild *b, const char *name, int create)
+{
+	uint32_t	 h;
+	int		 i;
+	XrefSym		*s;
+
+	h = crypto_string_hash(name) % XREF_BUCKETS;
+	for (i = b->buckets[h]; i >= 0; i = b->syms[i].next)
+		if (strcmp(b->syms[i].name, name) == 0)
+			return (i);
+	if (!create)
+		return (-1);
+
+	if (b->nsyms == b->cap) {
+		int	 cap = b->cap ? b->cap * 2 : 1024;
+		XrefSym	*grow = dog_realloc(b->syms,
+		    (size_t)cap * sizeof(XrefSym));
+		if (grow == NULL)
+			return (-1);
+		b->syms = grow;
+		b->cap = cap;
+	}
+	s = &b->syms[b->nsyms];
+	memset(s, 0, sizeof(*s));
+	s->name = strdup(name);
+	if (s->name == NULL)
+		return (-1);
+	s->file = -1;
+	s->next = b->buckets[h];
+	b->buckets[h] = b->nsyms;
+	return (b->nsyms++);
+}
+
+static void
+xref_edge(XrefBuild *b, int callee, int caller)
+{
+	XrefSym		*s = &b->syms[callee];
+	int		*grow, i;
+
+	for (i = 0; i < s->ncallers; i++)
+		if (s->callers[i] == caller)
+			return;
+	grow = dog_realloc(s->callers, (size_t)(s->ncallers + 1) * sizeof(int));
+	if (grow == NULL)
+		return;
+	s->callers = grow;
+	s->callers[s->ncallers++] = caller;
+}
+
+static int
+xref_add_file(XrefBuild *b, const char *path, int64_t size, int64_t mtime)
+{
+	char		**gp;
+	int64_t		*gs, *gm;
+
+	gp = dog_realloc(b->files, (size_t)(b->nfiles + 1) * sizeof(char *));
+	if (gp == NULL)
+		return (-1);
+	b->files = gp;
+	gs = dog_realloc(b->file_size,
+	    (size_t)(b->nfiles + 1) * sizeof(int64_t));
+	if (gs == NULL)
+		return (-1);
+	b->file_size = gs;
+	gm = dog_realloc(b->file_mtime,
+	    (size_t)(b->nfiles + 1) * sizeof(int64_t));
+	if (gm == NULL)
+		return (-1);
+	b->file_mtime = gm;
+	b->files[b->nfiles] = strdup(path);
+	b->file_size[b->nfiles] = size;
+	b->file_mtime[b->nfiles] = mtime;
+	return (b->nfiles++);
+}
+
+static void
+xref_build_free(XrefBuild *b)
+{
+	int		 i;
+
+	for (i = 0; i < b->nsyms; i++) {
+		dog_free(b->syms[i].name);
+		dog_free(b->syms[i].callers);
+	}
+	for (i = 0; i < b->nfiles; i++)
+		dog_free(b->files[i]);
+	dog_free(b->syms);
+	dog_free(b->files);
+	dog_free(b->file_size);
+	dog_free(b->file_mtime);
+}
+
+/* value of attribute `attr' in `line', copied to `out' */
+static int
+xref_attr(const char *line, const char *attr, char *out, size_t size)
+{
+	const char	*p;
+	size_t		 n;
+
+	p = strstr(line, attr);
+	if (p == NULL)
+		return (0);
+	p += strlen(attr);
+	for (n = 0; p[n] != '\0' && p[n] != '"' && n + 1 < size; n++)
+		out[n] = p[n];
+	out[n] = '\0';
+	return (n > 0);
+}
+
+/*
+ * Stream the -r report line by line; pawncc writes one element per
+ * line, so the report is never held in memory as a whole.
+ */
+static int
+xref_read_report(XrefBuild *b, const char *path)
+{
+	FILE		*fp;
+	char		 line[4096], name[256], *p;
+	int		 cur = -1, n = 0;
+
+	fp = fopen(path, "r");
+	if (fp == NULL)
+		return (-1);
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		p = line;
+		while (*p == ' ' || *p == '\t')
+			++p;
+		if (strncmp(p, "<member ", 8) == 0) {
+			cur = -1;
+			if (!xref_attr(p, "name=\"", name, sizeof(name)) ||
+			    name[1] != ':')
+				continue;
+			name[strcspn(name, "(")] = '\0';
+			cur = xref_sym(b, name + 2, 1);
+			if (cur < 0)
+				continue;
+			b->syms[cur].kind = name[0];
+			b->syms[cur].flags |= XREF_F_REPORT;
+			++n;
+			/* <member name="..." value="..."/> has no body */
+			p[strcspn(p, "\r\n")] = '\0';
+			if (strlen(p) >= 2 && strcmp(p + strlen(p) - 2, "/>") == 0)
+				cur = -1;
+		} else if (cur >= 0 && strncmp(p, "</member>", 9) == 0) {
+			cur = -1;
+		} else if (cur >= 0 && strncmp(p, "<referrer ", 10) == 0) {
+			int	 caller;
+
+			if (!xref_attr(p, "name=\"", name, sizeof(name)))
+				continue;
+			caller = xref_sym(b, name, 1);
+			if (caller >= 0)
+				xref_edge(b, cur, caller);
+		} else if (cur >= 0 && strncmp(p, "<dependency ", 12) == 0) {
+			int	 callee;
+
+			if (!xref_attr(p, "name=\"", name, sizeof(name)))
+				continue;
+			callee = xref_sym(b, name, 1);
+			if (callee >= 0)
+				xref_edge(b, callee, cur);
+		} else if (cur >= 0 && strncmp(p, "<attribute ", 11) == 0) {
+			if (!xref_attr(p, "name=\"", name, sizeof(name)))
+				continue;
+			if (strcmp(name, "native") == 0)
+				b->syms[cur].flags |= XREF_F_NATIVE;
+			else if (strcmp(name, "public") == 0)
+				b->syms[cur].flags |= XREF_F_PUBLIC;
+			else if (strcmp(name, "stock") == 0)
+				b->syms[cur].flags |= XREF_F_STOCK;
+		}
+	}
+	fclose(fp);
+	return (n);
+}
+
+static void
+xref_decl(void *udata, const char *file, int line, const char *name,
+    int kind)
+{
+	XrefBuild	*b = udata;
+	struct stat	 st;
+	int		 i;
+
+	if (name == NULL) {
+		if (stat(file, &st) != 0)
+			return;
+		b->cur_file = xref_add_file(b, file, (int64_t)st.st_size,
+		    xref_mtime(&st));
+		return;
+	}
+	i = xref_sym(b, name, kind == INCLUDE_DECL_DEFINE);
+	if (i < 0 || b->syms[i].file >= 0)
+		return;
+	if (b->syms[i].kind == 0)
+		b->syms[i].kind = 'D';
+	b->syms[i].file = b->cur_file;
+	b->syms[i].line = line;
+}
+
+/* true when every source recorded in `db' is as it was */
+static int
+xref_sources_unchanged(const XrefDb *db)
+{
+	struct stat	 st;
+	uint32_t	 i;
+
+	if (db->buf == NULL || db->hdr->nfiles == 0)
+		return (0);
+	for (i = 0; i < db->hdr->nfiles; i++) {
+		if (stat(db->str + db->files[i].path, &st) != 0 ||
+		    (int64_t)st.st_size != db->files[i].size ||
+		    xref_mtime(&st) != db->files[i].mtime)
+			return (0);
+	}
+	return (1);
+}
+
+static void
+xref_import(XrefBuild *b, const XrefDb *db, int report, int sources)
+{
+	uint32_t	 i, e;
+	int		 s, c;
+
+	if (sources)
+		for (i = 0; i < db->hdr->nfiles; i++)
+			xref_add_file(b, db->str + db->files[i].path,
+			    db->files[i].size, db->files[i].mtime);
+
+	for (i = 0; i < db->hdr->nsyms; i++) {
+		const XrefSymRec *r = &db->syms[i];
+		int		 from_report = (r->flags & XREF_F_REPORT) != 0;
+		int		 want_report = report && from_report;
+		int		 want_loc = sources && r->file != XREF_NONE;
+
+		if (!want_report && !want_loc && !(sources && !from_report))
+			continue;
+		s = xref_sym(b, db->str + r->name, 1);
+		if (s < 0)
+			continue;
+		if (want_report) {
+			b->syms[s].kind = r->kind;
+			b->syms[s].flags = r->flags;
+			for (e = 0; e < r->nedges; e++) {
+				c = xref_sym(b,
+				    db->str + db->syms[db->edges[r->edge + e]].name, 1);
+				if (c >= 0)
+					xref_edge(b, s, c);
+			}
+		} else if (b->syms[s].kind == 0 && !from_report)
+			b->syms[s].kind = r->kind;
+		if (want_loc) {
+			b->syms[s].file = (int)r->file;
+			b->syms[s].line = (int)r->line;
+		}
+	}
+}
+
+static XrefBuild *xref_sort_ctx;
+
+static int
+xref_sort_cmp(const void *a, const void *b)
+{
+	return (strcmp(xref_sort_ctx->syms[*(const int *)a].name,
+	    xref_sort_ctx->syms[*(const int *)b].name));
+}
+
+static int
+xref_write(XrefBuild *b, const struct stat *report)
+{
+	FILE		*fp;
+	XrefHeader	 hdr;
+	int		*order = NULL;
+	uint32_t	 strsize = 0, nedges = 0, off;
+	int		 i, j, ret = -1;
+
+	order = dog_malloc((size_t)(b->nsyms + 1) * sizeof(int));
+	if (order == NULL)
+		return (-1);
+	for (i = 0; i < b->nsyms; i++)
+		order[i] = i;
+	xref_sort_ctx = b;
+	qsort(order, (size_t)b->nsyms, sizeof(int), xref_sort_cmp);
+	for (i = 0; i < b->nsyms; i++) {
+		b->syms[order[i]].order = (uint32_t)i;
+		nedges += (uint32_t)b->syms[i].ncallers;
+		strsize += (uint32_t)strlen(b->syms[i].name) + 1;
+	}
+	for (i = 0; i < b->nfiles; i++)
+		strsize += (uint32_t)strlen(b->files[i]) + 1;
+
+	fp = fopen(XREF_DB ".tmp", "wb");
+	if (fp == NULL) {
+		pr_error(stdout, "xref: cannot write %s: %s", XREF_DB,
+		    strerror(errno));
+		goto done;
+	}
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, XREF_MAGIC, 4);
+	hdr.nsyms = (uint32_t)b->nsyms;
+	hdr.nedges = nedges;
+	hdr.nfiles = (uint32_t)b->nfiles;
+	hdr.strsize = strsize;
+	hdr.report_size = (int64_t)report->st_size;
+	hdr.report_mtime = xref_mtime(report);
+	fwrite(&hdr, sizeof(hdr), 1, fp);
+
+	/* strings: files first, then symbol names in sorted order */
+	off = 0;
+	for (i = 0; i < b->nfiles; i++) {
+		XrefFileRec	 fr;
+
+		memset(&fr, 0, sizeof(fr));
+		fr.path = off;
+		fr.size = b->file_size[i];
+		fr.mtime = b->file_mtime[i];
+		fwrite(&fr, sizeof(fr), 1, fp);
+		off += (uint32_t)strlen(b->files[i]) + 1;
+	}
+	nedges = 0;
+	for (i = 0; i < b->nsyms; i++) {
+		XrefSym		*s = &b->syms[order[i]];
+		XrefSymRec	 r;
+
+		memset(&r, 0, sizeof(r));
+		r.name = off;
+		r.file = (s->file >= 0) ? (uint32_t)s->file : XREF_NONE;
+		r.line = (uint32_t)s->line;
+		r.kind = (uint16_t)(s->kind ? s->kind : '?');
+		r.flags = (uint16_t)s->flags;
+		r.edge = nedges;
+		r.nedges = (uint32_t)s->ncallers;
+		fwrite(&r, sizeof(r), 1, fp);
+		off += (uint32_t)strlen(s->name) + 1;
+		nedges += (uint32_t)s->ncallers;
+	}
+	for (i = 0; i < b->nsyms; i++) {
+		XrefSym		*s = &b->syms[order[i]];
+
+		for (j = 0; j < s->ncallers; j++) {
+			uint32_t e = b->syms[s->callers[j]].order;
+			fwrite(&e, sizeof(e), 1, fp);
+		}
+	}
+	for (i = 0; i < b->nfiles; i++)
+		fwrite(b->files[i], strlen(b->files[i]) + 1, 1, fp);
+	for (i = 0; i < b->nsyms; i++)
+		fwrite(b->syms[order[i]].name,
+		    strlen(b->syms[order[i]].name) + 1, 1, fp);
+
+	if (fclose(fp) != 0 || rename(XREF_DB ".tmp", XREF_DB) != 0) {
+		pr_error(stdout, "xref: cannot write %s: %s", XREF_DB,
+		    strerror(errno));
+		remove(XREF_DB ".tmp");
+		goto done;
+	}
+	ret = 0;
+done:
+	dog_free(order);
+	return (ret);
+}
+
+/*
+ * dog_xref_update
+ * Fold the -r report of the last build into XREF_DB.  `flags' holds
+ * the pawncc options of that build, for the include search paths.
+ */
+int
+dog_xref_update(const char *pawncc_path, const char *input_path,
+    const char *flags)
+{
+	XrefBuild	*b;
+	XrefDb		 old;
+	struct stat	 report;
+	int		 report_changed, sources_changed, ret = -1;
+	long		 i;
+
+	if (stat(XREF_REPORT, &report) != 0) {
+		pr_warning(stdout, "xref: pawncc wrote no report (%s)",
+		    XREF_REPORT);
+		return (-1);
+	}
+
+	xref_db_load(&old);
+	report_changed = old.buf == NULL ||
+	    old.hdr->report_size != (int64_t)report.st_size ||
+	    old.hdr->report_mtime != xref_mtime(&report);
+	sources_changed = !xref_sources_unchanged(&old);
+	if (!report_changed && !sources_changed) {
+		pr_info(stdout, "xref: %s is up to date", XREF_DB);
+		xref_db_free(&old);
+		return (0);
+	}
+
+	b = dog_calloc(1, sizeof(*b));
+	if (b == NULL) {
+		xref_db_free(&old);
+		return (-1);
+	}
+	for (i = 0; i < XREF_BUCKETS; i++)
+		b->buckets[i] = -1;
+	b->cur_file = -1;
+
+	if (old.buf != NULL)
+		xref_import(b, &old, !report_changed, !sources_changed);
+	if (report_changed && xref_read_report(b, XREF_REPORT) < 0)
+		pr_warning(stdout, "xref: cannot read %s", XREF_REPORT);
+	if (sources_changed)
+		dog_include_declarations(pawncc_path, input_path, flags,
+		    xref_decl, b);
+
+	if (xref_write(b, &report) == 0) {
+		long nedges = 0;
+		for (i = 0; i < b->nsyms; i++)
+			nedges += b->syms[i].ncallers;
+		pr_info(stdout, "xref: %d symbols, %ld references, "
+		    "%d files%s%s", b->nsyms, nedges, b->nfiles,
+		    report_changed ? "" : " (report unchanged)",
+		    sources_changed ? "" : " (sources unchanged)");
+		ret = 0;
+	}
+	xref_build_free(b);
+	dog_free(b);
+	xref_db_free(&old);
+	return (ret);
+}
+
+static void
+xref_print_sym(const XrefDb *db, uint32_t i)
+{
+	const XrefSymRec *r = &db->syms[i];
+
+	printf("   %-32s ", db->str + r->name);
+	if (r->file != XREF_NONE && r->file < db->hdr->nfiles)
+		printf("%s:%u", db->str + db->files[r->file].path, r->line);
+	else
+		printf("-");
+	printf("\n");
+}
+
+static const char *
+xref_kind_name(const XrefSymRec *r)
+{
+	if (r->flags & XREF_F_NATIVE)
+		return ("native");
+	if (r->flags & XREF_F_PUBLIC)
+		return ("public");
+	switch (r->kind) {
+	case 'M': return ("function");
+	case 'F': return ("variable");
+	case 'C': return ("constant");
+	case 'T': return ("tag");
+	case 'D': return ("define");
+	}
+	return ("symbol");
+}
+
+/*
+ * dog_xref_query
+ * who-calls <name> | calls <name> | where <name> | unused [path-prefix]
+ */
+int
+dog_xref_query(const char *query, const char *arg)
+{
+	XrefDb		 db;
+	long		 s;
+	uint32_t	 i, e, n = 0;
+
+	if (xref_db_load(&db) != 0) {
+		pr_error(stdout, "xref: no database, build with "
+		    "\"compile --xref\" first");
+		return (-1);
+	}
+
+	if (strcmp(query, "unused") == 0) {
+		for (i = 0; i < db.hdr->nsyms; i++) {
+			const XrefSymRec *r = &db.syms[i];
+			const char	*name = db.str + r->name;
+
+			if (r->kind != 'M' || r->nedges != 0 ||
+			    !(r->flags & XREF_F_REPORT) ||
+			    (r->flags & (XREF_F_NATIVE | XREF_F_PUBLIC)) ||
+			    strcmp(name, "main") == 0 || name[0] == '@')
+				continue;
+			if (arg != NULL && (r->file == XREF_NONE ||
+			    strncmp(db.str + db.files[r->file].path, arg,
+			    strlen(arg)) != 0))
+				continue;
+			xref_print_sym(&db, i);
+			++n;
+		}
+		println(stdout, " %u unreferenced function(s)", n);
+		xref_db_free(&db);
+		return (0);
+	}
+
+	if (arg == NULL) {
+		println(stdout, "Usage: xref who-calls|calls|where <symbol>");
+		xref_db_free(&db);
+		return (-1);
+	}
+	s = xref_db_find(&db, arg);
+	if (s < 0) {
+		pr_error(stdout, "xref: '%s' is not in %s", arg, XREF_DB);
+		xref_db_free(&db);
+		return (-1);
+	}
+
+	if (strcmp(query, "who-calls") == 0) {
+		const XrefSymRec *r = &db.syms[s];
+
+		for (e = 0; e < r->nedges; e++)
+			xref_print_sym(&db, db.edges[r->edge + e]);
+		println(stdout, " %u caller(s) of %s", r->nedges, arg);
+	} else if (strcmp(query, "calls") == 0) {
+		for (i = 0; i < db.hdr->nsyms; i++) {
+			const XrefSymRec *r = &db.syms[i];
+
+			for (e = 0; e < r->nedges; e++) {
+				if (db.edges[r->edge + e] != (uint32_t)s)
+					continue;
+				xref_print_sym(&db, i);
+				++n;
+				break;
+			}
+		}
+		println(stdout, " %s refers to %u symbol(s)", arg, n);
+	} else if (strcmp(query, "where") == 0) {
+		printf("   %s (%s, %u caller(s))\n", arg,
+		    xref_kind_name(&db.syms[s]), db.syms[s].nedges);
+		xref_print_sym(&db, (uint32_t)s);
+	} else {
+		println(stdout, "Usage: xref who-calls|calls|where <symbol>");
+		println(stdout, "       xref unused [path-prefix]");
+	}
+	xref_db_free(&db);
+	return (0);
+}
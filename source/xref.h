@@ -0,0 +1,19 @@
+/*-
+ * Copyright (c) 2026 Watchdogs Team and contributors
+ * All rights reserved. under The 2-Clause BSD License
+ * See COPYING or https://opensource.org/license/bsd-2-clause
+ */
+
+#ifndef XREF_H
+#define XREF_H
+
+#include "utils.h"
+
+#define XREF_REPORT ".watchdogs/xref.xml"
+#define XREF_DB     ".watchdogs/xref.db"
+
+int dog_xref_update(const char *pawncc_path, const char *input_path,
+                    const char *flags);
+int dog_xref_query(const char *query, const char *arg);
+
+#endif
@@ -0,0 +1,400 @@
+/*-
+ * Copyright (c) 2026 Watchdogs Team and contributors
+ * All rights reserved. under The 2-Clause BSD License
+ * See COPYING or https://opensource.org/license/bsd-2-clause
+ */
+
+/*
+ * Segmented, resumed and streamed downloads against a loopback HTTP
+ * stand-in.  The server runs in a thread on 127.0.0.1, serves one body
+ * with byte ranges, an ETag and If-Range, and can cut answers short to
+ * act like a broken connection.  curl.c is built into the test so its
+ * static download helpers can be driven directly.
+ */
+
+#include "../source/curl.c"
+
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <pthread.h>
+
+#undef main
+
+#define STUB_SIZE	((size_t)9 * 1024 * 1024 + 123)
+#define STUB_ETAG	"\"stub-v1\""
+
+enum {
+	STUB_WHOLE,		/* every answer complete */
+	STUB_BREAK_ONCE,	/* the next answer is cut short */
+	STUB_BREAK_ALWAYS	/* every answer is cut short */
+};
+
+static unsigned char	*stub_body;
+static int		 stub_port;
+static int		 stub_mode;
+static int		 stub_broken;
+static char		 stub_range[128];	/* of the last GET */
+static char		 stub_if_range[128];
+static char		 stub_auth[128];
+static int		 failures;
+
+#define CHECK(cond, what) do {						\
+	if (!(cond)) {							\
+		fprintf(stderr, "FAIL %s:%d: %s\n", __FILE__, __LINE__,	\
+		    what);						\
+		++failures;						\
+	}								\
+} while (0)
+
+static void
+stub_header(const char *req, const char *name, char *out, size_t size)
+{
+	const char	*p, *end;
+	size_t		 n = strlen(name);
+
+	out[0] = '\0';
+	for (p = strstr(req, "\r\n"); p != NULL; p = strstr(p + 2, "\r\n")) {
+		if (strncasecmp(p + 2, name, n) != 0 || p[2 + n] != ':')
+			continue;
+		p += 2 + n + 1;
+		while (*p == ' ')
+			++p;
+		end = strstr(p, "\r\n");
+		if (end == NULL || (size_t)(end - p) >= size)
+			return;
+		memcpy(out, p, (size_t)(end - p));
+		out[end - p] = '\0';
+		return;
+	}
+}
+
+static void
+stub_send(int fd, const void *data, size_t len)
+{
+	const char	*p = data;
+	ssize_t		 w;
+
+	while (len > 0 && (w = send(fd, p, len, MSG_NOSIGNAL)) > 0) {
+		p += w;
+		len -= (size_t)w;
+	}
+}
+
+static void
+stub_serve(int fd)
+{
+	char		 req[4096], head[512], range[128], if_range[128];
+	size_t		 got = 0, start = 0, end = STUB_SIZE - 1, len;
+	ssize_t		 n;
+	int		 ranged, head_only;
+
+	while (got < sizeof(req) - 1 &&
+	    (n = recv(fd, req + got, sizeof(req) - 1 - got, 0)) > 0) {
+		got += (size_t)n;
+		req[got] = '\0';
+		if (strstr(req, "\r\n\r\n") != NULL)
+			break;
+	}
+	if (got == 0)
+		return;
+	req[got] = '\0';
+	head_only = strncmp(req, "HEAD ", 5) == 0;
+	stub_header(req, "Range", range, sizeof(range));
+	stub_header(req, "If-Range", if_range, sizeof(if_range));
+	if (!head_only) {
+		snprintf(stub_range, sizeof(stub_range), "%s", range);
+		snprintf(stub_if_range, sizeof(stub_if_range), "%s", if_range);
+		stub_header(req, "Authorization", stub_auth,
+		    sizeof(stub_auth));
+	}
+
+	/* /moved sends to the same body under another host name */
+	if (strstr(req, " /moved ") != NULL) {
+		snprintf(head, sizeof(head),
+		    "HTTP/1.1 302 Found\r\n"
+		    "Location: http://localhost:%d/pkg.zip\r\n"
+		    "Content-Length: 0\r\n"
+		    "Connection: close\r\n\r\n", stub_port);
+		stub_send(fd, head, strlen(head));
+		return;
+	}
+
+	ranged = range[0] != '\0' &&
+	    (if_range[0] == '\0' || strcmp(if_range, STUB_ETAG) == 0);
+	if (ranged) {
+		unsigned long long a = 0, b = STUB_SIZE - 1;
+
+		if (sscanf(range, "bytes=%llu-%llu", &a, &b) < 1)
+			ranged = 0;
+		start = (size_t)a;
+		end = b < STUB_SIZE ? (size_t)b : STUB_SIZE - 1;
+	}
+	len = end - start + 1;
+	snprintf(head, sizeof(head),
+	    "HTTP/1.1 %s\r\n"
+	    "Content-Length: %zu\r\n"
+	    "Accept-Ranges: bytes\r\n"
+	    "ETag: " STUB_ETAG "\r\n"
+	    "Connection: close\r\n",
+	    ranged ? "206 Partial Content" : "200 OK", len);
+	stub_send(fd, head, strlen(head));
+	if (ranged) {
+		snprintf(head, sizeof(head),
+		    "Content-Range: bytes %zu-%zu/%zu\r\n", start, end,
+		    STUB_SIZE);
+		stub_send(fd, head, strlen(head));
+	}
+	stub_send(fd, "\r\n", 2);
+	if (head_only)
+		return;
+
+	if (stub_mode == STUB_BREAK_ALWAYS ||
+	    (stub_mode == STUB_BREAK_ONCE && !stub_broken)) {
+		stub_broken = 1;
+		len /= 2;
+	}
+	stub_send(fd, stub_body + start, len);
+}
+
+static void *
+stub_thread(void *arg)
+{
+	int		 ls = *(int *)arg, fd;
+
+	while ((fd = accept(ls, NULL, NULL)) >= 0) {
+		stub_serve(fd);
+		close(fd);
+	}
+	return (NULL);
+}
+
+static int
+stub_start(void)
+{
+	static int		 ls;
+	struct sockaddr_in	 sa;
+	socklen_t		 salen = sizeof(sa);
+	pthread_t		 tid;
+	size_t			 i;
+
+	stub_body = dog_malloc(STUB_SIZE);
+	if (stub_body == NULL)
+		return (-1);
+	memcpy(stub_body, "PK\003\004", 4);
+	for (i = 4; i < STUB_SIZE; i++)
+		stub_body[i] = (unsigned char)((i * 2654435761u) >> 13);
+
+	ls = socket(AF_INET, SOCK_STREAM, 0);
+	memset(&sa, 0, sizeof(sa));
+	sa.sin_family = AF_INET;
+	sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (ls < 0 || bind(ls, (struct sockaddr *)&sa, sizeof(sa)) != 0 ||
+	    listen(ls, 16) != 0 ||
+	    getsockname(ls, (struct sockaddr *)&sa, &salen) != 0)
+		return (-1);
+	stub_port = ntohs(sa.sin_port);
+	return (pthread_create(&tid, NULL, stub_thread, &ls));
+}
+
+/* does `path' hold exactly the body */
+static int
+same_as_body(const char *path)
+{
+	unsigned char	*buf;
+	size_t		 n;
+	FILE		*fp;
+	int		 same;
+
+	fp = fopen(path, "rb");
+	if (fp == NULL)
+		return (0);
+	buf = dog_malloc(STUB_SIZE + 1);
+	n = buf != NULL ? fread(buf, 1, STUB_SIZE + 1, fp) : 0;
+	fclose(fp);
+	same = n == STUB_SIZE && memcmp(buf, stub_body, STUB_SIZE) == 0;
+	dog_free(buf);
+	return (same);
+}
+
+static void
+body_sha256(char *out)
+{
+	DownloadPart	 p;
+
+	memset(&p, 0, sizeof(p));
+	crypto_sha256_init(&p.sha);
+	crypto_sha256_update(&p.sha, stub_body, STUB_SIZE);
+	download_part_digest(&p);
+	memcpy(out, p.sha256, sizeof(p.sha256));
+}
+
+static void
+write_file(const char *path, const void *data, size_t len)
+{
+	FILE	*fp = fopen(path, "wb");
+
+	if (fp == NULL)
+		return;
+	fwrite(data, 1, len, fp);
+	fclose(fp);
+}
+
+static void
+test_segmented(const char *url, const char *want_sha)
+{
+	char	 sha[SHA256_DIGEST_LENGTH * 2 + 1] = "";
+
+	stub_mode = STUB_WHOLE;
+	CHECK(download_segmented(url, "seg.zip.part", "seg.zip", sha) == 0,
+	    "segmented download completes");
+	CHECK(same_as_body("seg.zip"), "segments assemble to the body");
+	CHECK(strcmp(sha, want_sha) == 0, "segmented SHA-256 is the body's");
+	remove("seg.zip");
+
+	/* a range cut short is asked for again from where it stopped */
+	stub_mode = STUB_BREAK_ONCE;
+	stub_broken = 0;
+	CHECK(download_segmented(url, "seg.zip.part", "seg.zip", sha) == 0,
+	    "a broken range is resumed");
+	CHECK(stub_broken, "the stand-in did break a range");
+	CHECK(same_as_body("seg.zip"), "resumed segments assemble");
+	remove("seg.zip");
+
+	/* a range that never completes fails the whole file */
+	stub_mode = STUB_BREAK_ALWAYS;
+	CHECK(download_segmented(url, "seg.zip.part", "seg.zip", sha) != 0,
+	    "short segments are detected");
+	CHECK(path_exists("seg.zip") == 0 && path_exists("seg.zip.part") == 0,
+	    "a short segmented download leaves nothing behind");
+}
+
+/* a stream hashes the whole body, even the part nobody read */
+static void
+test_stream(const char *url, const char *want_sha)
+{
+	DogStream	*s;
+	const void	*data;
+	char		 sha[SHA256_DIGEST_LENGTH * 2 + 1] = "";
+	long long	 size = 0;
+
+	stub_mode = STUB_WHOLE;
+	s = dog_stream_open(url);
+	CHECK(s != NULL && dog_stream_read(s, &data) > 0,
+	    "a stream hands out the body");
+	CHECK(dog_stream_close(s, sha, &size) == 0, "a stream completes");
+	CHECK(strcmp(sha, want_sha) == 0 && size == (long long)STUB_SIZE,
+	    "the stream SHA-256 and size are the body's");
+}
+
+/* the token is not sent on to the host a download was redirected to */
+static void
+test_redirect(const char *url)
+{
+	char	 sha[SHA256_DIGEST_LENGTH * 2 + 1] = "";
+
+	installing_package = true;
+	dogconfig.dog_toml_github_tokens = "stub-token";
+	stub_mode = STUB_WHOLE;
+	stub_auth[0] = '\0';
+	CHECK(download_segmented(url, "seg.zip.part", "seg.zip", sha) == 0,
+	    "a redirected segmented download completes");
+	CHECK(stub_auth[0] == '\0',
+	    "ranges on another host carry no Authorization");
+	CHECK(same_as_body("seg.zip"), "redirected segments assemble");
+	remove("seg.zip");
+	dogconfig.dog_toml_github_tokens = NULL;
+	installing_package = false;
+}
+
+/* one single-stream attempt, as dog_download_file makes it */
+static int
+attempt(const char *url, DownloadPart *part)
+{
+	struct curl_slist	*headers = NULL;
+	CURL			*curl;
+	CURLcode		 res;
+	int			 done;
+
+	curl = dog_curl_acquire();
+	if (curl == NULL)
+		return (-2);
+	curl_easy_setopt(curl, CURLOPT_URL, url);
+	if (download_part_open(part, "one.zip.part", curl, &headers) != 0) {
+		dog_curl_release(curl);
+		return (-2);
+	}
+	curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+	curl_easy_setopt(curl, CURLOPT_FAILONERROR, 1L);
+	res = curl_easy_perform(curl);
+	done = download_part_close(part, res, "one.zip");
+	dog_curl_release(curl);
+	curl_slist_free_all(headers);
+	return (done);
+}
+
+static void
+test_resume(const char *url, const char *want_sha)
+{
+	DownloadPart	 part;
+	size_t		 half = STUB_SIZE / 2;
+
+	/* broken first attempt, then a ranged resume with If-Range */
+	stub_mode = STUB_BREAK_ONCE;
+	stub_broken = 0;
+	CHECK(attempt(url, &part) == 0, "a broken attempt is kept");
+	stub_mode = STUB_WHOLE;
+	CHECK(path_exists("one.zip.part.meta") == 1,
+	    "the validator is kept next to the partial file");
+	CHECK(attempt(url, &part) == 1, "a resumed download completes");
+	CHECK(strncmp(stub_range, "bytes=", 6) == 0 &&
+	    strcmp(stub_if_range, STUB_ETAG) == 0,
+	    "the resume sends Range and If-Range");
+	CHECK(same_as_body("one.zip"), "the resumed file is the body");
+	CHECK(strcmp(part.sha256, want_sha) == 0,
+	    "the resumed SHA-256 is the body's");
+	CHECK(path_exists("one.zip.part.meta") == 0,
+	    "the validator goes with the finished file");
+	remove("one.zip");
+
+	/* the file changed on the server: If-Range fails, start over */
+	write_file("one.zip.part", "PK\003\004stale bytes", 15);
+	write_file("one.zip.part.meta", "\"stub-v0\"\n", 10);
+	CHECK(attempt(url, &part) == 1, "a changed file downloads again");
+	CHECK(same_as_body("one.zip"), "stale bytes are not kept");
+	remove("one.zip");
+
+	/* no validator: the partial file is not trusted at all */
+	write_file("one.zip.part", stub_body, half);
+	remove("one.zip.part.meta");
+	CHECK(attempt(url, &part) == 1, "a download without validator");
+	CHECK(stub_range[0] == '\0', "no Range is sent without a validator");
+	CHECK(same_as_body("one.zip"), "the file is fetched whole");
+	remove("one.zip");
+}
+
+int
+main(void)
+{
+	char	 dir[] = "/tmp/wd-test-XXXXXX", url[128];
+	char	 want[SHA256_DIGEST_LENGTH * 2 + 1];
+
+	if (mkdtemp(dir) == NULL || chdir(dir) != 0 || stub_start() != 0) {
+		fprintf(stderr, "cannot set up the loopback stand-in\n");
+		return (2);
+	}
+	snprintf(url, sizeof(url), "http://127.0.0.1:%d/pkg.zip", stub_port);
+	dogconfig.dog_toml_download_segments = 4;
+	body_sha256(want);
+
+	test_segmented(url, want);
+	test_resume(url, want);
+	test_stream(url, want);
+	snprintf(url, sizeof(url), "http://127.0.0.1:%d/moved", stub_port);
+	test_redirect(url);
+	if (chdir("/") == 0)
+		(void)rmdir(dir);
+
+	if (failures == 0)
+		printf("test_download: ok\n");
+	return (failures == 0 ? 0 : 1);
+}
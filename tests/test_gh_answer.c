@@ -0,0 +1,148 @@
+/*-
+ * Copyright (c) 2026 Watchdogs Team and contributors
+ * All rights reserved. under The 2-Clause BSD License
+ * See COPYING or https://opensource.org/license/bsd-2-clause
+ */
+
+/*
+ * The GraphQL release batch against a canned answer: package_gh_answer
+ * fills each aliased entry, and the REST helpers are then served from
+ * the batch without asking the network.  replicate.c is built into the
+ * test so its static helpers can be driven directly.
+ */
+
+#include "../source/replicate.c"
+
+#undef main
+
+static int	 failures;
+
+#define CHECK(cond, what) do {						\
+	if (!(cond)) {							\
+		fprintf(stderr, "FAIL %s:%d: %s\n", __FILE__, __LINE__,	\
+		    what);						\
+		++failures;						\
+	}								\
+} while (0)
+
+/*
+ * r0  a tagged release with two assets
+ * r1  the latest release, with more assets than are kept
+ * r2  a repository without that release
+ * r3  a repository GitHub does not know (null, with an error)
+ * r4  the latest release of a repository that has none
+ */
+static const char canned[] =
+    "{\"data\":{"
+    "\"r0\":{\"release\":{\"tagName\":\"v2.13.8\",\"releaseAssets\":"
+    "{\"nodes\":["
+    "{\"downloadUrl\":\"https://github.com/Y-Less/sscanf/releases/"
+    "download/v2.13.8/sscanf-linux.tar.gz\"},"
+    "{\"downloadUrl\":\"https://github.com/Y-Less/sscanf/releases/"
+    "download/v2.13.8/sscanf-win32.zip\"}]}}},"
+    "\"r1\":{\"latestRelease\":{\"tagName\":\"v2.9.6\",\"releaseAssets\":"
+    "{\"nodes\":["
+    "{\"downloadUrl\":\"https://e/1.zip\"},{\"downloadUrl\":\"https://e/2.zip\"},"
+    "{\"downloadUrl\":\"https://e/3.zip\"},{\"downloadUrl\":\"https://e/4.zip\"},"
+    "{\"downloadUrl\":\"https://e/5.zip\"},{\"downloadUrl\":\"https://e/6.zip\"},"
+    "{\"downloadUrl\":\"https://e/7.zip\"},{\"downloadUrl\":\"https://e/8.zip\"},"
+    "{\"downloadUrl\":\"https://e/9.zip\"},{\"downloadUrl\":\"https://e/10.zip\"},"
+    "{\"downloadUrl\":\"https://e/11.zip\"},{\"downloadUrl\":42}]}}},"
+    "\"r2\":{\"release\":null},"
+    "\"r3\":null,"
+    "\"r4\":{\"latestRelease\":null}"
+    "},\"errors\":[{\"type\":\"NOT_FOUND\",\"path\":[\"r3\"]}]}";
+
+static void
+batch_add(const char *user, const char *repo, const char *tag)
+{
+	PackageGhRelease	*r;
+
+	package_gh_batch.entry = dog_realloc(package_gh_batch.entry,
+	    ((size_t)package_gh_batch.count + 1) * sizeof(*r));
+	r = &package_gh_batch.entry[package_gh_batch.count++];
+	memset(r, 0, sizeof(*r));
+	r->found = -1;
+	snprintf(r->user, sizeof(r->user), "%s", user);
+	snprintf(r->repo, sizeof(r->repo), "%s", repo);
+	snprintf(r->tag, sizeof(r->tag), "%s", tag);
+}
+
+static void
+test_answer(void)
+{
+	PackageGhRelease	*e;
+	cJSON			*root, *data;
+	char			 alias[16];
+	int			 i;
+
+	batch_add("Y-Less", "sscanf", "v2.13.8");
+	batch_add("samp-incognito", "samp-streamer-plugin", "");
+	batch_add("someone", "plugin", "v9.9.9");
+	batch_add("nobody", "nothing", "v1.0");
+	batch_add("someone", "includes", "");
+
+	root = cJSON_Parse(canned);
+	CHECK(root != NULL, "the canned answer parses");
+	data = cJSON_GetObjectItem(root, "data");
+	for (i = 0; i < package_gh_batch.count; i++) {
+		snprintf(alias, sizeof(alias), "r%d", i);
+		package_gh_answer(&package_gh_batch.entry[i],
+		    cJSON_GetObjectItem(data, alias));
+	}
+	cJSON_Delete(root);
+
+	e = package_gh_batch.entry;
+	CHECK(e[0].found == 1 && strcmp(e[0].name, "v2.13.8") == 0,
+	    "a tagged release is found");
+	CHECK(e[0].nasset == 2 && strstr(e[0].asset[1], "win32.zip") != NULL,
+	    "its assets are kept in order");
+	CHECK(e[1].found == 1 && strcmp(e[1].name, "v2.9.6") == 0,
+	    "the latest release is read from latestRelease");
+	CHECK(e[1].nasset == PACKAGE_MAX_ASSETS,
+	    "assets past PACKAGE_MAX_ASSETS are dropped");
+	CHECK(e[2].found == 0 && e[2].nasset == 0,
+	    "a missing release is an answer");
+	CHECK(e[3].found == -1, "an unknown repository is left to REST");
+	CHECK(e[4].found == 0, "a repository without releases is an answer");
+}
+
+static void
+test_cached(void)
+{
+	char	 tag[tag_size], *urls[PACKAGE_MAX_ASSETS];
+	int	 n, i;
+
+	CHECK(package_gh_latest_tag("samp-incognito", "SAMP-streamer-plugin",
+	    tag, sizeof(tag)) == 1 && strcmp(tag, "v2.9.6") == 0,
+	    "the latest tag comes from the batch, case-insensitively");
+	CHECK(package_gh_latest_tag("someone", "includes", tag,
+	    sizeof(tag)) == 0, "no release means no latest tag");
+
+	n = package_gh_release_assets("Y-Less", "sscanf", "v2.13.8", urls,
+	    PACKAGE_MAX_ASSETS);
+	CHECK(n == 2 && strstr(urls[0], "linux.tar.gz") != NULL,
+	    "release assets come from the batch");
+	for (i = 0; i < n; i++)
+		dog_free(urls[i]);
+	n = package_gh_release_assets("someone", "plugin", "v9.9.9", urls,
+	    PACKAGE_MAX_ASSETS);
+	CHECK(n == 0, "a missing release has no assets");
+
+	CHECK(package_gh_cached("nobody", "nothing", "v1.0") == NULL,
+	    "an unanswered entry is not served");
+	package_gh_batch_free();
+	CHECK(package_gh_batch.count == 0 && package_gh_batch.entry == NULL,
+	    "the batch is freed");
+}
+
+int
+main(void)
+{
+	test_answer();
+	test_cached();
+
+	if (failures == 0)
+		printf("test_gh_answer: ok\n");
+	return (failures == 0 ? 0 : 1);
+}